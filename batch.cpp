@@ -0,0 +1,610 @@
+#include "bytecode.h"
+#include "column.h"
+#include "engine.h"
+#include "evaluator.h"
+#include "expression.h"
+#include "history.h"
+#include "mappedfile.h"
+#include "numcodec.h"
+#include "resultcache.h"
+#include "sessions.h"
+#include "sheet.h"
+#include "workpool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// how much input every thread is handed at once
+static const std::size_t SliceBytes = 1 << 20;
+
+/* the cache every thread looks results up in, if any, which parts of an
+expression it keeps, and after how many evaluations a program is compiled */
+struct LineOptions {
+    ResultCache *cache;
+    int partOperators;
+    unsigned long jitThreshold;
+};
+
+// evaluates every line between begin and end, one result line per input line
+static void evaluateSlice(const char *begin, const char *end, std::string *output, const LineOptions *options) {
+    // every thread of the pool keeps its evaluator, and the programs it has kept, from one slice to the next
+    thread_local LineEvaluator evaluator;
+    evaluator.setCache(options->cache, options->partOperators);
+    evaluator.setJitThreshold(options->jitThreshold);
+    output->clear();
+    output->reserve(std::size_t(end - begin));
+    evaluator.evaluateLines(begin, end, *output);
+}
+
+// splits a block of whole lines between the threads of the pool and writes the results in input order
+static void evaluateBlock(const char *begin, const char *end, std::vector<std::string> &outputs,
+                          const LineOptions *options, WorkStealingPool &pool) {
+    std::vector<const char *> sliceBegins;
+    const char *sliceBegin = begin;
+    while(sliceBegin != end) {
+        // every slice ends right after a newline, the last one takes whatever is left
+        sliceBegins.push_back(sliceBegin);
+        const char *sliceEnd = end;
+        if(sliceBegins.size() < outputs.size() && std::size_t(end - sliceBegin) > SliceBytes) {
+            const char *newline = static_cast<const char *>(
+                std::memchr(sliceBegin + SliceBytes, '\n', std::size_t(end - sliceBegin) - SliceBytes));
+            if(newline)
+                sliceEnd = newline + 1;
+        }
+        sliceBegin = sliceEnd;
+    }
+    sliceBegins.push_back(end);
+
+    std::vector<std::size_t> slices(sliceBegins.size() - 1);
+    for(std::size_t i = 0; i < slices.size(); i++)
+        slices[i] = i;
+    pool.run(slices, [&](std::size_t slice, std::vector<std::size_t> &) {
+        evaluateSlice(sliceBegins[slice], sliceBegins[slice + 1], &outputs[slice], options);
+    });
+    for(std::size_t i = 0; i < slices.size(); i++)
+        std::fwrite(outputs[i].data(), 1, outputs[i].size(), stdout);
+}
+
+// reads the whole file through a memory mapping, a block at a time
+static bool evaluateFile(const char *path, std::vector<std::string> &outputs, const LineOptions *options,
+                         WorkStealingPool &pool) {
+    MappedFile file;
+    if(!file.open(path)) {
+        std::fprintf(stderr, "calc-batch: cannot open %s\n", path);
+        return false;
+    }
+
+    const std::size_t blockBytes = SliceBytes * outputs.size();
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+    while(begin != end) {
+        // cut the block after the first newline past its nominal size
+        const char *blockEnd = end;
+        if(std::size_t(end - begin) > blockBytes) {
+            const char *newline = static_cast<const char *>(
+                std::memchr(begin + blockBytes, '\n', std::size_t(end - begin) - blockBytes));
+            if(newline)
+                blockEnd = newline + 1;
+        }
+        evaluateBlock(begin, blockEnd, outputs, options, pool);
+        begin = blockEnd;
+    }
+    return true;
+}
+
+// reads standard input a block at a time, carrying any unfinished line over to the next block
+static bool evaluateStream(std::FILE *input, std::vector<std::string> &outputs, const LineOptions *options,
+                           WorkStealingPool &pool) {
+    std::vector<char> buffer(SliceBytes * outputs.size());
+    std::size_t carried = 0;
+
+    for(;;) {
+        // a line longer than the whole buffer makes the buffer grow
+        if(carried == buffer.size())
+            buffer.resize(buffer.size() * 2);
+
+        std::size_t got = std::fread(buffer.data() + carried, 1, buffer.size() - carried, input);
+        std::size_t filled = carried + got;
+        if(got == 0) {
+            // the last line may not end with a newline
+            if(filled)
+                evaluateBlock(buffer.data(), buffer.data() + filled, outputs, options, pool);
+            return !std::ferror(input);
+        }
+
+        // only hand over whole lines, keep the rest for the next round
+        std::size_t complete = filled;
+        while(complete > 0 && buffer[complete - 1] != '\n')
+            complete--;
+        if(complete == 0) {
+            carried = filled;
+            continue;
+        }
+        evaluateBlock(buffer.data(), buffer.data() + complete, outputs, options, pool);
+        carried = filled - complete;
+        std::memmove(buffer.data(), buffer.data() + complete, carried);
+    }
+}
+
+// runs one expression over columns of doubles read from binary files, one column per variable
+static bool evaluateColumnFiles(const char *text, const std::vector<const char *> &bindings,
+                                const char *outputPath, unsigned threads) {
+    Expression expression;
+    Program program;
+    std::string error;
+    if(!expression.parse(text, text + std::strlen(text), &error)) {
+        std::fprintf(stderr, "calc-batch: %s\n", error.c_str());
+        return false;
+    }
+    expression.foldConstants();
+    if(!program.compile(expression)) {
+        std::fprintf(stderr, "calc-batch: expression is too large\n");
+        return false;
+    }
+
+    // map the file of every variable, the shortest column decides the number of rows
+    const std::vector<std::string> &names = expression.variableNames();
+    std::vector<MappedFile> files(names.size());
+    std::vector<const double *> columns(names.size());
+    std::size_t rows = names.empty() ? 1 : std::size_t(-1);
+    for(std::size_t i = 0; i < names.size(); i++) {
+        const char *path = nullptr;
+        for(const char *binding : bindings) {
+            const char *equals = std::strchr(binding, '=');
+            if(equals && names[i].compare(0, std::string::npos, binding, std::size_t(equals - binding)) == 0)
+                path = equals + 1;
+        }
+        if(!path) {
+            std::fprintf(stderr, "calc-batch: no column given for %s\n", names[i].c_str());
+            return false;
+        }
+        if(!files[i].open(path)) {
+            std::fprintf(stderr, "calc-batch: cannot open %s\n", path);
+            return false;
+        }
+        columns[i] = reinterpret_cast<const double *>(files[i].data());
+        if(files[i].size() / sizeof(double) < rows)
+            rows = files[i].size() / sizeof(double);
+    }
+
+    // every thread takes an even share of the rows
+    std::vector<double> output(rows);
+    std::vector<unsigned char> errors(rows);
+    std::vector<std::thread> workers;
+    std::vector<std::size_t> failed(threads);
+    std::size_t share = (rows + threads - 1) / threads;
+    for(unsigned t = 0; t < threads && t * share < rows; t++) {
+        std::size_t first = t * share;
+        std::size_t count = rows - first < share ? rows - first : share;
+        workers.emplace_back([&, t, first, count]() {
+            std::vector<const double *> shifted(columns);
+            for(const double *&column : shifted)
+                column += first;
+            failed[t] = evaluateColumns(program, shifted.data(), count, &output[first], &errors[first]);
+        });
+    }
+    std::size_t totalFailed = 0;
+    for(unsigned t = 0; t < workers.size(); t++) {
+        workers[t].join();
+        totalFailed += failed[t];
+    }
+
+    if(outputPath) {
+        // the results go out as raw doubles, failed rows as NaN
+        std::FILE *file = std::fopen(outputPath, "wb");
+        if(!file || std::fwrite(output.data(), sizeof(double), rows, file) != rows) {
+            std::fprintf(stderr, "calc-batch: cannot write %s\n", outputPath);
+            if(file)
+                std::fclose(file);
+            return false;
+        }
+        std::fclose(file);
+    } else {
+        // the lines are gathered into one buffer and written a slice at a time
+        std::string text;
+        text.reserve(SliceBytes + MaxDoubleText + 1);
+        for(std::size_t i = 0; i < rows; i++) {
+            if(errors[i])
+                text.append("####");
+            else
+                appendDouble(text, output[i]);
+            text.push_back('\n');
+            if(text.size() >= SliceBytes) {
+                std::fwrite(text.data(), 1, text.size(), stdout);
+                text.clear();
+            }
+        }
+        std::fwrite(text.data(), 1, text.size(), stdout);
+    }
+    if(totalFailed)
+        std::fprintf(stderr, "calc-batch: %zu of %zu rows failed\n", totalFailed, rows);
+    return true;
+}
+
+// evaluates an expression a number of times with a new program, compiled from the threshold on, in nanoseconds
+static double timeEvaluations(const Expression &expression, unsigned long threshold, unsigned long evaluations,
+                              bool &native) {
+    Program program;
+    program.compile(expression);
+    program.setJitThreshold(threshold);
+    // every evaluation gets other inputs, as it would over a column
+    std::vector<double> inputs(program.inputCount());
+    double sum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(unsigned long k = 0; k < evaluations; k++) {
+        for(std::size_t i = 0; i < inputs.size(); i++)
+            inputs[i] = 1 + double(k % 1024) / 1024 + double(i);
+        double value;
+        if(program.evaluate(inputs.data(), value))
+            sum += value;
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    // the sum is used, so the evaluations cannot be left out
+    native = program.isNative() && sum == sum;
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+/* times an expression interpreted and compiled to machine code right away,
+for more and more evaluations, to show where compiling starts to pay off */
+static bool benchmarkJit(const char *text) {
+    Expression expression;
+    std::string error;
+    if(!expression.parse(text, text + std::strlen(text), &error)) {
+        std::fprintf(stderr, "calc-batch: %s\n", error.c_str());
+        return false;
+    }
+    expression.foldConstants();
+
+    std::printf("%12s %16s %16s\n", "evaluations", "interpreted ns", "compiled ns");
+    double interpretedEach = 0, nativeEach = 0, compiledOnce = 0;
+    bool native = false;
+    for(unsigned long evaluations = 1; evaluations <= 1000000; evaluations *= 10) {
+        // short runs are repeated, and the quickest run of each kind is the one that counts
+        unsigned long rounds = 10000 / evaluations + 3;
+        double interpreted = 1e300, compiled = 1e300;
+        for(unsigned long round = 0; round < rounds; round++) {
+            bool ignored;
+            interpreted = std::min(interpreted, timeEvaluations(expression, 0, evaluations, ignored));
+            compiled = std::min(compiled, timeEvaluations(expression, 1, evaluations, native));
+        }
+        std::printf("%12lu %16.0f %16.0f\n", evaluations, interpreted, compiled);
+        if(evaluations == 1)
+            compiledOnce = compiled;
+        interpretedEach = interpreted / double(evaluations);
+        nativeEach = compiled / double(evaluations);
+    }
+
+    if(!native) {
+        std::printf("expressions cannot be compiled on this machine, they are always interpreted\n");
+    } else if(nativeEach < interpretedEach) {
+        // the first compiled evaluation is interpreted too, the rest of it is the compiling
+        std::printf("compiling takes %.0f ns and pays off after about %.0f evaluations\n", compiledOnce,
+                    compiledOnce / (interpretedEach - nativeEach));
+    } else {
+        std::printf("compiled code is not faster than interpreting this expression\n");
+    }
+    return true;
+}
+
+// the milliseconds since start
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// gives a cell the formula of a line like "total = net + tax", reporting what is wrong with it
+static bool setCell(Sheet &sheet, const char *begin, const char *end, const char *where) {
+    const char *equals = static_cast<const char *>(std::memchr(begin, '=', std::size_t(end - begin)));
+    std::string error = "no = between a name and a formula";
+    if(equals && sheet.setFormula(begin, std::size_t(equals - begin), equals + 1, std::size_t(end - equals - 1),
+                                  &error))
+        return true;
+    std::fprintf(stderr, "calc-batch: %s: %s\n", where, error.c_str());
+    return false;
+}
+
+/* reads a sheet of "name = formula" lines and works it out, then changes one
+cell at a time, recomputing only what each change reaches, and prints every
+cell with its value at the end */
+static bool runSheet(const char *path, const std::vector<const char *> &edits, unsigned threads) {
+    MappedFile file;
+    if(!file.open(path)) {
+        std::fprintf(stderr, "calc-batch: cannot open %s\n", path);
+        return false;
+    }
+
+    Sheet sheet(threads);
+    const char *p = file.data();
+    const char *end = p + file.size();
+    bool ok = true;
+    for(unsigned long line = 1; p != end; line++) {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', std::size_t(end - p)));
+        const char *lineEnd = newline ? newline : end;
+        if(std::strspn(p, " \t\r") < std::size_t(lineEnd - p)) {
+            std::string where = std::string(path) + ":" + std::to_string(line);
+            ok &= setCell(sheet, p, lineEnd, where.c_str());
+        }
+        p = newline ? newline + 1 : end;
+    }
+    if(!ok)
+        return false;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::size_t computed = sheet.recompute();
+    std::fprintf(stderr, "calc-batch: %zu cells computed in %.3f ms\n", computed, millisecondsSince(start));
+
+    // an edit that cannot be made is left out, the others are still made
+    for(const char *edit : edits) {
+        if(!setCell(sheet, edit, edit + std::strlen(edit), edit)) {
+            ok = false;
+            continue;
+        }
+        start = std::chrono::steady_clock::now();
+        std::size_t recomputed = sheet.recompute();
+        std::fprintf(stderr, "calc-batch: %s: %zu of %zu cells recomputed in %.3f ms\n", edit, recomputed,
+                     sheet.cellCount(), millisecondsSince(start));
+    }
+
+    // the cells in the order they were first named, the ones never given a formula only as a warning
+    std::string text;
+    for(std::size_t i = 0; i < sheet.cellCount(); i++) {
+        int cell = int(i);
+        if(sheet.cellState(cell) == CellState::Empty) {
+            std::fprintf(stderr, "calc-batch: %s has no formula\n", sheet.cellName(cell).c_str());
+            continue;
+        }
+        text.assign(sheet.cellName(cell)).append(" = ");
+        if(sheet.cellState(cell) == CellState::Failed)
+            text.append("####");
+        else
+            appendDouble(text, sheet.cellValue(cell));
+        text.push_back('\n');
+        std::fwrite(text.data(), 1, text.size(), stdout);
+    }
+    return ok;
+}
+
+/* reads one key log per line, like "1 2 + 3 =", presses the keys of every
+line as a session of its own and prints what each one ends up displaying.
+With verify every session is pressed through an Engine as well, and any that
+comes out differently is reported */
+static bool runSessions(const char *path, bool verify, unsigned threads) {
+    MappedFile file;
+    if(!file.open(path)) {
+        std::fprintf(stderr, "calc-batch: cannot open %s\n", path);
+        return false;
+    }
+
+    SessionBatch batch;
+    const char *p = file.data();
+    const char *end = p + file.size();
+    std::vector<Key> keys;
+    std::string error;
+    for(unsigned long line = 1; p != end; line++) {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', std::size_t(end - p)));
+        const char *lineEnd = newline ? newline : end;
+        keys.clear();
+        if(!parseKeys(p, std::size_t(lineEnd - p), keys, &error)) {
+            std::fprintf(stderr, "calc-batch: %s:%lu: %s\n", path, line, error.c_str());
+            return false;
+        }
+        batch.addSession(keys.data(), keys.size());
+        p = newline ? newline + 1 : end;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    batch.run(threads);
+    std::fprintf(stderr, "calc-batch: %zu sessions replayed in %.3f ms, %zu of them with brackets\n",
+                 batch.sessionCount(), millisecondsSince(start), batch.fallbackCount());
+
+    std::string text;
+    for(std::size_t session = 0; session < batch.sessionCount(); session++) {
+        text.assign(batch.display(session)).push_back('\n');
+        std::fwrite(text.data(), 1, text.size(), stdout);
+    }
+    if(!verify)
+        return true;
+
+    // the same logs again, one Engine at a time
+    std::size_t mismatches = 0;
+    p = file.data();
+    for(std::size_t session = 0; p != end; session++) {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', std::size_t(end - p)));
+        const char *lineEnd = newline ? newline : end;
+        keys.clear();
+        parseKeys(p, std::size_t(lineEnd - p), keys);
+        Engine engine;
+        for(Key key : keys)
+            engine.press(key);
+        if(engine.display() != batch.display(session) || engine.finishedCount() != batch.finishedCount(session)) {
+            std::fprintf(stderr, "calc-batch: %s:%zu: the engine displays %s after %lu entries, the session %s after %lu\n",
+                         path, session + 1, engine.display().c_str(), engine.finishedCount(),
+                         batch.display(session).c_str(), batch.finishedCount(session));
+            mismatches++;
+        }
+        p = newline ? newline + 1 : end;
+    }
+    std::fprintf(stderr, "calc-batch: %zu sessions differ from the engine\n", mismatches);
+    return mismatches == 0;
+}
+
+// prints entries of a history tape, all of them or those a search finds
+static bool printHistory(const char *path, const char *search) {
+    HistoryTape tape;
+    if(!tape.open(path)) {
+        std::fprintf(stderr, "calc-batch: cannot open history %s\n", path);
+        return false;
+    }
+
+    // a number finds the results that round to it, anything else the entries that start with it
+    std::vector<std::size_t> found;
+    if(search) {
+        std::size_t length = std::strlen(search);
+        double low, high;
+        if(readValueRange(search, length, low, high))
+            found = tape.findValue(low, high, std::size_t(-1));
+        else
+            found = tape.findPrefix(search, length, std::size_t(-1));
+        // oldest first, like the whole tape
+        std::reverse(found.begin(), found.end());
+    } else {
+        found.resize(tape.count());
+        for(std::size_t i = 0; i < found.size(); i++)
+            found[i] = i;
+    }
+
+    std::string text;
+    for(std::size_t index : found) {
+        HistoryEntry item = tape.entry(index);
+        std::time_t seconds = std::time_t(item.time / 1000);
+        char when[32];
+        std::strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", std::localtime(&seconds));
+        text.assign(when);
+        text.append("  ").append(item.expression, item.expressionLength);
+        text.append(" = ").append(item.result, item.resultLength);
+        text.push_back('\n');
+        std::fwrite(text.data(), 1, text.size(), stdout);
+    }
+    return true;
+}
+
+static void usage() {
+    std::fprintf(stderr, "usage: calc-batch [-j threads] [--cache entries [--eviction lru|fifo] [--cache-parts operators]]\n"
+                         "                  [--jit-threshold evaluations] [file]\n"
+                         "       calc-batch [-j threads] --column expression [variable=file ...] [-o file]\n"
+                         "       calc-batch --history tape [--find number-or-prefix]\n"
+                         "       calc-batch [-j threads] --sheet file [--edit \"name = formula\" ...]\n"
+                         "       calc-batch [-j threads] --sessions file [--verify]\n"
+                         "       calc-batch --jit-benchmark expression\n"
+                         "evaluates one expression per line, from file or standard input, or one\n"
+                         "expression over columns of doubles read from binary files, or prints the\n"
+                         "history tape of the calculator, or works out a sheet of named formulas\n"
+                         "and then each edit of it, or replays key logs, one session per line.\n"
+                         "With a cache, results seen before are looked up instead of worked out\n"
+                         "again, and so are parts of expressions with at least that many\n"
+                         "operators. Without one, the programs of lines that come again are kept,\n"
+                         "and run as machine code once they have run that many times (0 never).\n"
+                         "With verify every session is checked against the calculator engine.\n"
+                         "The benchmark times an expression interpreted and compiled to machine\n"
+                         "code\n");
+}
+
+// evaluates expressions without starting the graphical calculator
+int main(int argc, char *argv[]) {
+    unsigned threads = std::thread::hardware_concurrency();
+    const char *path = nullptr;
+    const char *columnExpression = nullptr;
+    const char *outputPath = nullptr;
+    std::vector<const char *> bindings;
+    const char *historyPath = nullptr;
+    const char *historySearch = nullptr;
+    const char *benchmarkExpression = nullptr;
+    const char *sheetPath = nullptr;
+    const char *sessionsPath = nullptr;
+    bool verifySessions = false;
+    std::vector<const char *> edits;
+    std::size_t cacheEntries = 0;
+    EvictionPolicy eviction = EvictionPolicy::LeastRecentlyUsed;
+    int partOperators = 0;
+    unsigned long jitThreshold = Program::DefaultJitThreshold;
+
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = unsigned(std::atoi(argv[++i]));
+        } else if(std::strcmp(argv[i], "--column") == 0 && i + 1 < argc) {
+            columnExpression = argv[++i];
+        } else if(std::strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+            historyPath = argv[++i];
+        } else if(std::strcmp(argv[i], "--sheet") == 0 && i + 1 < argc) {
+            sheetPath = argv[++i];
+        } else if(std::strcmp(argv[i], "--edit") == 0 && i + 1 < argc) {
+            edits.push_back(argv[++i]);
+        } else if(std::strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) {
+            sessionsPath = argv[++i];
+        } else if(std::strcmp(argv[i], "--verify") == 0) {
+            verifySessions = true;
+        } else if(std::strcmp(argv[i], "--jit-benchmark") == 0 && i + 1 < argc) {
+            benchmarkExpression = argv[++i];
+        } else if(std::strcmp(argv[i], "--find") == 0 && i + 1 < argc) {
+            historySearch = argv[++i];
+        } else if(std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cacheEntries = std::size_t(std::strtoull(argv[++i], nullptr, 10));
+        } else if(std::strcmp(argv[i], "--cache-parts") == 0 && i + 1 < argc) {
+            partOperators = std::atoi(argv[++i]);
+        } else if(std::strcmp(argv[i], "--eviction") == 0 && i + 1 < argc) {
+            if(!readEvictionPolicy(argv[++i], eviction)) {
+                usage();
+                return 2;
+            }
+        } else if(std::strcmp(argv[i], "--jit-threshold") == 0 && i + 1 < argc) {
+            jitThreshold = std::strtoul(argv[++i], nullptr, 10);
+        } else if(std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if(columnExpression && std::strchr(argv[i], '=')) {
+            bindings.push_back(argv[i]);
+        } else if(argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage();
+            return 2;
+        } else {
+            path = argv[i];
+        }
+    }
+    if(threads == 0)
+        threads = 1;
+
+    // a large output buffer, the results are written out in big pieces anyway
+    static char outputBuffer[1 << 16];
+    std::setvbuf(stdout, outputBuffer, _IOFBF, sizeof(outputBuffer));
+
+    if(historyPath) {
+        bool ok = printHistory(historyPath, historySearch);
+        std::fflush(stdout);
+        return ok ? 0 : 1;
+    }
+
+    if(sheetPath) {
+        bool ok = runSheet(sheetPath, edits, threads);
+        std::fflush(stdout);
+        return ok ? 0 : 1;
+    }
+
+    if(sessionsPath) {
+        bool ok = runSessions(sessionsPath, verifySessions, threads);
+        std::fflush(stdout);
+        return ok ? 0 : 1;
+    }
+
+    if(benchmarkExpression) {
+        bool ok = benchmarkJit(benchmarkExpression);
+        std::fflush(stdout);
+        return ok ? 0 : 1;
+    }
+
+    if(columnExpression) {
+        bool ok = evaluateColumnFiles(columnExpression, bindings, outputPath, threads);
+        std::fflush(stdout);
+        return ok ? 0 : 1;
+    }
+
+    // the threads share one cache, so a line any of them worked out is known to all of them
+    std::unique_ptr<ResultCache> cache;
+    if(cacheEntries)
+        cache.reset(new ResultCache(cacheEntries, eviction));
+
+    // the same threads take the slices of every block, from the first to the last
+    WorkStealingPool pool(threads);
+    std::vector<std::string> outputs(threads);
+    LineOptions options = {cache.get(), partOperators, jitThreshold};
+    bool ok = path ? evaluateFile(path, outputs, &options, pool)
+                   : evaluateStream(stdin, outputs, &options, pool);
+    std::fflush(stdout);
+    if(cache)
+        std::fprintf(stderr, "calc-batch: cache %s", cache->report().c_str());
+    return ok ? 0 : 1;
+}
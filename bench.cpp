@@ -0,0 +1,361 @@
+#include "bytecode.h"
+#include "column.h"
+#include "expression.h"
+#include "functions.h"
+#include "numcodec.h"
+#include "operators.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#if defined(CALC_BENCH_QT)
+#include <QLocale>
+#include <QString>
+#endif
+
+/* calc-bench times the inner loops of the calculator against the code they
+replaced, each section printing how many operations it does per second. The
+best of a few rounds counts, so that a round slowed down by something else on
+the machine does not */
+
+static const int Rounds = 5;
+
+// the seconds the quickest of Rounds calls of run took
+template<typename Run> static double bestSeconds(Run run) {
+    double best = 1e300;
+    for(int round = 0; round < Rounds; round++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+static void report(const char *name, double operations, double seconds, const char *unit = "ops/s") {
+    std::printf("  %-28s %14.0f %s\n", name, operations / seconds, unit);
+}
+
+// the results of a run go here, so that the compiler cannot leave the run out
+static volatile double sink;
+
+/* stands in for tr(), which handed back a new string for every comparison.
+QString's conversion from utf-8 and the lookup of a translation cost more than
+this, so the old dispatch comes out a little faster here than it was */
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static std::string translate(const char *text) {
+    return std::string(text);
+}
+
+// the state the window kept, and its calculate() as it was with the operator as a string
+struct StringAccumulators {
+    double sumSoFar = 0;
+    double factorSoFar = 1;
+
+    bool calculate(double rightOperand, const std::string &pendingOperator) {
+        if(pendingOperator == translate("+")) {
+            sumSoFar += rightOperand;
+        } else if(pendingOperator == translate("-")) {
+            sumSoFar -= rightOperand;
+        } else if(pendingOperator == translate("\303\227")) {
+            factorSoFar *= rightOperand;
+        } else if(pendingOperator == translate("\303\267")) {
+            if(rightOperand == 0)
+                return false;
+            factorSoFar /= rightOperand;
+        }
+        return true;
+    }
+};
+
+// the same with the operator as an Operator, dispatched like Engine::calculate() does
+struct OperatorAccumulators {
+    double sumSoFar = 0;
+    double factorSoFar = 1;
+
+    bool calculate(double rightOperand, Operator pendingOperator) {
+        switch(pendingOperator) {
+        case Operator::Add:
+            return OperatorKernel<Operator::Add>::apply(sumSoFar, rightOperand);
+        case Operator::Subtract:
+            return OperatorKernel<Operator::Subtract>::apply(sumSoFar, rightOperand);
+        case Operator::Multiply:
+            return OperatorKernel<Operator::Multiply>::apply(factorSoFar, rightOperand);
+        case Operator::Divide:
+            return OperatorKernel<Operator::Divide>::apply(factorSoFar, rightOperand);
+        default:
+            return true;
+        }
+    }
+};
+
+/* applies count random operators of the four buttons to random operands, once
+with every operator kept as a copy of its button label and picked by comparing
+it with each translated label in turn, and once as an Operator */
+static void benchmarkDispatch(std::size_t count) {
+    std::mt19937_64 random(1);
+    std::uniform_int_distribution<int> pick(1, 4);
+    std::uniform_real_distribution<double> operand(0.5, 2.0);
+    std::vector<Operator> operators(count);
+    std::vector<std::string> labels(count);
+    std::vector<double> operands(count);
+    for(std::size_t i = 0; i < count; i++) {
+        operators[i] = Operator(pick(random));
+        labels[i] = operatorSymbol(operators[i]);
+        operands[i] = operand(random);
+    }
+
+    std::printf("operator dispatch, %zu operations\n", count);
+    double strings = bestSeconds([&] {
+        StringAccumulators accumulators;
+        for(std::size_t i = 0; i < count; i++) {
+            // the window copied the label of the button into pendingAddOp or pendingMultOp
+            std::string pendingOperator = labels[i];
+            accumulators.calculate(operands[i], pendingOperator);
+        }
+        sink = accumulators.sumSoFar + accumulators.factorSoFar;
+    });
+    report("strings compared", double(count), strings);
+    double enums = bestSeconds([&] {
+        OperatorAccumulators accumulators;
+        for(std::size_t i = 0; i < count; i++)
+            accumulators.calculate(operands[i], operators[i]);
+        sink = accumulators.sumSoFar + accumulators.factorSoFar;
+    });
+    report("Operator switched on", double(count), enums);
+    std::printf("  %.1f times as many operations a second\n", strings / enums);
+}
+
+/* runs an expression over columns of rows random numbers a row at a time
+through Program::run(), and then with the column kernels of every instruction
+set the processor has */
+static void benchmarkColumnExpression(const char *text, std::size_t rows) {
+    Expression expression;
+    Program program;
+    expression.parse(text, text + std::strlen(text));
+    expression.foldConstants();
+    program.compile(expression);
+
+    // a few zeros among the numbers, so that some rows fail
+    std::mt19937_64 random(2);
+    std::uniform_real_distribution<double> number(0.0, 100.0);
+    std::vector<std::vector<double> > columns(program.inputCount(), std::vector<double>(rows));
+    std::vector<const double *> inputs;
+    for(std::vector<double> &column : columns) {
+        for(std::size_t i = 0; i < rows; i++)
+            column[i] = i % 1000 == 999 ? 0 : number(random);
+        inputs.push_back(column.data());
+    }
+    std::vector<double> output(rows);
+    std::vector<unsigned char> errors(rows);
+
+    std::printf("%s over %zu rows\n", text, rows);
+    double rowSeconds = bestSeconds([&] {
+        std::vector<double> row(program.inputCount());
+        std::vector<double> scratch(program.registerCount());
+        for(std::size_t i = 0; i < rows; i++) {
+            for(std::size_t c = 0; c < row.size(); c++)
+                row[c] = inputs[c][i];
+            errors[i] = !program.run(row.data(), scratch.data(), output[i]);
+        }
+    });
+    report("Program::run per row", double(rows), rowSeconds, "rows/s");
+
+    static const char *const isaNames[] = { "columns, scalar", "columns, SSE2", "columns, AVX2" };
+    ColumnIsa best = detectColumnIsa();
+    for(int isa = int(ColumnIsa::Scalar); isa <= int(ColumnIsa::Avx2); isa++) {
+        if(isa > int(best)) {
+            std::printf("  %-28s %14s\n", isaNames[isa], "not supported");
+            continue;
+        }
+        double seconds = bestSeconds([&] {
+            evaluateColumns(program, inputs.data(), rows, output.data(), errors.data(), ColumnIsa(isa));
+        });
+        report(isaNames[isa], double(rows), seconds, "rows/s");
+    }
+    sink = output[rows / 2];
+}
+
+static void benchmarkColumns(std::size_t rows) {
+    benchmarkColumnExpression("x * 1.2 - 3 / y", rows);
+    benchmarkColumnExpression("sqrt(x) * ln(y) + x ^ 0.5", rows);
+}
+
+// the C library function each kernel stands in for, in the order of Function
+static double (*const libraryFunctions[])(double) = {
+    nullptr, std::sqrt, std::exp, std::log, std::log10, std::sin, std::cos, std::tan, std::asin, std::acos, std::atan
+};
+
+/* applies every function with a kernel, and x^y, to count random arguments
+one at a time, through the kernels the keypad and calc-batch use and through
+the C library */
+static void benchmarkFunctions(std::size_t count) {
+    std::mt19937_64 random(4);
+    std::uniform_real_distribution<double> number(0.01, 1.0);
+    std::uniform_real_distribution<double> exponent(-30.0, 30.0);
+    std::vector<double> x(count), y(count);
+    for(std::size_t i = 0; i < count; i++) {
+        x[i] = number(random);
+        y[i] = exponent(random);
+    }
+
+    std::printf("functions, %zu arguments\n", count);
+    for(int function = int(Function::SquareRoot); function <= int(Function::ArcTangent); function++) {
+        double kernel = bestSeconds([&] {
+            double sum = 0;
+            for(double value : x) {
+                applyFunction(Function(function), value);
+                sum += value;
+            }
+            sink = sum;
+        });
+        double library = bestSeconds([&] {
+            double sum = 0;
+            for(double value : x)
+                sum += libraryFunctions[function](value);
+            sink = sum;
+        });
+        std::printf("  %-12s %14.0f %14.0f ops/s, the C library\n", functionName(Function(function)),
+                    double(count) / kernel, double(count) / library);
+    }
+    double kernel = bestSeconds([&] {
+        double sum = 0;
+        for(std::size_t i = 0; i < count; i++) {
+            double value = x[i];
+            raisePower(value, y[i]);
+            sum += value;
+        }
+        sink = sum;
+    });
+    double library = bestSeconds([&] {
+        double sum = 0;
+        for(std::size_t i = 0; i < count; i++)
+            sum += std::pow(x[i], y[i]);
+        sink = sum;
+    });
+    std::printf("  %-12s %14.0f %14.0f ops/s, the C library\n", "^", double(count) / kernel, double(count) / library);
+}
+
+#if defined(CALC_BENCH_QT)
+/* writes count doubles as text and reads them back, through QString like the
+window did and through the number codec. Half of them are numbers as typed,
+with a few decimals, the other half are results with every digit */
+static void benchmarkCodec(std::size_t count) {
+    std::mt19937_64 random(3);
+    std::uniform_int_distribution<int> typed(-100000, 100000);
+    std::uniform_real_distribution<double> mantissa(-1.0, 1.0);
+    std::uniform_int_distribution<int> exponent(-20, 20);
+    std::vector<double> values(count);
+    for(std::size_t i = 0; i < count; i++)
+        values[i] = i % 2 ? typed(random) / 100.0 : mantissa(random) * std::pow(10.0, exponent(random));
+
+    // the texts read back are the shortest ones, which both can read
+    char buffer[MaxDoubleText];
+    std::vector<std::string> texts(count);
+    std::vector<QString> qtTexts(count);
+    for(std::size_t i = 0; i < count; i++) {
+        texts[i].assign(buffer, formatShortest(buffer, values[i]));
+        qtTexts[i] = QString::fromLatin1(texts[i].data(), int(texts[i].size()));
+    }
+
+    std::printf("number codec, %zu doubles\n", count);
+    double seconds = bestSeconds([&] {
+        double length = 0;
+        for(double value : values)
+            length += QString::number(value).size();
+        sink = length;
+    });
+    report("QString::number, 6 digits", double(count), seconds);
+    seconds = bestSeconds([&] {
+        double length = 0;
+        for(double value : values)
+            length += QString::number(value, 'g', QLocale::FloatingPointShortest).size();
+        sink = length;
+    });
+    report("QString::number, shortest", double(count), seconds);
+    seconds = bestSeconds([&] {
+        double length = 0;
+        for(double value : values)
+            length += double(formatShortest(buffer, value) - buffer);
+        sink = length;
+    });
+    report("formatShortest", double(count), seconds);
+
+    seconds = bestSeconds([&] {
+        double sum = 0;
+        for(const QString &text : qtTexts)
+            sum += text.toDouble();
+        sink = sum;
+    });
+    report("QString::toDouble", double(count), seconds);
+    seconds = bestSeconds([&] {
+        double sum = 0;
+        for(const std::string &text : texts) {
+            double value;
+            parseDouble(text.data(), text.data() + text.size(), value);
+            sum += value;
+        }
+        sink = sum;
+    });
+    report("parseDouble", double(count), seconds);
+}
+#endif
+
+struct Section {
+    const char *name;
+    void (*run)(std::size_t count);
+    std::size_t defaultCount;
+};
+
+static const Section sections[] = {
+    { "dispatch", benchmarkDispatch, 10000000 },
+    { "columns", benchmarkColumns, 1000000 },
+    { "functions", benchmarkFunctions, 1000000 },
+#if defined(CALC_BENCH_QT)
+    { "codec", benchmarkCodec, 1000000 },
+#endif
+};
+
+static void usage() {
+    std::fprintf(stderr, "usage: calc-bench [-n count] [section ...]\n"
+                         "times the inner loops of the calculator against the code they replaced,\n"
+                         "all sections or the ones named:");
+    for(const Section &section : sections)
+        std::fprintf(stderr, " %s", section.name);
+    std::fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[]) {
+    std::size_t count = 0;
+    std::vector<const Section *> chosen;
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = std::size_t(std::strtoull(argv[++i], nullptr, 10));
+            continue;
+        }
+        const Section *found = nullptr;
+        for(const Section &section : sections) {
+            if(std::strcmp(argv[i], section.name) == 0)
+                found = &section;
+        }
+        if(!found) {
+            usage();
+            return 2;
+        }
+        chosen.push_back(found);
+    }
+    if(chosen.empty()) {
+        for(const Section &section : sections)
+            chosen.push_back(&section);
+    }
+
+    for(const Section *section : chosen)
+        section->run(count ? count : section->defaultCount);
+    return 0;
+}
@@ -0,0 +1,590 @@
+#include "bignum.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <vector>
+
+// below this many limbs multiplying limb by limb beats splitting the numbers up
+static const std::size_t KaratsubaThreshold = 32;
+
+static const std::uint64_t PowersOfTen[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+    100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+    10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+};
+
+// the pool keeps freed blocks of 8, 16, 32 ... limbs for the thread that freed them
+static const std::size_t PoolClasses = 20;
+static const std::size_t MaxPooledBlocks = 32;
+
+struct LimbPool {
+    std::vector<std::uint32_t *> blocks[PoolClasses];
+
+    ~LimbPool();
+};
+
+static thread_local bool poolAlive = true;
+static thread_local LimbPool pool;
+
+LimbPool::~LimbPool() {
+    for(std::vector<std::uint32_t *> &list : blocks) {
+        for(std::uint32_t *block : list)
+            delete[] block;
+    }
+    // numbers freed after this point on this thread go straight back to the heap
+    poolAlive = false;
+}
+
+// hands out a block of at least wanted limbs, taking it from the pool when there is one
+static std::uint32_t *allocateLimbs(std::size_t wanted, std::uint32_t &capacity) {
+    std::size_t sizeClass = 0;
+    while(sizeClass < PoolClasses && (std::size_t(8) << sizeClass) < wanted)
+        sizeClass++;
+    if(sizeClass == PoolClasses || !poolAlive) {
+        capacity = std::uint32_t(wanted);
+        return new std::uint32_t[wanted];
+    }
+
+    capacity = std::uint32_t(8) << sizeClass;
+    std::vector<std::uint32_t *> &list = pool.blocks[sizeClass];
+    if(!list.empty()) {
+        std::uint32_t *block = list.back();
+        list.pop_back();
+        return block;
+    }
+    return new std::uint32_t[capacity];
+}
+
+// gives a block back to the pool, or to the heap if the pool has enough of its size
+static void releaseLimbs(std::uint32_t *block, std::uint32_t capacity) {
+    if(poolAlive) {
+        for(std::size_t sizeClass = 0; sizeClass < PoolClasses; sizeClass++) {
+            if((std::uint32_t(8) << sizeClass) == capacity) {
+                std::vector<std::uint32_t *> &list = pool.blocks[sizeClass];
+                if(list.size() < MaxPooledBlocks) {
+                    list.push_back(block);
+                    return;
+                }
+                break;
+            }
+        }
+    }
+    delete[] block;
+}
+
+static unsigned leadingZeros(std::uint32_t value) {
+#if defined(__GNUC__)
+    return value ? unsigned(__builtin_clz(value)) : 32;
+#else
+    unsigned zeros = 0;
+    for(std::uint32_t bit = 0x80000000u; bit && !(value & bit); bit >>= 1)
+        zeros++;
+    return zeros;
+#endif
+}
+
+static unsigned trailingZeros(std::uint32_t value) {
+#if defined(__GNUC__)
+    return value ? unsigned(__builtin_ctz(value)) : 32;
+#else
+    unsigned zeros = 0;
+    for(std::uint32_t bit = 1; bit && !(value & bit); bit <<= 1)
+        zeros++;
+    return zeros;
+#endif
+}
+
+// dst += src, the carry runs on through dst but never past its end
+static void addInto(std::uint32_t *dst, std::size_t dstCount, const std::uint32_t *src, std::size_t srcCount) {
+    while(srcCount && src[srcCount - 1] == 0)
+        srcCount--;
+    std::uint64_t carry = 0;
+    std::size_t i = 0;
+    for(; i < srcCount; i++) {
+        std::uint64_t sum = std::uint64_t(dst[i]) + src[i] + carry;
+        dst[i] = std::uint32_t(sum);
+        carry = sum >> 32;
+    }
+    for(; carry && i < dstCount; i++) {
+        std::uint64_t sum = std::uint64_t(dst[i]) + carry;
+        dst[i] = std::uint32_t(sum);
+        carry = sum >> 32;
+    }
+}
+
+// dst -= src, dst must not be smaller than src
+static void subtractFrom(std::uint32_t *dst, std::size_t dstCount, const std::uint32_t *src, std::size_t srcCount) {
+    std::int64_t borrow = 0;
+    std::size_t i = 0;
+    for(; i < srcCount; i++) {
+        std::int64_t difference = std::int64_t(dst[i]) - src[i] - borrow;
+        dst[i] = std::uint32_t(difference);
+        borrow = difference < 0;
+    }
+    for(; borrow && i < dstCount; i++) {
+        std::int64_t difference = std::int64_t(dst[i]) - borrow;
+        dst[i] = std::uint32_t(difference);
+        borrow = difference < 0;
+    }
+}
+
+// out = a * b limb by limb, out has room for na + nb limbs
+static void multiplySchoolbook(const std::uint32_t *a, std::size_t na, const std::uint32_t *b, std::size_t nb,
+                               std::uint32_t *out) {
+    std::memset(out, 0, (na + nb) * sizeof(std::uint32_t));
+    for(std::size_t i = 0; i < na; i++) {
+        std::uint64_t carry = 0;
+        for(std::size_t j = 0; j < nb; j++) {
+            std::uint64_t product = std::uint64_t(a[i]) * b[j] + out[i + j] + carry;
+            out[i + j] = std::uint32_t(product);
+            carry = product >> 32;
+        }
+        out[i + nb] = std::uint32_t(carry);
+    }
+}
+
+static void multiplySpans(const std::uint32_t *a, std::size_t na, const std::uint32_t *b, std::size_t nb,
+                          std::uint32_t *out);
+
+/* out = a * b for two numbers of n limbs each, as three half size products:
+a0 * b0, a1 * b1 and (a0 + a1) * (b0 + b1), the middle one minus the other two */
+static void multiplyKaratsuba(const std::uint32_t *a, const std::uint32_t *b, std::size_t n, std::uint32_t *out) {
+    std::size_t low = n / 2;
+    std::size_t high = n - low;
+
+    multiplySpans(a, low, b, low, out);
+    multiplySpans(a + low, high, b + low, high, out + 2 * low);
+
+    std::vector<std::uint32_t> sumA(high + 1, 0), sumB(high + 1, 0), middle(2 * high + 2);
+    std::memcpy(sumA.data(), a + low, high * sizeof(std::uint32_t));
+    std::memcpy(sumB.data(), b + low, high * sizeof(std::uint32_t));
+    addInto(sumA.data(), high + 1, a, low);
+    addInto(sumB.data(), high + 1, b, low);
+    multiplySpans(sumA.data(), high + 1, sumB.data(), high + 1, middle.data());
+
+    subtractFrom(middle.data(), middle.size(), out, 2 * low);
+    subtractFrom(middle.data(), middle.size(), out + 2 * low, 2 * high);
+    addInto(out + low, 2 * n - low, middle.data(), middle.size());
+}
+
+// out = a * b, out has room for na + nb limbs
+static void multiplySpans(const std::uint32_t *a, std::size_t na, const std::uint32_t *b, std::size_t nb,
+                          std::uint32_t *out) {
+    if(na < nb) {
+        std::swap(a, b);
+        std::swap(na, nb);
+    }
+    if(nb < KaratsubaThreshold) {
+        multiplySchoolbook(a, na, b, nb, out);
+        return;
+    }
+    if(na == nb) {
+        multiplyKaratsuba(a, b, na, out);
+        return;
+    }
+
+    // a much longer number is multiplied a piece as long as the shorter one at a time
+    std::memset(out, 0, (na + nb) * sizeof(std::uint32_t));
+    std::vector<std::uint32_t> piece(2 * nb);
+    for(std::size_t offset = 0; offset < na; offset += nb) {
+        std::size_t length = std::min(nb, na - offset);
+        multiplySpans(a + offset, length, b, nb, piece.data());
+        addInto(out + offset, na + nb - offset, piece.data(), length + nb);
+    }
+}
+
+Natural::Natural()
+    : limbs(inlineLimbs), count(0), capacity(InlineLimbs)
+{
+}
+
+Natural::Natural(std::uint64_t value)
+    : limbs(inlineLimbs), count(0), capacity(InlineLimbs)
+{
+    limbs[0] = std::uint32_t(value);
+    limbs[1] = std::uint32_t(value >> 32);
+    count = limbs[1] ? 2 : limbs[0] ? 1 : 0;
+}
+
+Natural::Natural(const Natural &other)
+    : limbs(inlineLimbs), count(0), capacity(InlineLimbs)
+{
+    reserve(other.count);
+    std::memcpy(limbs, other.limbs, other.count * sizeof(std::uint32_t));
+    count = other.count;
+}
+
+Natural::Natural(Natural &&other) noexcept
+    : limbs(inlineLimbs), count(other.count), capacity(InlineLimbs)
+{
+    if(other.limbs == other.inlineLimbs) {
+        std::memcpy(inlineLimbs, other.inlineLimbs, sizeof(inlineLimbs));
+    } else {
+        // take over the limbs of the other number, leaving it empty
+        limbs = other.limbs;
+        capacity = other.capacity;
+        other.limbs = other.inlineLimbs;
+        other.capacity = InlineLimbs;
+    }
+    other.count = 0;
+}
+
+Natural::~Natural() {
+    if(limbs != inlineLimbs)
+        releaseLimbs(limbs, capacity);
+}
+
+Natural &Natural::operator=(const Natural &other) {
+    if(this != &other) {
+        reserve(other.count);
+        std::memcpy(limbs, other.limbs, other.count * sizeof(std::uint32_t));
+        count = other.count;
+    }
+    return *this;
+}
+
+Natural &Natural::operator=(Natural &&other) noexcept {
+    if(this == &other)
+        return *this;
+    if(other.limbs == other.inlineLimbs) {
+        // a small number is copied, whatever storage this one has is kept for later
+        std::memcpy(limbs, other.inlineLimbs, other.count * sizeof(std::uint32_t));
+    } else {
+        if(limbs != inlineLimbs)
+            releaseLimbs(limbs, capacity);
+        limbs = other.limbs;
+        capacity = other.capacity;
+        other.limbs = other.inlineLimbs;
+        other.capacity = InlineLimbs;
+    }
+    count = other.count;
+    other.count = 0;
+    return *this;
+}
+
+// makes room for limbCount limbs, keeping the current ones
+void Natural::reserve(std::size_t limbCount) {
+    if(limbCount <= capacity)
+        return;
+    std::uint32_t newCapacity;
+    std::uint32_t *newLimbs = allocateLimbs(limbCount, newCapacity);
+    std::memcpy(newLimbs, limbs, count * sizeof(std::uint32_t));
+    if(limbs != inlineLimbs)
+        releaseLimbs(limbs, capacity);
+    limbs = newLimbs;
+    capacity = newCapacity;
+}
+
+// sets the number of limbs, the new ones are left for the caller to fill in
+void Natural::resize(std::size_t limbCount) {
+    reserve(limbCount);
+    count = std::uint32_t(limbCount);
+}
+
+// drops zero limbs from the top, so that the top limb of a number is never zero
+void Natural::trim() {
+    while(count && limbs[count - 1] == 0)
+        count--;
+}
+
+std::uint64_t Natural::low64() const {
+    if(count == 0)
+        return 0;
+    if(count == 1)
+        return limbs[0];
+    return limbs[0] | (std::uint64_t(limbs[1]) << 32);
+}
+
+std::size_t Natural::bitLength() const {
+    if(count == 0)
+        return 0;
+    return std::size_t(count) * 32 - leadingZeros(limbs[count - 1]);
+}
+
+// function is invoked to count decimal digits, estimating from the bits and checking the estimate
+std::size_t Natural::digitCount() const {
+    if(count == 0)
+        return 0;
+    if(fitsIn64()) {
+        std::uint64_t value = low64();
+        std::size_t digits = 1;
+        while(digits < 20 && value >= PowersOfTen[digits])
+            digits++;
+        return digits;
+    }
+    // 2^(bits - 1) <= value < 2^bits, so the digits are one of two counts
+    std::size_t digits = std::size_t(double(bitLength() - 1) * 0.30102999566398120) + 1;
+    if(compare(*this, powerOfTen(digits)) >= 0)
+        digits++;
+    return digits;
+}
+
+void Natural::multiplySmall(std::uint32_t factor, std::uint32_t addend) {
+    std::uint64_t carry = addend;
+    for(std::uint32_t i = 0; i < count; i++) {
+        std::uint64_t product = std::uint64_t(limbs[i]) * factor + carry;
+        limbs[i] = std::uint32_t(product);
+        carry = product >> 32;
+    }
+    if(carry) {
+        reserve(std::size_t(count) + 1);
+        limbs[count++] = std::uint32_t(carry);
+    }
+    trim();
+}
+
+std::uint32_t Natural::divideSmall(std::uint32_t divisor) {
+    std::uint64_t remainder = 0;
+    for(std::uint32_t i = count; i-- > 0;) {
+        std::uint64_t current = (remainder << 32) | limbs[i];
+        limbs[i] = std::uint32_t(current / divisor);
+        remainder = current % divisor;
+    }
+    trim();
+    return std::uint32_t(remainder);
+}
+
+void Natural::shiftLeft(std::size_t bits) {
+    if(count == 0 || bits == 0)
+        return;
+    std::size_t limbShift = bits / 32;
+    unsigned bitShift = unsigned(bits % 32);
+    std::size_t oldCount = count;
+
+    resize(oldCount + limbShift + 1);
+    limbs[oldCount + limbShift] = 0;
+    // from the top down, every limb lands at or above where it was
+    for(std::size_t i = oldCount; i-- > 0;) {
+        std::uint64_t shifted = std::uint64_t(limbs[i]) << bitShift;
+        limbs[i + limbShift + 1] |= std::uint32_t(shifted >> 32);
+        limbs[i + limbShift] = std::uint32_t(shifted);
+    }
+    std::memset(limbs, 0, limbShift * sizeof(std::uint32_t));
+    trim();
+}
+
+void Natural::shiftRight(std::size_t bits) {
+    std::size_t limbShift = bits / 32;
+    unsigned bitShift = unsigned(bits % 32);
+    if(limbShift >= count) {
+        count = 0;
+        return;
+    }
+
+    std::size_t newCount = count - limbShift;
+    for(std::size_t i = 0; i < newCount; i++) {
+        std::uint32_t low = limbs[i + limbShift] >> bitShift;
+        std::uint32_t high = 0;
+        if(bitShift && i + limbShift + 1 < count)
+            high = limbs[i + limbShift + 1] << (32 - bitShift);
+        limbs[i] = low | high;
+    }
+    count = std::uint32_t(newCount);
+    trim();
+}
+
+std::size_t Natural::trailingZeroBits() const {
+    for(std::uint32_t i = 0; i < count; i++) {
+        if(limbs[i])
+            return std::size_t(i) * 32 + trailingZeros(limbs[i]);
+    }
+    return 0;
+}
+
+int Natural::compare(const Natural &a, const Natural &b) {
+    if(a.count != b.count)
+        return a.count < b.count ? -1 : 1;
+    for(std::uint32_t i = a.count; i-- > 0;) {
+        if(a.limbs[i] != b.limbs[i])
+            return a.limbs[i] < b.limbs[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+Natural Natural::add(const Natural &a, const Natural &b) {
+    // two 64-bit numbers add up in one go
+    if(a.fitsIn64() && b.fitsIn64()) {
+        std::uint64_t x = a.low64();
+        std::uint64_t sum = x + b.low64();
+        Natural result(sum);
+        if(sum < x) {
+            result.resize(3);
+            result.limbs[0] = std::uint32_t(sum);
+            result.limbs[1] = std::uint32_t(sum >> 32);
+            result.limbs[2] = 1;
+        }
+        return result;
+    }
+
+    const Natural &longer = a.count >= b.count ? a : b;
+    const Natural &shorter = a.count >= b.count ? b : a;
+    Natural result;
+    result.resize(std::size_t(longer.count) + 1);
+    std::memcpy(result.limbs, longer.limbs, longer.count * sizeof(std::uint32_t));
+    result.limbs[longer.count] = 0;
+    addInto(result.limbs, result.count, shorter.limbs, shorter.count);
+    result.trim();
+    return result;
+}
+
+Natural Natural::subtract(const Natural &a, const Natural &b) {
+    if(a.fitsIn64())
+        return Natural(a.low64() - b.low64());
+
+    Natural result(a);
+    subtractFrom(result.limbs, result.count, b.limbs, b.count);
+    result.trim();
+    return result;
+}
+
+Natural Natural::multiply(const Natural &a, const Natural &b) {
+    if(a.count == 0 || b.count == 0)
+        return Natural();
+    // two single limbs multiply in one go
+    if(a.count == 1 && b.count == 1)
+        return Natural(std::uint64_t(a.limbs[0]) * b.limbs[0]);
+
+    Natural result;
+    result.resize(std::size_t(a.count) + b.count);
+    multiplySpans(a.limbs, a.count, b.limbs, b.count, result.limbs);
+    result.trim();
+    return result;
+}
+
+// function is invoked to divide, by knuth's algorithm d when the divisor has more than one limb
+void Natural::divide(const Natural &a, const Natural &b, Natural &quotient, Natural &remainder) {
+    if(compare(a, b) < 0) {
+        remainder = a;
+        quotient = Natural();
+        return;
+    }
+    if(a.fitsIn64()) {
+        std::uint64_t x = a.low64();
+        std::uint64_t y = b.low64();
+        quotient = Natural(x / y);
+        remainder = Natural(x % y);
+        return;
+    }
+    if(b.count == 1) {
+        Natural result(a);
+        std::uint32_t rest = result.divideSmall(b.limbs[0]);
+        quotient = std::move(result);
+        remainder = Natural(rest);
+        return;
+    }
+
+    // normalise so that the top bit of the divisor is set, which keeps every quotient guess close
+    const std::size_t m = a.count;
+    const std::size_t n = b.count;
+    const unsigned shift = leadingZeros(b.limbs[n - 1]);
+    Natural divisor(b);
+    divisor.shiftLeft(shift);
+    Natural dividend(a);
+    dividend.shiftLeft(shift);
+    dividend.reserve(m + 1);
+    for(std::size_t i = dividend.count; i < m + 1; i++)
+        dividend.limbs[i] = 0;
+    dividend.count = std::uint32_t(m + 1);
+
+    std::uint32_t *un = dividend.limbs;
+    const std::uint32_t *vn = divisor.limbs;
+    Natural result;
+    result.resize(m - n + 1);
+
+    for(std::size_t j = m - n + 1; j-- > 0;) {
+        // guess the next quotient limb from the top two limbs, then correct the guess
+        std::uint64_t top = (std::uint64_t(un[j + n]) << 32) | un[j + n - 1];
+        std::uint64_t guess = top / vn[n - 1];
+        std::uint64_t rest = top % vn[n - 1];
+        while(guess >> 32 || guess * vn[n - 2] > ((rest << 32) | un[j + n - 2])) {
+            guess--;
+            rest += vn[n - 1];
+            if(rest >> 32)
+                break;
+        }
+
+        // subtract guess times the divisor
+        std::int64_t borrow = 0;
+        std::int64_t difference;
+        for(std::size_t i = 0; i < n; i++) {
+            std::uint64_t product = guess * vn[i];
+            difference = std::int64_t(un[i + j]) - borrow - std::int64_t(product & 0xFFFFFFFFu);
+            un[i + j] = std::uint32_t(difference);
+            borrow = std::int64_t(product >> 32) - (difference >> 32);
+        }
+        difference = std::int64_t(un[j + n]) - borrow;
+        un[j + n] = std::uint32_t(difference);
+
+        // the guess was still one too high, add the divisor back once
+        if(difference < 0) {
+            guess--;
+            std::uint64_t carry = 0;
+            for(std::size_t i = 0; i < n; i++) {
+                std::uint64_t sum = std::uint64_t(un[i + j]) + vn[i] + carry;
+                un[i + j] = std::uint32_t(sum);
+                carry = sum >> 32;
+            }
+            un[j + n] += std::uint32_t(carry);
+        }
+        result.limbs[j] = std::uint32_t(guess);
+    }
+
+    result.trim();
+    quotient = std::move(result);
+    dividend.count = std::uint32_t(n);
+    dividend.trim();
+    dividend.shiftRight(shift);
+    remainder = std::move(dividend);
+}
+
+// function is invoked to build 10^exponent, as 5^exponent shifted left for large exponents
+Natural Natural::powerOfTen(std::size_t exponent) {
+    if(exponent < 20)
+        return Natural(PowersOfTen[exponent]);
+
+    if(exponent < 300) {
+        Natural result(1);
+        for(; exponent >= 9; exponent -= 9)
+            result.multiplySmall(1000000000u);
+        result.multiplySmall(std::uint32_t(PowersOfTen[exponent]));
+        return result;
+    }
+
+    // square and multiply, so that the big products go through karatsuba
+    Natural result(1);
+    Natural base(5);
+    for(std::size_t bits = exponent; bits; bits >>= 1) {
+        if(bits & 1)
+            result = multiply(result, base);
+        if(bits > 1)
+            base = multiply(base, base);
+    }
+    result.shiftLeft(exponent);
+    return result;
+}
+
+std::string Natural::toString() const {
+    char buffer[24];
+    if(fitsIn64()) {
+        std::to_chars_result written = std::to_chars(buffer, buffer + sizeof(buffer), low64());
+        return std::string(buffer, written.ptr);
+    }
+
+    // cut the number into groups of nine digits, lowest group first
+    std::vector<std::uint32_t> groups;
+    Natural rest(*this);
+    while(!rest.isZero())
+        groups.push_back(rest.divideSmall(1000000000u));
+
+    std::string text;
+    text.reserve(groups.size() * 9);
+    std::to_chars_result written = std::to_chars(buffer, buffer + sizeof(buffer), groups.back());
+    text.append(buffer, written.ptr);
+    for(std::size_t i = groups.size() - 1; i-- > 0;) {
+        written = std::to_chars(buffer, buffer + sizeof(buffer), groups[i]);
+        text.append(9 - std::size_t(written.ptr - buffer), '0');
+        text.append(buffer, written.ptr);
+    }
+    return text;
+}
@@ -0,0 +1,68 @@
+#ifndef BIGNUM_H
+#define BIGNUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* a non-negative integer of any size, as 32-bit limbs with the lowest limb
+first. Up to 128 bits are kept inside the object itself, so small numbers
+never allocate, larger ones take their limbs from a per-thread pool */
+class Natural
+{
+public:
+    Natural();
+    Natural(std::uint64_t value);
+    Natural(const Natural &other);
+    Natural(Natural &&other) noexcept;
+    ~Natural();
+
+    Natural &operator=(const Natural &other);
+    Natural &operator=(Natural &&other) noexcept;
+
+    bool isZero() const { return count == 0; }
+    bool isOdd() const { return count != 0 && (limbs[0] & 1); }
+    bool fitsIn64() const { return count <= 2; }
+    // the value, only meaningful if it fits in 64 bits
+    std::uint64_t low64() const;
+
+    std::size_t size() const { return count; }
+    const std::uint32_t *data() const { return limbs; }
+    std::size_t bitLength() const;
+    // the number of decimal digits, 0 for zero
+    std::size_t digitCount() const;
+
+    // this = this * factor + addend
+    void multiplySmall(std::uint32_t factor, std::uint32_t addend = 0);
+    // this = this / divisor, returns the remainder
+    std::uint32_t divideSmall(std::uint32_t divisor);
+    void shiftLeft(std::size_t bits);
+    void shiftRight(std::size_t bits);
+    // the number of zero bits below the lowest one bit, 0 for zero
+    std::size_t trailingZeroBits() const;
+
+    static int compare(const Natural &a, const Natural &b);
+    static Natural add(const Natural &a, const Natural &b);
+    // a - b, b must not be greater than a
+    static Natural subtract(const Natural &a, const Natural &b);
+    static Natural multiply(const Natural &a, const Natural &b);
+    // divides a by b, b must not be zero
+    static void divide(const Natural &a, const Natural &b, Natural &quotient, Natural &remainder);
+    static Natural powerOfTen(std::size_t exponent);
+
+    std::string toString() const;
+
+private:
+    void reserve(std::size_t limbCount);
+    void resize(std::size_t limbCount);
+    void trim();
+
+    enum { InlineLimbs = 4 };
+
+    std::uint32_t *limbs;
+    std::uint32_t count;
+    std::uint32_t capacity;
+    std::uint32_t inlineLimbs[InlineLimbs];
+};
+
+#endif // BIGNUM_H
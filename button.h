@@ -2,6 +2,7 @@
 #define BUTTON_H
 
 #include <QToolButton>
+#include "operators.h"
 
 class Button: public QToolButton {
     Q_OBJECT
@@ -10,6 +11,13 @@ public:
     explicit Button(const QString &text, QWidget *parent = nullptr);
 
     QSize sizeHint() const override;
+
+    // the operator of the button, None for anything that is not an operator
+    Operator buttonOperator() const { return op; }
+    void setButtonOperator(Operator buttonOp) { op = buttonOp; }
+
+private:
+    Operator op = Operator::None;
 };
 
 #endif // BUTTON_H
@@ -0,0 +1,175 @@
+#include "bytecode.h"
+#include "expression.h"
+#include "jit.h"
+#include <cstring>
+
+// there are never more registers than an instruction can address
+static const std::size_t MaxRegisters = 65536;
+
+Program::Program() {
+}
+
+Program::~Program() {
+}
+
+// function is invoked to turn a tree into instructions, lowest registers first
+bool Program::compile(const Expression &expression) {
+    code.clear();
+    constants.clear();
+    freeSlots.clear();
+    // a new expression starts interpreted again
+    native.reset();
+    evaluations = 0;
+    if(expression.rootNode() < 0)
+        return false;
+
+    inputs = expression.variableNames().size();
+
+    // the constants come first, so gather the ones still in the tree before any register is handed out
+    constantSlots.assign(expression.nodeList().size(), -1);
+    gatherConstants(expression, expression.rootNode());
+    registers = constants.size() + inputs;
+    if(registers > MaxRegisters)
+        return false;
+
+    int top = compileNode(expression, expression.rootNode());
+    freeSlots.clear();
+    constantSlots.clear();
+    if(top < 0)
+        return false;
+    result = std::uint16_t(top);
+    return true;
+}
+
+// gives every constant reachable from a node its register
+void Program::gatherConstants(const Expression &expression, int index) {
+    const Node &node = expression.nodeList()[index];
+    if(node.kind == Node::Constant) {
+        constantSlots[index] = int(constants.size());
+        constants.push_back(node.value);
+        return;
+    }
+    if(node.left >= 0)
+        gatherConstants(expression, node.left);
+    if(node.right >= 0)
+        gatherConstants(expression, node.right);
+}
+
+// returns the register holding the value of a node, or -1 if the registers run out
+int Program::compileNode(const Expression &expression, int index) {
+    const Node &node = expression.nodeList()[index];
+
+    switch(node.kind) {
+    case Node::Constant:
+        return constantSlots[index];
+    case Node::Variable:
+        return int(constants.size()) + node.variable;
+    default:
+        break;
+    }
+
+    int a = compileNode(expression, node.left);
+    int b = node.right >= 0 ? compileNode(expression, node.right) : a;
+    if(a < 0 || b < 0)
+        return -1;
+    // the operands are read before the result is written, so the result may reuse their registers
+    release(a);
+    if(b != a)
+        release(b);
+    int dest = allocate();
+    if(dest < 0)
+        return -1;
+
+    OpCode opCode = OpCode::Negate;
+    if(node.kind == Node::Percent) {
+        opCode = OpCode::Percent;
+    } else if(node.kind == Node::Function) {
+        opCode = OpCode::Function;
+    } else if(node.kind == Node::Binary) {
+        switch(node.op) {
+        case Operator::Add: opCode = OpCode::Add; break;
+        case Operator::Subtract: opCode = OpCode::Subtract; break;
+        case Operator::Multiply: opCode = OpCode::Multiply; break;
+        case Operator::Divide: opCode = OpCode::Divide; break;
+        case Operator::Power: opCode = OpCode::Power; break;
+        default: return -1;
+        }
+    }
+    code.push_back({ opCode, node.function, std::uint16_t(dest), std::uint16_t(a), std::uint16_t(b) });
+    return dest;
+}
+
+// hands out a temporary register, reusing one that was given back if there is one
+int Program::allocate() {
+    if(!freeSlots.empty()) {
+        int slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+    if(registers == MaxRegisters)
+        return -1;
+    return int(registers++);
+}
+
+// gives back a temporary register, constants and inputs are never given back
+void Program::release(int slot) {
+    if(std::size_t(slot) >= constants.size() + inputs)
+        freeSlots.push_back(slot);
+}
+
+// function is invoked to run the instructions once
+bool Program::run(const double *inputValues, double *scratch, double &value) const {
+    std::memcpy(scratch, constants.data(), constants.size() * sizeof(double));
+    std::memcpy(scratch + constants.size(), inputValues, inputs * sizeof(double));
+
+    for(const Instruction &instruction : code) {
+        double a = scratch[instruction.a];
+        double b = scratch[instruction.b];
+        double &dest = scratch[instruction.dest];
+        switch(instruction.code) {
+        case OpCode::Add: dest = a + b; break;
+        case OpCode::Subtract: dest = a - b; break;
+        case OpCode::Multiply: dest = a * b; break;
+        case OpCode::Divide:
+            // dividing by 0 stops the program, like it aborts the calculator
+            if(b == 0)
+                return false;
+            dest = a / b;
+            break;
+        case OpCode::Negate: dest = -a; break;
+        case OpCode::Percent: dest = a / 100; break;
+        case OpCode::Power:
+            if(!raisePower(a, b))
+                return false;
+            dest = a;
+            break;
+        case OpCode::Function:
+            if(!applyFunction(instruction.function, a))
+                return false;
+            dest = a;
+            break;
+        }
+    }
+    value = scratch[result];
+    return true;
+}
+
+bool Program::evaluate(const double *inputValues, double &value) {
+    thread_local std::vector<double> scratch;
+    if(scratch.size() < registers)
+        scratch.resize(registers);
+    if(native)
+        return native->run(inputValues, scratch.data(), value);
+
+    // compiling is only tried once, a program that cannot be compiled stays interpreted
+    if(jitThreshold && ++evaluations == jitThreshold) {
+        native.reset(new NativeProgram);
+        if(!native->compile(*this))
+            native.reset();
+    }
+    return run(inputValues, scratch.data(), value);
+}
+
+bool Program::isNative() const {
+    return native != nullptr;
+}
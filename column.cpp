@@ -0,0 +1,295 @@
+#include "column.h"
+#include "bytecode.h"
+#include "mathkernels.h"
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CALC_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// rows are run a block at a time, so that every register of a block stays in the cache
+static const std::size_t BlockRows = 256;
+
+typedef void (*ColumnKernel)(const Instruction &instruction, const double *a, const double *b, double *dest,
+                             unsigned char *errors, std::size_t rows);
+
+// one instruction over a number of rows, one row at a time
+static void scalarKernel(const Instruction &instruction, const double *a, const double *b, double *dest,
+                         unsigned char *errors, std::size_t rows) {
+    switch(instruction.code) {
+    case OpCode::Add:
+        for(std::size_t i = 0; i < rows; i++)
+            dest[i] = a[i] + b[i];
+        break;
+    case OpCode::Subtract:
+        for(std::size_t i = 0; i < rows; i++)
+            dest[i] = a[i] - b[i];
+        break;
+    case OpCode::Multiply:
+        for(std::size_t i = 0; i < rows; i++)
+            dest[i] = a[i] * b[i];
+        break;
+    case OpCode::Divide:
+        // a division by zero only marks its own row, the other rows carry on
+        for(std::size_t i = 0; i < rows; i++) {
+            errors[i] |= b[i] == 0;
+            dest[i] = a[i] / b[i];
+        }
+        break;
+    case OpCode::Negate:
+        for(std::size_t i = 0; i < rows; i++)
+            dest[i] = -a[i];
+        break;
+    case OpCode::Percent:
+        for(std::size_t i = 0; i < rows; i++)
+            dest[i] = a[i] / 100;
+        break;
+    case OpCode::Power:
+        // like a division by zero, a power that fails only marks its own row
+        for(std::size_t i = 0; i < rows; i++) {
+            double value = a[i];
+            errors[i] |= !raisePower(value, b[i]);
+            dest[i] = value;
+        }
+        break;
+    case OpCode::Function:
+        for(std::size_t i = 0; i < rows; i++) {
+            double value = a[i];
+            errors[i] |= !applyFunction(instruction.function, value);
+            dest[i] = value;
+        }
+        break;
+    }
+}
+
+#ifdef CALC_X86_KERNELS
+
+// two lanes of SSE2 for the function kernels of mathkernels.h
+struct Sse2Lanes {
+    typedef __m128d Value;
+    typedef __m128i Bits;
+    typedef __m128d Mask;
+    enum { Width = 2 };
+
+    static Value load(const double *p) { return _mm_loadu_pd(p); }
+    static void store(double *p, Value value) { _mm_storeu_pd(p, value); }
+    static Value splat(double value) { return _mm_set1_pd(value); }
+    static Bits splatBits(std::uint64_t bits) { return _mm_set1_epi64x((long long)bits); }
+    static Bits toBits(Value value) { return _mm_castpd_si128(value); }
+    static Value fromBits(Bits bits) { return _mm_castsi128_pd(bits); }
+    static Bits addBits(Bits a, Bits b) { return _mm_add_epi64(a, b); }
+    static Bits subtractBits(Bits a, Bits b) { return _mm_sub_epi64(a, b); }
+    static Bits andBits(Bits a, Bits b) { return _mm_and_si128(a, b); }
+    static Bits orBits(Bits a, Bits b) { return _mm_or_si128(a, b); }
+    static Bits shiftLeft(Bits bits, int count) { return _mm_slli_epi64(bits, count); }
+    static Bits shiftRight(Bits bits, int count) { return _mm_srli_epi64(bits, count); }
+    static Mask less(Value a, Value b) { return _mm_cmplt_pd(a, b); }
+    static Mask equal(Value a, Value b) { return _mm_cmpeq_pd(a, b); }
+    static Mask both(Mask a, Mask b) { return _mm_and_pd(a, b); }
+    static Mask either(Mask a, Mask b) { return _mm_or_pd(a, b); }
+    static Mask negate(Mask mask) { return _mm_xor_pd(mask, _mm_castsi128_pd(_mm_set1_epi32(-1))); }
+    // SSE2 has no 64-bit compare, so the bit is moved to the top and spread over its lane
+    static Mask bitSet(Bits bits, int bit) {
+        Bits top = _mm_srai_epi32(_mm_slli_epi64(bits, 63 - bit), 31);
+        return _mm_castsi128_pd(_mm_shuffle_epi32(top, _MM_SHUFFLE(3, 3, 1, 1)));
+    }
+    static Value select(Mask mask, Value a, Value b) { return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b)); }
+    static Value sqrt(Value value) { return _mm_sqrt_pd(value); }
+    static int maskBits(Mask mask) { return _mm_movemask_pd(mask); }
+};
+
+// in columnavx2.cpp, which is compiled for AVX2 throughout
+void avx2FunctionRows(Function function, const double *a, double *dest, unsigned char *errors, std::size_t rows);
+void avx2PowerRows(const double *a, const double *b, double *dest, unsigned char *errors, std::size_t rows);
+
+// one instruction over a number of rows, two rows at a time
+static void sse2Kernel(const Instruction &instruction, const double *a, const double *b, double *dest,
+                       unsigned char *errors, std::size_t rows) {
+    std::size_t i = 0;
+    switch(instruction.code) {
+    case OpCode::Add:
+        for(; i + 2 <= rows; i += 2)
+            _mm_storeu_pd(dest + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        break;
+    case OpCode::Subtract:
+        for(; i + 2 <= rows; i += 2)
+            _mm_storeu_pd(dest + i, _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        break;
+    case OpCode::Multiply:
+        for(; i + 2 <= rows; i += 2)
+            _mm_storeu_pd(dest + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        break;
+    case OpCode::Divide: {
+        const __m128d zero = _mm_setzero_pd();
+        for(; i + 2 <= rows; i += 2) {
+            __m128d divisor = _mm_loadu_pd(b + i);
+            // one bit per row that divides by zero, nearly always none
+            int zeros = _mm_movemask_pd(_mm_cmpeq_pd(divisor, zero));
+            if(zeros) {
+                errors[i] |= zeros & 1;
+                errors[i + 1] |= (zeros >> 1) & 1;
+            }
+            _mm_storeu_pd(dest + i, _mm_div_pd(_mm_loadu_pd(a + i), divisor));
+        }
+        break;
+    }
+    case OpCode::Negate: {
+        const __m128d sign = _mm_set1_pd(-0.0);
+        for(; i + 2 <= rows; i += 2)
+            _mm_storeu_pd(dest + i, _mm_xor_pd(_mm_loadu_pd(a + i), sign));
+        break;
+    }
+    case OpCode::Percent: {
+        const __m128d hundred = _mm_set1_pd(100);
+        for(; i + 2 <= rows; i += 2)
+            _mm_storeu_pd(dest + i, _mm_div_pd(_mm_loadu_pd(a + i), hundred));
+        break;
+    }
+    // the kernels of mathkernels.h take every row themselves, gamma has none and goes row by row
+    case OpCode::Power:
+        MathKernels::powerRows<Sse2Lanes>(a, b, dest, errors, rows);
+        return;
+    case OpCode::Function:
+        if(instruction.function == Function::Gamma || instruction.function == Function::Factorial)
+            break;
+        MathKernels::functionRows<Sse2Lanes>(instruction.function, a, dest, errors, rows);
+        return;
+    }
+    // the odd row left over
+    scalarKernel(instruction, a + i, b + i, dest + i, errors + i, rows - i);
+}
+
+// one instruction over a number of rows, four rows at a time
+__attribute__((target("avx2")))
+static void avx2Kernel(const Instruction &instruction, const double *a, const double *b, double *dest,
+                       unsigned char *errors, std::size_t rows) {
+    std::size_t i = 0;
+    switch(instruction.code) {
+    case OpCode::Add:
+        for(; i + 4 <= rows; i += 4)
+            _mm256_storeu_pd(dest + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        break;
+    case OpCode::Subtract:
+        for(; i + 4 <= rows; i += 4)
+            _mm256_storeu_pd(dest + i, _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        break;
+    case OpCode::Multiply:
+        for(; i + 4 <= rows; i += 4)
+            _mm256_storeu_pd(dest + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        break;
+    case OpCode::Divide: {
+        const __m256d zero = _mm256_setzero_pd();
+        for(; i + 4 <= rows; i += 4) {
+            __m256d divisor = _mm256_loadu_pd(b + i);
+            // one bit per row that divides by zero, nearly always none
+            int zeros = _mm256_movemask_pd(_mm256_cmp_pd(divisor, zero, _CMP_EQ_OQ));
+            if(zeros) {
+                for(int lane = 0; lane < 4; lane++)
+                    errors[i + lane] |= (zeros >> lane) & 1;
+            }
+            _mm256_storeu_pd(dest + i, _mm256_div_pd(_mm256_loadu_pd(a + i), divisor));
+        }
+        break;
+    }
+    case OpCode::Negate: {
+        const __m256d sign = _mm256_set1_pd(-0.0);
+        for(; i + 4 <= rows; i += 4)
+            _mm256_storeu_pd(dest + i, _mm256_xor_pd(_mm256_loadu_pd(a + i), sign));
+        break;
+    }
+    case OpCode::Percent: {
+        const __m256d hundred = _mm256_set1_pd(100);
+        for(; i + 4 <= rows; i += 4)
+            _mm256_storeu_pd(dest + i, _mm256_div_pd(_mm256_loadu_pd(a + i), hundred));
+        break;
+    }
+    case OpCode::Power:
+        avx2PowerRows(a, b, dest, errors, rows);
+        return;
+    case OpCode::Function:
+        if(instruction.function == Function::Gamma || instruction.function == Function::Factorial)
+            break;
+        avx2FunctionRows(instruction.function, a, dest, errors, rows);
+        return;
+    }
+    // the rows left over
+    scalarKernel(instruction, a + i, b + i, dest + i, errors + i, rows - i);
+}
+
+#endif
+
+// function is invoked to find out which kernels this processor can run
+ColumnIsa detectColumnIsa() {
+#ifdef CALC_X86_KERNELS
+    if(__builtin_cpu_supports("avx2"))
+        return ColumnIsa::Avx2;
+    if(__builtin_cpu_supports("sse2"))
+        return ColumnIsa::Sse2;
+#endif
+    return ColumnIsa::Scalar;
+}
+
+static ColumnKernel kernelFor(ColumnIsa isa) {
+#ifdef CALC_X86_KERNELS
+    if(isa == ColumnIsa::Avx2)
+        return avx2Kernel;
+    if(isa == ColumnIsa::Sse2)
+        return sse2Kernel;
+#else
+    (void)isa;
+#endif
+    return scalarKernel;
+}
+
+// function is invoked to run a program over whole columns, one block of rows at a time
+std::size_t evaluateColumns(const Program &program, const double *const *inputs, std::size_t rows,
+                            double *output, unsigned char *errors, ColumnIsa isa) {
+    ColumnKernel kernel = kernelFor(isa);
+    const std::vector<double> &constants = program.constantList();
+    const std::size_t firstInput = program.firstInput();
+    const std::size_t firstTemporary = firstInput + program.inputCount();
+
+    // every register is a block of rows: constants are repeated down their block,
+    // inputs point straight into their column, temporaries get blocks of their own
+    std::vector<double> constantBlocks(constants.size() * BlockRows);
+    for(std::size_t c = 0; c < constants.size(); c++) {
+        for(std::size_t i = 0; i < BlockRows; i++)
+            constantBlocks[c * BlockRows + i] = constants[c];
+    }
+    std::vector<double> temporaryBlocks((program.registerCount() - firstTemporary) * BlockRows);
+    std::vector<double *> blocks(program.registerCount());
+    for(std::size_t r = 0; r < firstInput; r++)
+        blocks[r] = &constantBlocks[r * BlockRows];
+    for(std::size_t r = firstTemporary; r < blocks.size(); r++)
+        blocks[r] = &temporaryBlocks[(r - firstTemporary) * BlockRows];
+
+    unsigned char blockErrors[BlockRows];
+    std::size_t failed = 0;
+
+    for(std::size_t row = 0; row < rows; row += BlockRows) {
+        std::size_t count = rows - row < BlockRows ? rows - row : BlockRows;
+        for(std::size_t i = 0; i < program.inputCount(); i++)
+            blocks[firstInput + i] = const_cast<double *>(inputs[i] + row);
+        std::memset(blockErrors, 0, count);
+
+        for(const Instruction &instruction : program.instructions())
+            kernel(instruction, blocks[instruction.a], blocks[instruction.b],
+                   blocks[instruction.dest], blockErrors, count);
+
+        // copy out the results, replacing the ones that failed by NaN
+        std::memcpy(output + row, blocks[program.resultRegister()], count * sizeof(double));
+        for(std::size_t i = 0; i < count; i++) {
+            if(blockErrors[i]) {
+                output[row + i] = std::numeric_limits<double>::quiet_NaN();
+                failed++;
+            }
+        }
+        if(errors)
+            std::memcpy(errors + row, blockErrors, count);
+    }
+    return failed;
+}
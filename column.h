@@ -0,0 +1,27 @@
+#ifndef COLUMN_H
+#define COLUMN_H
+
+#include <cstddef>
+
+class Program;
+
+// the instruction sets the column kernels can use, best last
+enum class ColumnIsa : unsigned char {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+// the best instruction set this processor supports
+ColumnIsa detectColumnIsa();
+
+/* runs a program once per row over columns of doubles. inputs holds one
+column per input of the program, each rows long. A row that divides by zero
+or leaves the domain of a function gets a 1 in errors (if errors is not null)
+and NaN in output, every other row gets a 0 and its result. Returns how many
+rows failed */
+std::size_t evaluateColumns(const Program &program, const double *const *inputs, std::size_t rows,
+                            double *output, unsigned char *errors,
+                            ColumnIsa isa = detectColumnIsa());
+
+#endif // COLUMN_H
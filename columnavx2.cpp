@@ -0,0 +1,61 @@
+#include "column.h"
+#include "functions.h"
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+/* the function kernels of column.cpp, four rows at a time. The templates of
+mathkernels.h only inline the AVX2 intrinsics if they are compiled for AVX2
+themselves, so everything below is, and column.cpp only calls it on a
+processor that has AVX2. FMA is left out on purpose, fusing would round
+differently from the scalar functions */
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+#include "mathkernels.h"
+
+struct Avx2Lanes {
+    typedef __m256d Value;
+    typedef __m256i Bits;
+    typedef __m256d Mask;
+    enum { Width = 4 };
+
+    static Value load(const double *p) { return _mm256_loadu_pd(p); }
+    static void store(double *p, Value value) { _mm256_storeu_pd(p, value); }
+    static Value splat(double value) { return _mm256_set1_pd(value); }
+    static Bits splatBits(std::uint64_t bits) { return _mm256_set1_epi64x((long long)bits); }
+    static Bits toBits(Value value) { return _mm256_castpd_si256(value); }
+    static Value fromBits(Bits bits) { return _mm256_castsi256_pd(bits); }
+    static Bits addBits(Bits a, Bits b) { return _mm256_add_epi64(a, b); }
+    static Bits subtractBits(Bits a, Bits b) { return _mm256_sub_epi64(a, b); }
+    static Bits andBits(Bits a, Bits b) { return _mm256_and_si256(a, b); }
+    static Bits orBits(Bits a, Bits b) { return _mm256_or_si256(a, b); }
+    static Bits shiftLeft(Bits bits, int count) { return _mm256_slli_epi64(bits, count); }
+    static Bits shiftRight(Bits bits, int count) { return _mm256_srli_epi64(bits, count); }
+    static Mask less(Value a, Value b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static Mask equal(Value a, Value b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+    static Mask both(Mask a, Mask b) { return _mm256_and_pd(a, b); }
+    static Mask either(Mask a, Mask b) { return _mm256_or_pd(a, b); }
+    static Mask negate(Mask mask) { return _mm256_xor_pd(mask, _mm256_castsi256_pd(_mm256_set1_epi32(-1))); }
+    static Mask bitSet(Bits bits, int bit) {
+        Bits one = _mm256_set1_epi64x(1LL << bit);
+        return _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(bits, one), one));
+    }
+    static Value select(Mask mask, Value a, Value b) { return _mm256_blendv_pd(b, a, mask); }
+    static Value sqrt(Value value) { return _mm256_sqrt_pd(value); }
+    static int maskBits(Mask mask) { return _mm256_movemask_pd(mask); }
+};
+
+void avx2FunctionRows(Function function, const double *a, double *dest, unsigned char *errors, std::size_t rows) {
+    MathKernels::functionRows<Avx2Lanes>(function, a, dest, errors, rows);
+}
+
+void avx2PowerRows(const double *a, const double *b, double *dest, unsigned char *errors, std::size_t rows) {
+    MathKernels::powerRows<Avx2Lanes>(a, b, dest, errors, rows);
+}
+
+#pragma GCC pop_options
+
+#endif
@@ -0,0 +1,298 @@
+#include "decimal.h"
+#include <charconv>
+#include <utility>
+
+static const std::uint32_t SmallPowersOfTen[] = {
+    1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u
+};
+
+// exponents further out than this are not read, they would only make huge coefficients
+static const long MaxExponent = 100000000;
+
+// multiplies a coefficient by 10^power, in one go for small powers
+static void scaleUp(Natural &coefficient, std::size_t power) {
+    if(power <= 9)
+        coefficient.multiplySmall(SmallPowersOfTen[power]);
+    else
+        coefficient = Natural::multiply(coefficient, Natural::powerOfTen(power));
+}
+
+// rounds half to even, sticky telling that something non-zero was already cut off below the digits
+static void roundCoefficient(Natural &coefficient, std::int32_t &exponent, std::size_t digits, bool sticky) {
+    std::size_t count = coefficient.digitCount();
+    if(count <= digits)
+        return;
+    std::size_t excess = count - digits;
+
+    // cut off the excess digits and compare them with half of what they could be
+    int comparison;
+    if(excess <= 9) {
+        std::uint32_t rest = coefficient.divideSmall(SmallPowersOfTen[excess]);
+        std::uint64_t twice = std::uint64_t(rest) * 2;
+        comparison = twice < SmallPowersOfTen[excess] ? -1 : twice > SmallPowersOfTen[excess] ? 1 : 0;
+    } else {
+        Natural quotient, rest;
+        Natural unit = Natural::powerOfTen(excess);
+        Natural::divide(coefficient, unit, quotient, rest);
+        coefficient = std::move(quotient);
+        rest.shiftLeft(1);
+        comparison = Natural::compare(rest, unit);
+    }
+    exponent += std::int32_t(excess);
+
+    if(comparison > 0 || (comparison == 0 && (sticky || coefficient.isOdd()))) {
+        coefficient = Natural::add(coefficient, Natural(1));
+        // 999 rounding up to 1000 has one digit too many, and a zero to spare
+        if(coefficient.digitCount() > digits) {
+            coefficient.divideSmall(10);
+            exponent++;
+        }
+    }
+}
+
+// writes digits × 10^exponent without an exponent, like 1234.5 or 0.00012
+static std::string plainText(bool negative, const std::string &digits, long exponent) {
+    std::string text;
+    if(negative)
+        text.push_back('-');
+    if(exponent >= 0) {
+        text += digits;
+        text.append(std::size_t(exponent), '0');
+        return text;
+    }
+    long point = long(digits.size()) + exponent;
+    if(point > 0) {
+        text.append(digits, 0, std::size_t(point));
+        text.push_back('.');
+        text.append(digits, std::size_t(point), std::string::npos);
+    } else {
+        text += "0.";
+        text.append(std::size_t(-point), '0');
+        text += digits;
+    }
+    return text;
+}
+
+Decimal::Decimal()
+    : exponent(0), negative(false)
+{
+}
+
+Decimal::Decimal(std::int64_t value)
+    : coefficient(value < 0 ? 0 - std::uint64_t(value) : std::uint64_t(value))
+    , exponent(0), negative(value < 0)
+{
+}
+
+Decimal::Decimal(Natural coefficient, std::int32_t exponent, bool negative)
+    : coefficient(std::move(coefficient)), exponent(exponent), negative(negative)
+{
+}
+
+// function is invoked to read a decimal number out of text
+bool Decimal::parse(const char *text, std::size_t length, Decimal &value) {
+    const char *p = text;
+    const char *end = text + length;
+    Decimal result;
+
+    if(p != end && (*p == '-' || *p == '+')) {
+        result.negative = *p == '-';
+        p++;
+    }
+
+    // the digits are gathered nine at a time, so most numbers take one multiplication
+    std::uint32_t group = 0;
+    std::size_t groupDigits = 0;
+    std::size_t digitsSeen = 0;
+    long fractionDigits = 0;
+    bool seenPoint = false;
+    for(; p != end; p++) {
+        if(*p == '.' && !seenPoint) {
+            seenPoint = true;
+            continue;
+        }
+        if(*p < '0' || *p > '9')
+            break;
+        group = group * 10 + std::uint32_t(*p - '0');
+        groupDigits++;
+        digitsSeen++;
+        fractionDigits += seenPoint;
+        if(groupDigits == 9) {
+            result.coefficient.multiplySmall(SmallPowersOfTen[9], group);
+            group = 0;
+            groupDigits = 0;
+        }
+    }
+    if(digitsSeen == 0)
+        return false;
+    if(groupDigits)
+        result.coefficient.multiplySmall(SmallPowersOfTen[groupDigits], group);
+
+    long exponentValue = 0;
+    if(p != end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExponent = false;
+        if(p != end && (*p == '-' || *p == '+')) {
+            negativeExponent = *p == '-';
+            p++;
+        }
+        if(p == end)
+            return false;
+        for(; p != end && *p >= '0' && *p <= '9'; p++) {
+            exponentValue = exponentValue * 10 + (*p - '0');
+            if(exponentValue > MaxExponent)
+                return false;
+        }
+        if(negativeExponent)
+            exponentValue = -exponentValue;
+    }
+    if(p != end)
+        return false;
+
+    result.exponent = std::int32_t(exponentValue - fractionDigits);
+    value = std::move(result);
+    return true;
+}
+
+Decimal Decimal::operator-() const {
+    Decimal result(*this);
+    result.negative = !negative;
+    return result;
+}
+
+// function is invoked to add, lining both coefficients up to the smaller exponent first
+Decimal Decimal::add(const Decimal &a, const Decimal &b) {
+    if(a.isZero())
+        return b;
+    if(b.isZero())
+        return a;
+
+    Decimal result;
+    result.exponent = a.exponent < b.exponent ? a.exponent : b.exponent;
+    Natural left(a.coefficient);
+    Natural right(b.coefficient);
+    scaleUp(left, std::size_t(a.exponent - result.exponent));
+    scaleUp(right, std::size_t(b.exponent - result.exponent));
+
+    if(a.negative == b.negative) {
+        result.coefficient = Natural::add(left, right);
+        result.negative = a.negative;
+    } else if(Natural::compare(left, right) >= 0) {
+        result.coefficient = Natural::subtract(left, right);
+        result.negative = a.negative;
+    } else {
+        result.coefficient = Natural::subtract(right, left);
+        result.negative = b.negative;
+    }
+    if(result.coefficient.isZero())
+        result.negative = false;
+    return result;
+}
+
+Decimal Decimal::subtract(const Decimal &a, const Decimal &b) {
+    return add(a, -b);
+}
+
+Decimal Decimal::multiply(const Decimal &a, const Decimal &b) {
+    Decimal result;
+    result.coefficient = Natural::multiply(a.coefficient, b.coefficient);
+    result.exponent = a.exponent + b.exponent;
+    result.negative = a.negative != b.negative && !result.coefficient.isZero();
+    return result;
+}
+
+// function is invoked to divide, scaling the dividend so that the quotient has a digit to round with
+bool Decimal::divide(const Decimal &a, const Decimal &b, std::size_t digits, Decimal &quotient) {
+    if(b.isZero())
+        return false;
+    if(a.isZero()) {
+        quotient = Decimal();
+        return true;
+    }
+
+    long shift = long(digits) + 1 + long(b.coefficient.digitCount()) - long(a.coefficient.digitCount());
+    if(shift < 0)
+        shift = 0;
+    Natural dividend(a.coefficient);
+    scaleUp(dividend, std::size_t(shift));
+
+    Decimal result;
+    Natural rest;
+    Natural::divide(dividend, b.coefficient, result.coefficient, rest);
+    result.exponent = std::int32_t(a.exponent - b.exponent - shift);
+    result.negative = a.negative != b.negative;
+    roundCoefficient(result.coefficient, result.exponent, digits, !rest.isZero());
+    quotient = std::move(result);
+    return true;
+}
+
+Decimal Decimal::hundredth() const {
+    Decimal result(*this);
+    result.exponent -= 2;
+    return result;
+}
+
+void Decimal::roundToDigits(std::size_t digits) {
+    roundCoefficient(coefficient, exponent, digits, false);
+}
+
+// function is invoked to write the value for the display
+std::string Decimal::toString(std::size_t maxLength) const {
+    if(isZero())
+        return "0";
+
+    // trailing zeros of the coefficient only move the exponent
+    std::string digits = coefficient.toString();
+    long shift = exponent;
+    while(digits.size() > 1 && digits.back() == '0') {
+        digits.pop_back();
+        shift++;
+    }
+    bool sign = isNegative();
+    std::string text = plainText(sign, digits, shift);
+    if(text.size() <= maxLength)
+        return text;
+
+    // keep the whole part and as many decimals as fit after it, if the whole part fits at all
+    long wholeDigits = long(digits.size()) + shift;
+    long room = long(maxLength) - long(sign) - (wholeDigits > 0 ? wholeDigits : 1) - 1;
+    if(shift < 0 && room > 0 && wholeDigits + room > 0) {
+        Decimal rounded(*this);
+        rounded.roundToDigits(std::size_t(wholeDigits + room));
+        text = rounded.toString(std::size_t(-1));
+        if(text.size() <= maxLength && text != "0" && text != "-0")
+            return text;
+    }
+
+    // otherwise d.ddde+x, with as many digits as the exponent leaves room for
+    long scientificExponent = long(digits.size()) - 1 + shift;
+    std::string exponentText = std::to_string(scientificExponent);
+    long mantissaDigits = long(maxLength) - long(sign) - 2 - long(exponentText.size()) - (scientificExponent >= 0);
+    if(mantissaDigits < 1)
+        mantissaDigits = 1;
+    Decimal rounded(*this);
+    rounded.roundToDigits(std::size_t(mantissaDigits));
+    digits = rounded.coefficient.toString();
+    while(digits.size() > 1 && digits.back() == '0')
+        digits.pop_back();
+    // rounding up may have added a digit in front, as in 9.99 to 10.0
+    scientificExponent = long(rounded.coefficient.digitCount()) - 1 + rounded.exponent;
+
+    text = sign ? "-" : "";
+    text.push_back(digits[0]);
+    if(digits.size() > 1) {
+        text.push_back('.');
+        text.append(digits, 1, std::string::npos);
+    }
+    text += scientificExponent >= 0 ? "e+" : "e";
+    text += std::to_string(scientificExponent);
+    return text;
+}
+
+double Decimal::toDouble() const {
+    // all the digits go to from_chars, which rounds correctly
+    std::string text = coefficient.toString() + "e" + std::to_string(exponent);
+    double value = 0;
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return negative ? -value : value;
+}
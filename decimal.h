@@ -0,0 +1,50 @@
+#ifndef DECIMAL_H
+#define DECIMAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "bignum.h"
+
+/* an exact decimal number, coefficient × 10^exponent. Sums, differences and
+products are exact, quotients are rounded to a number of significant digits.
+The coefficient lives inside the object up to 128 bits */
+class Decimal
+{
+public:
+    Decimal();
+    Decimal(std::int64_t value);
+    // coefficient × 10^exponent
+    Decimal(Natural coefficient, std::int32_t exponent, bool negative);
+
+    // reads [-]digits[.digits][e[+|-]digits], returns false if text is not a number
+    static bool parse(const char *text, std::size_t length, Decimal &value);
+
+    bool isZero() const { return coefficient.isZero(); }
+    bool isNegative() const { return negative && !coefficient.isZero(); }
+    // the number of significant digits of the coefficient
+    std::size_t digitCount() const { return coefficient.digitCount(); }
+
+    Decimal operator-() const;
+    static Decimal add(const Decimal &a, const Decimal &b);
+    static Decimal subtract(const Decimal &a, const Decimal &b);
+    static Decimal multiply(const Decimal &a, const Decimal &b);
+    // a / b rounded to digits significant digits, returns false if b is zero
+    static bool divide(const Decimal &a, const Decimal &b, std::size_t digits, Decimal &quotient);
+    // the value divided by 100, which is exact
+    Decimal hundredth() const;
+
+    // rounds half to even to at most digits significant digits
+    void roundToDigits(std::size_t digits);
+
+    // writes the value in at most maxLength characters, rounding or switching to an exponent if it has to
+    std::string toString(std::size_t maxLength) const;
+    double toDouble() const;
+
+private:
+    Natural coefficient;
+    std::int32_t exponent;
+    bool negative;
+};
+
+#endif // DECIMAL_H
@@ -0,0 +1,13 @@
+#include "display.h"
+#include "latency.h"
+
+// defines the class of Display, containing text and its parent
+Display::Display(const QString &text, QWidget *parent) : QLineEdit(text, parent) {
+}
+
+// paints the line as usual, and only then counts the keystrokes waiting for it as done
+void Display::paintEvent(QPaintEvent *event) {
+    QLineEdit::paintEvent(event);
+    if(tracer)
+        tracer->painted();
+}
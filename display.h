@@ -0,0 +1,24 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <QLineEdit>
+
+class LatencyTracer;
+
+// the line the calculator shows its numbers in, telling a latency tracer when it has painted
+class Display: public QLineEdit {
+    Q_OBJECT
+
+public:
+    explicit Display(const QString &text, QWidget *parent = nullptr);
+
+    void setLatencyTracer(LatencyTracer *latencyTracer) { tracer = latencyTracer; }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    LatencyTracer *tracer = nullptr;
+};
+
+#endif // DISPLAY_H
@@ -0,0 +1,1082 @@
+#include "engine.h"
+#include "expression.h"
+#include "numcodec.h"
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+// the double versions of the templates below are the only ones that inline every operator kernel
+template<typename Number>
+static Number readNumber(const std::string &text);
+
+// reads the displayed text as a double, anything that is not a number reads as 0
+template<>
+double readNumber<double>(const std::string &text) {
+    double value = 0;
+    const char *begin = text.data();
+    const char *end = begin + text.size();
+    if(parseDouble(begin, end, value) != end || begin == end)
+        return 0;
+    return value;
+}
+
+// reads the displayed text as an exact decimal, anything that is not a number reads as 0
+template<>
+Decimal readNumber<Decimal>(const std::string &text) {
+    Decimal value;
+    if(!Decimal::parse(text.data(), text.size(), value))
+        return Decimal();
+    return value;
+}
+
+// reads the displayed text as the fraction it is, anything that is not a number reads as 0
+template<>
+Rational readNumber<Rational>(const std::string &text) {
+    Rational value;
+    if(!Rational::parse(text.data(), text.size(), value))
+        return Rational();
+    return value;
+}
+
+// a fraction on the display is read back as the exact value it was written for, not as its digits
+template<>
+Rational Engine::displayValue<Rational>() const {
+    if(displayText == displayedRationalText)
+        return displayedRational;
+    return readNumber<Rational>(displayText);
+}
+
+static int signOf(double value) {
+    return value > 0 ? 1 : value < 0 ? -1 : 0;
+}
+
+static int signOf(const Decimal &value) {
+    return value.isZero() ? 0 : value.isNegative() ? -1 : 1;
+}
+
+static int signOf(const Rational &value) {
+    return value.isZero() ? 0 : value.isNegative() ? -1 : 1;
+}
+
+// the most a whole decimal exponent or factorial is multiplied out to, beyond that it goes through double
+static const std::int64_t MaxExactPower = 1024;
+static const std::int64_t MaxExactFactorial = 1000;
+
+// returns true and sets n if value is a whole number no further from 0 than limit
+static bool decimalInteger(const Decimal &value, std::int64_t limit, std::int64_t &n) {
+    double rounded = std::nearbyint(value.toDouble());
+    if(!(std::fabs(rounded) <= double(limit)))
+        return false;
+    n = std::int64_t(rounded);
+    return Decimal::subtract(value, Decimal(n)).isZero();
+}
+
+// the decimal a double reads as when written with the fewest digits, false if it is not finite
+static bool decimalFromDouble(double value, Decimal &result) {
+    if(!std::isfinite(value))
+        return false;
+    char buffer[MaxDoubleText];
+    return Decimal::parse(buffer, std::size_t(formatShortest(buffer, value) - buffer), result);
+}
+
+/* raises base to exponent. Whole exponents up to MaxExactPower are multiplied
+out exactly, negative ones then divided to digits like a quotient; every other
+power goes through double. Fails for 0 to a negative power, a negative base to
+a fractional one, and powers too large for a double */
+static bool decimalPower(const Decimal &base, const Decimal &exponent, std::size_t digits, Decimal &result) {
+    std::int64_t n;
+    if(!decimalInteger(exponent, MaxExactPower, n)) {
+        double value = base.toDouble();
+        return raisePower(value, exponent.toDouble()) && decimalFromDouble(value, result);
+    }
+    std::int64_t remaining = n < 0 ? -n : n;
+    Decimal product(1);
+    Decimal square = base;
+    while(remaining) {
+        if(remaining & 1)
+            product = Decimal::multiply(product, square);
+        remaining >>= 1;
+        if(remaining)
+            square = Decimal::multiply(square, square);
+    }
+    if(n >= 0) {
+        result = std::move(product);
+        return true;
+    }
+    return Decimal::divide(Decimal(1), product, digits, result);
+}
+
+// the fraction a double reads as when written with the fewest digits, false if it is not finite
+static bool rationalFromDouble(double value, Rational &result) {
+    if(!std::isfinite(value))
+        return false;
+    char buffer[MaxDoubleText];
+    return Rational::parse(buffer, std::size_t(formatShortest(buffer, value) - buffer), result);
+}
+
+// raises a fraction to a power like decimalPower() does, only that negative whole exponents stay exact too
+static bool rationalPower(const Rational &base, const Rational &exponent, Rational &result) {
+    std::int64_t n;
+    if(!exponent.toInteger(MaxExactPower, n)) {
+        double value = base.toDouble();
+        return raisePower(value, exponent.toDouble()) && rationalFromDouble(value, result);
+    }
+    Rational product = Rational::power(base, std::uint64_t(n < 0 ? -n : n));
+    if(n >= 0) {
+        result = std::move(product);
+        return true;
+    }
+    return Rational::divide(Rational(1), product, result);
+}
+
+Engine::Engine()
+    : mode(NumberMode::Double), decimalPrecision(0)
+    , pendingAddOp(Operator::None), pendingMultOp(Operator::None), pendingPowerOp(Operator::None)
+    , waitingForOperand(true), operatorPending(false)
+    , operandStart(0), operandInEntry(false), finishedEntries(0), displayText("0")
+{
+}
+
+// function is invoked to switch between double and decimal arithmetic, which starts over
+void Engine::setNumberMode(NumberMode numberMode, std::size_t precision) {
+    mode = numberMode;
+    decimalPrecision = precision;
+    clearAll();
+}
+
+// decimal numbers and fractions get a longer display, that is what they are for
+std::size_t Engine::maxDisplayLength() const {
+    return mode == NumberMode::Double ? MaxDisplayLength : MaxDecimalDisplayLength;
+}
+
+// function is invoked if a digit is pressed
+void Engine::digit(int digitValue) {
+    operatorPending = false;
+    // if the digit pressed is 0, and 0 is currently displayed, do nothing
+    if(displayText == "0" && digitValue == 0)
+        return;
+
+    // if waiting for an operand, clear the display and set waitingForOperand to false
+    if(waitingForOperand) {
+        discardOperandText();
+        displayText.clear();
+        displayedRationalText.clear();
+        waitingForOperand = false;
+    }
+
+    // append the digit pressed, the display never grows past its maximum length
+    if(displayText.size() < maxDisplayLength())
+        displayText += char('0' + digitValue);
+}
+
+// function is invoked if either plus or minus are pressed
+void Engine::plusMinus(Operator clickedOperator) {
+    unsigned long finishedBefore = finishedEntries;
+    enterOperandText();
+    if(mode == NumberMode::Decimal)
+        plusMinusWith(decimals, clickedOperator);
+    else if(mode == NumberMode::Rational)
+        plusMinusWith(rationals, clickedOperator);
+    else
+        plusMinusWith(doubles, clickedOperator);
+    // an operation that divided by zero has finished the entry
+    if(finishedEntries == finishedBefore)
+        entryText.append(" ").append(operatorSymbol(clickedOperator)).append(" ");
+}
+
+template<typename Number>
+void Engine::plusMinusWith(Accumulators<Number> &numbers, Operator clickedOperator) {
+    Number &sumSoFar = numbers.sumSoFar;
+    Number &factorSoFar = numbers.factorSoFar;
+    Number operand = displayValue<Number>();
+
+    // a pending power binds tighter than anything, it is finished first
+    if(!finishPower(numbers, operand)) {
+        abortOperation();
+        return;
+    }
+
+    /* if pendingMultOp isn't empty and there are no calculations happenning
+    between the displayed value and pendingMultOp, abort the operation and
+    return nothing */
+    if(pendingMultOp != Operator::None) {
+        if(!calculate(numbers, operand, pendingMultOp)) {
+            abortOperation();
+            return;
+        }
+        // display the current factor, clear factorSoFar and pendingMultOp
+        setDisplay(factorSoFar);
+        operand = factorSoFar;
+        factorSoFar = Number();
+        pendingMultOp = Operator::None;
+    }
+
+    /* if pendingAddOp isn't empty and there are no calculations happenning
+    between the displayed value and pendingAddOp, abort the operation and
+    return nothing */
+    if(pendingAddOp != Operator::None) {
+        if(!calculate(numbers, operand, pendingAddOp)) {
+            abortOperation();
+            return;
+        }
+        // display the current sum
+        setDisplay(sumSoFar);
+    } else {
+        // the sum is now equal to the displayed value
+        sumSoFar = operand;
+    }
+
+    // pendingAddOp is now equal to the operator pressed and waitingForOperand is set to true
+    pendingAddOp = clickedOperator;
+    waitingForOperand = true;
+    operatorPending = true;
+}
+
+// function is invoked if either multiply or divide are pressed
+void Engine::multDiv(Operator clickedOperator) {
+    unsigned long finishedBefore = finishedEntries;
+    enterOperandText();
+    if(mode == NumberMode::Decimal)
+        multDivWith(decimals, clickedOperator);
+    else if(mode == NumberMode::Rational)
+        multDivWith(rationals, clickedOperator);
+    else
+        multDivWith(doubles, clickedOperator);
+    if(finishedEntries == finishedBefore)
+        entryText.append(" ").append(operatorSymbol(clickedOperator)).append(" ");
+}
+
+template<typename Number>
+void Engine::multDivWith(Accumulators<Number> &numbers, Operator clickedOperator) {
+    Number &factorSoFar = numbers.factorSoFar;
+    Number operand = displayValue<Number>();
+
+    if(!finishPower(numbers, operand)) {
+        abortOperation();
+        return;
+    }
+
+    /* if pendingMultOp isn't empty and there are no calculations happenning
+    between the displayed value and pendingMultOp, abort the operation and
+    return nothing */
+    if(pendingMultOp != Operator::None) {
+        if(!calculate(numbers, operand, pendingMultOp)) {
+            abortOperation();
+            return;
+        }
+        // display the current factor
+        setDisplay(factorSoFar);
+    } else {
+        // the factor is now equal to the displayed value
+        factorSoFar = operand;
+    }
+
+    // pendingMultOp is now equal to the operator pressed and waitingForOperand is set to true
+    pendingMultOp = clickedOperator;
+    waitingForOperand = true;
+    operatorPending = true;
+}
+
+// function is invoked if the power operator is pressed
+void Engine::power() {
+    unsigned long finishedBefore = finishedEntries;
+    enterOperandText();
+    if(mode == NumberMode::Decimal)
+        powerWith(decimals);
+    else if(mode == NumberMode::Rational)
+        powerWith(rationals);
+    else
+        powerWith(doubles);
+    if(finishedEntries == finishedBefore)
+        entryText.append(" ").append(operatorSymbol(Operator::Power)).append(" ");
+}
+
+template<typename Number>
+void Engine::powerWith(Accumulators<Number> &numbers) {
+    Number operand = displayValue<Number>();
+
+    // powers go from left to right like every other operator, 2 ^ 3 ^ 2 is 8 ^ 2
+    if(pendingPowerOp != Operator::None) {
+        if(!calculate(numbers, operand, pendingPowerOp)) {
+            abortOperation();
+            return;
+        }
+        // display the current power
+        setDisplay(numbers.baseSoFar);
+    } else {
+        // the base is now equal to the displayed value
+        numbers.baseSoFar = operand;
+    }
+
+    pendingPowerOp = Operator::Power;
+    waitingForOperand = true;
+    operatorPending = true;
+}
+
+// finishes a pending power before a looser operator, showing it and leaving it in operand
+template<typename Number>
+bool Engine::finishPower(Accumulators<Number> &numbers, Number &operand) {
+    if(pendingPowerOp == Operator::None)
+        return true;
+    if(!calculate(numbers, operand, pendingPowerOp))
+        return false;
+    setDisplay(numbers.baseSoFar);
+    operand = std::move(numbers.baseSoFar);
+    numbers.baseSoFar = Number();
+    pendingPowerOp = Operator::None;
+    return true;
+}
+
+// function is invoked if equals is pressed
+void Engine::equals() {
+    // a lone number is not worth keeping as an entry
+    bool worthKeeping = pendingAddOp != Operator::None || pendingMultOp != Operator::None
+                        || pendingPowerOp != Operator::None || openBrackets() != 0 || operandInEntry;
+    unsigned long finishedBefore = finishedEntries;
+    // brackets that equals closes stay open in the entry, so that a replay leaves them pending
+    enterOperandText();
+
+    if(mode == NumberMode::Decimal)
+        equalsWith(decimals);
+    else if(mode == NumberMode::Rational)
+        equalsWith(rationals);
+    else
+        equalsWith(doubles);
+
+    // dividing by zero has finished the entry already
+    if(finishedEntries != finishedBefore)
+        return;
+    if(worthKeeping)
+        finishEntry(displayText);
+    entryText.clear();
+    bracketStarts.clear();
+    operandInEntry = false;
+}
+
+template<typename Number>
+void Engine::equalsWith(Accumulators<Number> &numbers) {
+    Number operand = displayValue<Number>();
+
+    // brackets left open are closed by equals
+    while(!numbers.brackets.empty()) {
+        if(!finishPending(numbers, operand)) {
+            abortOperation();
+            return;
+        }
+        restoreBracket(numbers);
+    }
+
+    if(!finishPending(numbers, operand)) {
+        abortOperation();
+        return;
+    }
+
+    // display the current sum, clear sumSoFar and set waitingForOperand to true
+    setDisplay(operand);
+    numbers.sumSoFar = Number();
+    waitingForOperand = true;
+    operatorPending = false;
+}
+
+// function is invoked if the opening bracket is pressed
+void Engine::openBracket() {
+    // a bracket straight after a number multiplies it, like 2(3 + 4)
+    if(!waitingForOperand)
+        multDiv(Operator::Multiply);
+    if(isAborted())
+        return;
+
+    // a bracket or percentage in front is replaced by the bracket, like a typed number would be
+    discardOperandText();
+    bracketStarts.push_back(entryText.size());
+    entryText += "(";
+
+    // put aside whatever is pending and start over inside the bracket
+    if(mode == NumberMode::Decimal)
+        saveBracket(decimals);
+    else if(mode == NumberMode::Rational)
+        saveBracket(rationals);
+    else
+        saveBracket(doubles);
+    pendingAddOp = Operator::None;
+    pendingMultOp = Operator::None;
+    pendingPowerOp = Operator::None;
+    waitingForOperand = true;
+    operatorPending = true;
+}
+
+// function is invoked if the closing bracket is pressed
+void Engine::closeBracket() {
+    if(openBrackets() == 0)
+        return;
+    unsigned long finishedBefore = finishedEntries;
+    enterOperandText();
+    entryText += ")";
+
+    if(mode == NumberMode::Decimal)
+        closeBracketWith(decimals);
+    else if(mode == NumberMode::Rational)
+        closeBracketWith(rationals);
+    else
+        closeBracketWith(doubles);
+
+    // the whole bracket is the operand now
+    if(finishedEntries == finishedBefore) {
+        operandStart = bracketStarts.back();
+        bracketStarts.pop_back();
+        operandInEntry = true;
+    }
+}
+
+template<typename Number>
+void Engine::closeBracketWith(Accumulators<Number> &numbers) {
+    // a closing bracket without an opening one does nothing
+    if(numbers.brackets.empty())
+        return;
+
+    Number operand = displayValue<Number>();
+    if(!finishPending(numbers, operand)) {
+        abortOperation();
+        return;
+    }
+
+    // bring back what was pending outside, the value of the bracket is now the operand
+    restoreBracket(numbers);
+    setDisplay(operand);
+    waitingForOperand = true;
+    operatorPending = false;
+}
+
+// puts aside the accumulators and pending operators while a bracket is open
+template<typename Number>
+void Engine::saveBracket(Accumulators<Number> &numbers) {
+    numbers.brackets.push_back({ numbers.sumSoFar, numbers.factorSoFar, numbers.baseSoFar,
+                                 pendingAddOp, pendingMultOp, pendingPowerOp });
+    numbers.sumSoFar = Number();
+    numbers.factorSoFar = Number();
+    numbers.baseSoFar = Number();
+}
+
+// brings back what was put aside when the innermost bracket was opened
+template<typename Number>
+void Engine::restoreBracket(Accumulators<Number> &numbers) {
+    typename Accumulators<Number>::Bracket &outer = numbers.brackets.back();
+    numbers.sumSoFar = std::move(outer.sumSoFar);
+    numbers.factorSoFar = std::move(outer.factorSoFar);
+    numbers.baseSoFar = std::move(outer.baseSoFar);
+    pendingAddOp = outer.pendingAddOp;
+    pendingMultOp = outer.pendingMultOp;
+    pendingPowerOp = outer.pendingPowerOp;
+    numbers.brackets.pop_back();
+}
+
+// function is invoked if the percent key is pressed
+void Engine::percent() {
+    if(!operandInEntry) {
+        operandStart = entryText.size();
+        entryText += operandText();
+        operandInEntry = true;
+    }
+    entryText += "%";
+
+    // the displayed value becomes a hundredth of itself, and counts as a finished operand
+    if(mode == NumberMode::Decimal)
+        setDisplay(displayValue<Decimal>().hundredth());
+    else if(mode == NumberMode::Rational)
+        setDisplay(displayValue<Rational>().hundredth());
+    else
+        setDisplay(displayValue<double>() / 100);
+    waitingForOperand = true;
+    operatorPending = false;
+}
+
+// function is invoked if a function key is pressed
+void Engine::function(Function function) {
+    if(!operandInEntry) {
+        operandStart = entryText.size();
+        entryText += operandText();
+        operandInEntry = true;
+    }
+    // factorial goes after its operand, every other function around it, in brackets unless it is one
+    bool bracketed = entryText[operandStart] == '(' && entryText.back() == ')';
+    if(isPostfixFunction(function)) {
+        entryText += functionName(function);
+    } else if(bracketed) {
+        entryText.insert(operandStart, functionName(function));
+    } else {
+        entryText.insert(operandStart, std::string(functionName(function)) + "(");
+        entryText += ")";
+    }
+
+    // a value the function is not defined for aborts like dividing by zero
+    if(mode == NumberMode::Decimal) {
+        Decimal value = displayValue<Decimal>();
+        if(!applyDecimal(function, value)) {
+            abortOperation();
+            return;
+        }
+        setDisplay(value);
+    } else if(mode == NumberMode::Rational) {
+        Rational value = displayValue<Rational>();
+        if(!applyRational(function, value)) {
+            abortOperation();
+            return;
+        }
+        setDisplay(value);
+    } else {
+        double value = displayValue<double>();
+        if(!applyFunction(function, value)) {
+            abortOperation();
+            return;
+        }
+        setDisplay(value);
+    }
+    waitingForOperand = true;
+    operatorPending = false;
+}
+
+// function invoked to press a key by what it is rather than by its own function
+void Engine::press(Key key) {
+    if(isDigitKey(key)) {
+        digit(keyDigit(key));
+        return;
+    }
+    if(isFunctionKey(key)) {
+        function(keyFunction(key));
+        return;
+    }
+    switch(key) {
+    case Key::Point: point(); break;
+    case Key::FlipSign: flipSign(); break;
+    case Key::Backspace: backspace(); break;
+    case Key::Clear: clear(); break;
+    case Key::ClearAll: clearAll(); break;
+    case Key::Add:
+    case Key::Subtract: plusMinus(keyOperator(key)); break;
+    case Key::Multiply:
+    case Key::Divide: multDiv(keyOperator(key)); break;
+    case Key::Equals: equals(); break;
+    case Key::OpenBracket: openBracket(); break;
+    case Key::CloseBracket: closeBracket(); break;
+    case Key::Percent: percent(); break;
+    case Key::Power: power(); break;
+    default: break;
+    }
+}
+
+// function invoked if the point is pressed
+void Engine::point() {
+    // if waitingForOperand is true, display 0
+    if(waitingForOperand) {
+        discardOperandText();
+        setDisplay("0");
+        displayedRationalText.clear();
+    }
+    // if there is currently no point displayed, add a point after whatever was displayed
+    if(displayText.find('.') == std::string::npos)
+        setDisplay(displayText + ".");
+    // set waitingForOperand to false
+    waitingForOperand = false;
+    operatorPending = false;
+}
+
+// function invoked if the flip sign key is pressed
+void Engine::flipSign() {
+    int sign;
+    if(mode == NumberMode::Decimal)
+        sign = signOf(displayValue<Decimal>());
+    else if(mode == NumberMode::Rational)
+        sign = signOf(displayValue<Rational>());
+    else
+        sign = signOf(displayValue<double>());
+    // a fraction on the display flips exactly, whatever the digits show of it
+    bool exact = mode == NumberMode::Rational && displayText == displayedRationalText;
+
+    // if the value displayed is above 0, put a dash before anything else, otherwise remove it
+    if(sign > 0) {
+        setDisplay("-" + displayText);
+    } else if(sign < 0) {
+        displayText.erase(0, 1);
+    }
+    if(exact) {
+        displayedRational = -displayedRational;
+        displayedRationalText = displayText;
+    }
+    // a flipped bracket or percentage goes into the entry as the number it came to
+    discardOperandText();
+    // the displayed value is what the next operator works on now
+    operatorPending = false;
+}
+
+// function invoked if the backspace key is pressed
+void Engine::backspace() {
+    // if waitingForOperand is true, do nothing
+    if(waitingForOperand)
+        return;
+
+    // remove the last digit
+    displayText.pop_back();
+    // if the value is now empty, change it to 0 and set waitingForOperand to true
+    if(displayText.empty()) {
+        displayText = "0";
+        waitingForOperand = true;
+    }
+}
+
+// function is invoked if the clear key is pressed
+void Engine::clear() {
+    // if waitingForOperand is true, do nothing
+    if(waitingForOperand)
+        return;
+
+    // set displayed value to 0 and set waitingForOperand to true
+    displayText = "0";
+    waitingForOperand = true;
+    operatorPending = false;
+}
+
+// function is invoked if the clear all key is pressed
+void Engine::clearAll() {
+    // reset all values, set displayed value to 0 and waitingForOperand to true
+    doubles = Accumulators<double>();
+    decimals = Accumulators<Decimal>();
+    rationals = Accumulators<Rational>();
+    pendingAddOp = Operator::None;
+    pendingMultOp = Operator::None;
+    pendingPowerOp = Operator::None;
+    displayText = "0";
+    displayedRationalText.clear();
+    waitingForOperand = true;
+    operatorPending = false;
+    entryText.clear();
+    bracketStarts.clear();
+    operandInEntry = false;
+}
+
+// function is invoked when a whole operand is typed in at once
+void Engine::enterOperand(const char *text, std::size_t length) {
+    discardOperandText();
+    setDisplay(std::string(text, length));
+    displayedRationalText.clear();
+    waitingForOperand = false;
+    operatorPending = false;
+}
+
+// function is invoked when an abort to an operation is needed
+void Engine::abortOperation() {
+    // the entry that failed is kept as well, with the hashes as its result
+    finishEntry("####");
+    // run a clearAll and set the displayed value to 4 hashes
+    clearAll();
+    displayText = "####";
+}
+
+// function is invoked when an entry is done, with what it came to
+void Engine::finishEntry(const std::string &result) {
+    finishedEntryText = entryText;
+    finishedResultText = result;
+    finishedEntries++;
+}
+
+// the displayed value as an operand of the entry, 0 for hashes or a lone minus, which read as 0 too
+std::string Engine::operandText() const {
+    double value;
+    const char *begin = displayText.data();
+    const char *end = begin + displayText.size();
+    if(begin == end || parseDouble(begin, end, value) != end)
+        return "0";
+    return displayText;
+}
+
+// puts the displayed value into the entry as the operand, unless a bracket or percentage already is
+void Engine::enterOperandText() {
+    if(!operandInEntry)
+        entryText += operandText();
+    operandInEntry = false;
+}
+
+// takes a bracket or percentage back out of the entry when something else replaces it as the operand
+void Engine::discardOperandText() {
+    if(operandInEntry)
+        entryText.resize(operandStart);
+    operandInEntry = false;
+}
+
+// function is invoked to bring back an entry, pressing every key of it again
+bool Engine::replay(const char *text, std::size_t length) {
+    clearAll();
+    Tokenizer tokenizer(text, text + length);
+    // a minus where an operand is expected belongs to the number after it
+    bool expectingOperand = true;
+    bool negative = false;
+    // the functions whose bracket is open, with how many brackets were open outside of it
+    std::vector<std::pair<Function, std::size_t>> functionBrackets;
+    for(;;) {
+        Token token = tokenizer.next();
+        switch(token.type) {
+        case TokenType::End:
+            if(!negative)
+                return true;
+            break;
+        case TokenType::Number:
+            if(negative) {
+                std::string operand = "-" + std::string(token.text, token.length);
+                enterOperand(operand.data(), operand.size());
+            } else {
+                enterOperand(token.text, token.length);
+            }
+            negative = false;
+            expectingOperand = false;
+            continue;
+        case TokenType::Operator:
+            if(expectingOperand) {
+                if(token.op != Operator::Subtract || negative)
+                    break;
+                negative = true;
+                continue;
+            }
+            if(operatorPrecedence(token.op) == Precedence::Additive)
+                plusMinus(token.op);
+            else if(operatorPrecedence(token.op) == Precedence::Power)
+                power();
+            else
+                multDiv(token.op);
+            expectingOperand = true;
+            continue;
+        case TokenType::LeftBracket:
+            if(negative)
+                break;
+            openBracket();
+            expectingOperand = true;
+            continue;
+        case TokenType::Identifier: {
+            // a function is written with its operand in brackets, which are opened like any other
+            Function called = findFunction(token.text, token.length);
+            if(called == Function::None || negative || !expectingOperand
+               || tokenizer.next().type != TokenType::LeftBracket)
+                break;
+            functionBrackets.emplace_back(called, openBrackets());
+            openBracket();
+            continue;
+        }
+        case TokenType::RightBracket:
+            if(expectingOperand)
+                break;
+            closeBracket();
+            // the function puts its own brackets back around the operand
+            if(!functionBrackets.empty() && functionBrackets.back().second == openBrackets() && !isAborted()) {
+                entryText.erase(entryText.size() - 1);
+                entryText.erase(operandStart, 1);
+                function(functionBrackets.back().first);
+                functionBrackets.pop_back();
+            }
+            continue;
+        case TokenType::Percent:
+            if(expectingOperand)
+                break;
+            percent();
+            continue;
+        case TokenType::Factorial:
+            if(expectingOperand)
+                break;
+            function(Function::Factorial);
+            continue;
+        default:
+            break;
+        }
+        // anything else is not an entry
+        clearAll();
+        return false;
+    }
+}
+
+// function is invoked to run an operation (contains the right value in an equation and the operator used)
+bool Engine::calculate(Accumulators<double> &numbers, double rightOperand, Operator pendingOperator) const {
+    // sums and differences go to sumSoFar, products and quotients to factorSoFar,
+    // every case inlines its kernel so there is no lookup left at run time
+    switch(pendingOperator) {
+    case Operator::Add:
+        return OperatorKernel<Operator::Add>::apply(numbers.sumSoFar, rightOperand);
+    case Operator::Subtract:
+        return OperatorKernel<Operator::Subtract>::apply(numbers.sumSoFar, rightOperand);
+    case Operator::Multiply:
+        return OperatorKernel<Operator::Multiply>::apply(numbers.factorSoFar, rightOperand);
+    // dividing by 0 returns false
+    case Operator::Divide:
+        return OperatorKernel<Operator::Divide>::apply(numbers.factorSoFar, rightOperand);
+    // and powers to baseSoFar
+    case Operator::Power:
+        return OperatorKernel<Operator::Power>::apply(numbers.baseSoFar, rightOperand);
+    default:
+        return true;
+    }
+}
+
+// the same for decimals, rounding every result if a precision is set
+bool Engine::calculate(Accumulators<Decimal> &numbers, const Decimal &rightOperand, Operator pendingOperator) const {
+    Decimal *result = &numbers.sumSoFar;
+    switch(pendingOperator) {
+    case Operator::Add:
+        numbers.sumSoFar = Decimal::add(numbers.sumSoFar, rightOperand);
+        break;
+    case Operator::Subtract:
+        numbers.sumSoFar = Decimal::subtract(numbers.sumSoFar, rightOperand);
+        break;
+    case Operator::Multiply:
+        numbers.factorSoFar = Decimal::multiply(numbers.factorSoFar, rightOperand);
+        result = &numbers.factorSoFar;
+        break;
+    // dividing by 0 returns false, quotients always need some number of digits
+    case Operator::Divide:
+        if(!Decimal::divide(numbers.factorSoFar, rightOperand,
+                            decimalPrecision ? decimalPrecision : std::size_t(DefaultDivisionDigits),
+                            numbers.factorSoFar))
+            return false;
+        result = &numbers.factorSoFar;
+        break;
+    case Operator::Power:
+        if(!decimalPower(numbers.baseSoFar, rightOperand,
+                         decimalPrecision ? decimalPrecision : std::size_t(DefaultDivisionDigits),
+                         numbers.baseSoFar))
+            return false;
+        result = &numbers.baseSoFar;
+        break;
+    default:
+        return true;
+    }
+    if(decimalPrecision)
+        result->roundToDigits(decimalPrecision);
+    return true;
+}
+
+// applies a function to a decimal, rounding the result if a precision is set
+bool Engine::applyDecimal(Function function, Decimal &value) const {
+    // factorials of whole numbers are multiplied out exactly, the rest goes through double
+    std::int64_t n;
+    if(function == Function::Factorial && decimalInteger(value, MaxExactFactorial, n)) {
+        if(n < 0)
+            return false;
+        Decimal product(1);
+        for(std::int64_t i = 2; i <= n; i++)
+            product = Decimal::multiply(product, Decimal(i));
+        value = std::move(product);
+    } else {
+        double result = value.toDouble();
+        if(!applyFunction(function, result) || !decimalFromDouble(result, value))
+            return false;
+    }
+    if(decimalPrecision)
+        value.roundToDigits(decimalPrecision);
+    return true;
+}
+
+// the same for fractions, which are always exact
+bool Engine::calculate(Accumulators<Rational> &numbers, const Rational &rightOperand, Operator pendingOperator) const {
+    switch(pendingOperator) {
+    case Operator::Add:
+        numbers.sumSoFar = Rational::add(numbers.sumSoFar, rightOperand);
+        return true;
+    case Operator::Subtract:
+        numbers.sumSoFar = Rational::subtract(numbers.sumSoFar, rightOperand);
+        return true;
+    case Operator::Multiply:
+        numbers.factorSoFar = Rational::multiply(numbers.factorSoFar, rightOperand);
+        return true;
+    // dividing by 0 returns false
+    case Operator::Divide:
+        return Rational::divide(numbers.factorSoFar, rightOperand, numbers.factorSoFar);
+    case Operator::Power:
+        return rationalPower(numbers.baseSoFar, rightOperand, numbers.baseSoFar);
+    default:
+        return true;
+    }
+}
+
+// applies a function to a fraction, factorials of whole numbers exactly and the rest through double
+bool Engine::applyRational(Function function, Rational &value) const {
+    std::int64_t n;
+    if(function == Function::Factorial && value.toInteger(MaxExactFactorial, n)) {
+        if(n < 0)
+            return false;
+        Rational product(1);
+        for(std::int64_t i = 2; i <= n; i++)
+            product = Rational::multiply(product, Rational(i));
+        value = std::move(product);
+        return true;
+    }
+    double result = value.toDouble();
+    return applyFunction(function, result) && rationalFromDouble(result, value);
+}
+
+// finishes whatever is pending, leaving the result in operand (false if it divides by 0)
+template<typename Number>
+bool Engine::finishPending(Accumulators<Number> &numbers, Number &operand) {
+    if(!finishLevel(numbers, pendingAddOp, pendingMultOp, pendingPowerOp, operand))
+        return false;
+    // clear pendingPowerOp, pendingMultOp and pendingAddOp
+    pendingPowerOp = Operator::None;
+    pendingMultOp = Operator::None;
+    pendingAddOp = Operator::None;
+    return true;
+}
+
+// finishes the given pending operators on one level of accumulators, leaving the result in operand
+template<typename Number>
+bool Engine::finishLevel(Accumulators<Number> &numbers, Operator addOp, Operator multOp, Operator powerOp,
+                         Number &operand) const {
+    // finish the pending power first
+    if(powerOp != Operator::None) {
+        if(!calculate(numbers, operand, powerOp))
+            return false;
+        // clear baseSoFar
+        operand = std::move(numbers.baseSoFar);
+        numbers.baseSoFar = Number();
+    }
+    // then the pending multiplication or division
+    if(multOp != Operator::None) {
+        if(!calculate(numbers, operand, multOp))
+            return false;
+        // clear factorSoFar
+        operand = std::move(numbers.factorSoFar);
+        numbers.factorSoFar = Number();
+    }
+    // then finish the pending addition or subtraction
+    if(addOp != Operator::None) {
+        if(!calculate(numbers, operand, addOp))
+            return false;
+        // clear sumSoFar
+        operand = std::move(numbers.sumSoFar);
+        numbers.sumSoFar = Number();
+    }
+    return true;
+}
+
+// function is invoked to show the running result while an entry is typed
+std::string Engine::preview() const {
+    bool pending = pendingAddOp != Operator::None || pendingMultOp != Operator::None
+                   || pendingPowerOp != Operator::None || openBrackets() != 0;
+    if(!pending || isAborted())
+        return std::string();
+
+    // written the way setDisplay() would write it
+    if(mode == NumberMode::Decimal) {
+        Decimal value;
+        if(!previewWith(decimals, value))
+            return "####";
+        return value.toString(maxDisplayLength());
+    }
+    if(mode == NumberMode::Rational) {
+        Rational value;
+        if(!previewWith(rationals, value))
+            return "####";
+        return value.toString(maxDisplayLength());
+    }
+    double value;
+    if(!previewWith(doubles, value))
+        return "####";
+    char buffer[MaxDoubleText];
+    return std::string(buffer, formatDouble(buffer, value, maxDisplayLength()));
+}
+
+/* finishes copies of the running results of every open level, innermost
+first, the way equals would. Nothing before the current level is evaluated
+again: each level is one pending sum, one pending factor and one pending power */
+template<typename Number>
+bool Engine::previewWith(const Accumulators<Number> &numbers, Number &value) const {
+    Accumulators<Number> level;
+    level.sumSoFar = numbers.sumSoFar;
+    level.factorSoFar = numbers.factorSoFar;
+    level.baseSoFar = numbers.baseSoFar;
+    Operator addOp = pendingAddOp;
+    Operator multOp = pendingMultOp;
+    Operator powerOp = pendingPowerOp;
+    std::size_t depth = numbers.brackets.size();
+
+    Number operand;
+    if(operatorPending) {
+        // the operator pressed last has no right operand yet, so it is left out, and so
+        // are brackets opened with nothing in them so far
+        for(;;) {
+            if(powerOp != Operator::None) {
+                operand = level.baseSoFar;
+                powerOp = Operator::None;
+                break;
+            }
+            if(multOp != Operator::None) {
+                operand = level.factorSoFar;
+                multOp = Operator::None;
+                break;
+            }
+            if(addOp != Operator::None) {
+                operand = level.sumSoFar;
+                addOp = Operator::None;
+                break;
+            }
+            if(depth == 0) {
+                operand = Number();
+                break;
+            }
+            const typename Accumulators<Number>::Bracket &outer = numbers.brackets[--depth];
+            level.sumSoFar = outer.sumSoFar;
+            level.factorSoFar = outer.factorSoFar;
+            level.baseSoFar = outer.baseSoFar;
+            addOp = outer.pendingAddOp;
+            multOp = outer.pendingMultOp;
+            powerOp = outer.pendingPowerOp;
+        }
+    } else {
+        operand = displayValue<Number>();
+    }
+
+    for(;;) {
+        if(!finishLevel(level, addOp, multOp, powerOp, operand))
+            return false;
+        if(depth == 0)
+            break;
+        const typename Accumulators<Number>::Bracket &outer = numbers.brackets[--depth];
+        level.sumSoFar = outer.sumSoFar;
+        level.factorSoFar = outer.factorSoFar;
+        level.baseSoFar = outer.baseSoFar;
+        addOp = outer.pendingAddOp;
+        multOp = outer.pendingMultOp;
+        powerOp = outer.pendingPowerOp;
+    }
+    value = std::move(operand);
+    return true;
+}
+
+// sets the displayed text, cutting it down to the length the display can show
+void Engine::setDisplay(const std::string &text) {
+    displayText.assign(text, 0, maxDisplayLength());
+}
+
+// sets the displayed text to a value
+void Engine::setDisplay(double value) {
+    char buffer[MaxDoubleText];
+    displayText.assign(buffer, formatDouble(buffer, value, maxDisplayLength()));
+}
+
+// sets the displayed text to a decimal, rounded to what fits
+void Engine::setDisplay(const Decimal &value) {
+    setDisplay(value.toString(maxDisplayLength()));
+}
+
+// sets the displayed text to a fraction, keeping the fraction itself for whatever reads the display next
+void Engine::setDisplay(const Rational &value) {
+    displayedRational = value;
+    displayedRational.reduce();
+    setDisplay(displayedRational.toString(maxDisplayLength()));
+    displayedRationalText = displayText;
+}
+
+// writes a value with the fewest digits that read back to it
+std::string Engine::formatValue(double value) {
+    char buffer[MaxDoubleText];
+    return std::string(buffer, formatShortest(buffer, value));
+}
+
+// reads the displayed value in the current kind of number
+template<typename Number>
+Number Engine::displayValue() const {
+    return readNumber<Number>(displayText);
+}
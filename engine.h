@@ -0,0 +1,166 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "decimal.h"
+#include "functions.h"
+#include "keys.h"
+#include "operators.h"
+#include "rational.h"
+
+// the kind of number the engine calculates with
+enum class NumberMode : unsigned char {
+    Double,
+    Decimal,
+    // exact fractions, which only become decimals on the display
+    Rational
+};
+
+// the calculator state machine, without any widgets attached to it
+class Engine
+{
+public:
+    Engine();
+
+    // one function for every key on the calculator
+    void digit(int digitValue);
+    void point();
+    void flipSign();
+    void backspace();
+    void clear();
+    void clearAll();
+    void plusMinus(Operator clickedOperator);
+    void multDiv(Operator clickedOperator);
+    void equals();
+    void openBracket();
+    void closeBracket();
+    void percent();
+    void power();
+    // applies a function to the displayed value, which counts as a finished operand like a percentage
+    void function(Function function);
+    // presses any key, the way a replayed key log does
+    void press(Key key);
+
+    // replaces the displayed value with an operand typed in as text
+    void enterOperand(const char *text, std::size_t length);
+    /* starts over with an entry written by entry(), pressing its keys again so
+    that everything pending is back as it was before equals. Returns false (and
+    clears everything) if text is not such an entry */
+    bool replay(const char *text, std::size_t length);
+
+    const std::string &display() const { return displayText; }
+    /* what equals would display right now, leaving out an operator or bracket
+    pressed last, or nothing if no operation is pending. It only finishes the
+    running results, so it costs the same however long the entry is */
+    std::string preview() const;
+    // what has been typed since the last result, like "2 + 3 × (4 - 1)", with the operands as they were displayed
+    const std::string &entry() const { return entryText; }
+    // the last entry that equals finished or that divided by zero, its result, and how many there were so far
+    const std::string &finishedEntry() const { return finishedEntryText; }
+    const std::string &finishedResult() const { return finishedResultText; }
+    unsigned long finishedCount() const { return finishedEntries; }
+    bool isWaitingForOperand() const { return waitingForOperand; }
+    bool isAborted() const { return displayText == "####"; }
+    std::size_t openBrackets() const {
+        if(mode == NumberMode::Decimal)
+            return decimals.brackets.size();
+        return mode == NumberMode::Rational ? rationals.brackets.size() : doubles.brackets.size();
+    }
+
+    // switches between double, decimal and exact arithmetic, which clears everything. With a
+    // precision every decimal result is rounded to that many significant digits,
+    // without one decimals stay exact and only quotients are rounded
+    void setNumberMode(NumberMode numberMode, std::size_t precision = 0);
+    NumberMode numberMode() const { return mode; }
+    std::size_t precision() const { return decimalPrecision; }
+    std::size_t maxDisplayLength() const;
+
+    // writes a value the way the display shows results
+    static std::string formatValue(double value);
+
+    enum {
+        MaxDisplayLength = 15,
+        MaxDecimalDisplayLength = 32,
+        DefaultDivisionDigits = 34
+    };
+
+private:
+    // the running sum, factor and base of a power in one kind of number, with
+    // what was pending outside of every open bracket, innermost last
+    template<typename Number>
+    struct Accumulators {
+        struct Bracket {
+            Number sumSoFar;
+            Number factorSoFar;
+            Number baseSoFar;
+            Operator pendingAddOp;
+            Operator pendingMultOp;
+            Operator pendingPowerOp;
+        };
+
+        Number sumSoFar = Number();
+        Number factorSoFar = Number();
+        Number baseSoFar = Number();
+        std::vector<Bracket> brackets;
+    };
+
+    template<typename Number> void plusMinusWith(Accumulators<Number> &numbers, Operator clickedOperator);
+    template<typename Number> void multDivWith(Accumulators<Number> &numbers, Operator clickedOperator);
+    template<typename Number> void powerWith(Accumulators<Number> &numbers);
+    template<typename Number> bool finishPower(Accumulators<Number> &numbers, Number &operand);
+    template<typename Number> void equalsWith(Accumulators<Number> &numbers);
+    template<typename Number> void closeBracketWith(Accumulators<Number> &numbers);
+    template<typename Number> void saveBracket(Accumulators<Number> &numbers);
+    template<typename Number> void restoreBracket(Accumulators<Number> &numbers);
+    template<typename Number> bool finishPending(Accumulators<Number> &numbers, Number &operand);
+    template<typename Number> bool finishLevel(Accumulators<Number> &numbers, Operator addOp, Operator multOp,
+                                               Operator powerOp, Number &operand) const;
+    template<typename Number> bool previewWith(const Accumulators<Number> &numbers, Number &value) const;
+    template<typename Number> Number displayValue() const;
+
+    void abortOperation();
+    void finishEntry(const std::string &result);
+    std::string operandText() const;
+    void enterOperandText();
+    void discardOperandText();
+    bool calculate(Accumulators<double> &numbers, double rightOperand, Operator pendingOperator) const;
+    bool calculate(Accumulators<Decimal> &numbers, const Decimal &rightOperand, Operator pendingOperator) const;
+    bool calculate(Accumulators<Rational> &numbers, const Rational &rightOperand, Operator pendingOperator) const;
+    bool applyDecimal(Function function, Decimal &value) const;
+    bool applyRational(Function function, Rational &value) const;
+    void setDisplay(const std::string &text);
+    void setDisplay(double value);
+    void setDisplay(const Decimal &value);
+    void setDisplay(const Rational &value);
+
+    NumberMode mode;
+    std::size_t decimalPrecision;
+    Accumulators<double> doubles;
+    Accumulators<Decimal> decimals;
+    Accumulators<Rational> rationals;
+    Operator pendingAddOp;
+    Operator pendingMultOp;
+    Operator pendingPowerOp;
+    bool waitingForOperand;
+    // an operator or opening bracket was pressed last, and has no operand after it yet
+    bool operatorPending;
+
+    // the entry so far. The operand at its end since operandStart (a bracket, a
+    // percentage or a function) stands for the displayed value until a new operand is typed
+    std::string entryText;
+    std::vector<std::size_t> bracketStarts;
+    std::size_t operandStart;
+    bool operandInEntry;
+    std::string finishedEntryText;
+    std::string finishedResultText;
+    unsigned long finishedEntries;
+
+    std::string displayText;
+    // the exact value of a fraction on the display, for as long as it shows the text that was written for it
+    Rational displayedRational;
+    std::string displayedRationalText;
+};
+
+#endif // ENGINE_H
@@ -0,0 +1,163 @@
+#include "evaluator.h"
+#include "numcodec.h"
+#include <climits>
+#include <cstring>
+
+void LineEvaluator::setCache(ResultCache *resultCache, int partOperators) {
+    cache = resultCache;
+    minPartOperators = partOperators > 0 ? partOperators : INT_MAX;
+}
+
+// works out a node the way folding it would, looking up and keeping every part worth it
+bool LineEvaluator::evaluateCached(int index, double &value) {
+    const Node &node = expression.nodeList()[std::size_t(index)];
+    switch(node.kind) {
+    case Node::Constant:
+        value = node.value;
+        return true;
+    case Node::Negate:
+        if(!evaluateCached(node.left, value))
+            return false;
+        value = -value;
+        return true;
+    case Node::Percent:
+        if(!evaluateCached(node.left, value))
+            return false;
+        value /= 100;
+        return true;
+    case Node::Function:
+    case Node::Binary:
+        break;
+    default:
+        return false;
+    }
+
+    int operators = canonical.operatorCount(index);
+    bool cached = operators >= MinCachedOperators
+                  && (index == expression.rootNode() || operators >= minPartOperators);
+    bool valid;
+    if(cached && cache->find(canonical.key(index), value, valid))
+        return valid;
+
+    if(node.kind == Node::Function) {
+        valid = evaluateCached(node.left, value) && applyFunction(node.function, value);
+    } else {
+        double right;
+        valid = evaluateCached(node.left, value) && evaluateCached(node.right, right)
+                && operatorInfo(node.op).apply(value, right);
+    }
+    if(cached)
+        cache->insert(canonical.key(index), value, valid);
+    return valid;
+}
+
+// notes a line as seen, returns true if it was seen before, or another with the same hash was, which does no harm
+bool LineEvaluator::seenBefore(std::uint64_t hash) {
+    if(!seenLines)
+        seenLines.reset(new std::uint64_t[SeenLineSlots]());
+    std::uint64_t &slot = seenLines[hash % SeenLineSlots];
+    if(slot == hash)
+        return true;
+    slot = hash;
+    return false;
+}
+
+void LineEvaluator::evaluateLine(const char *begin, const char *end, std::string &output) {
+    // a line seen before is not even parsed
+    CacheKey typed = lineKey(begin, end, lineText);
+    KnownLine *known = nullptr;
+    double value;
+    bool valid;
+    if(cache) {
+        if(cache->find(typed, value, valid)) {
+            if(valid)
+                appendDouble(output, value);
+            else
+                output.append("####");
+            return;
+        }
+    } else {
+        if(!knownLines)
+            knownLines.reset(new KnownLine[KnownLineSlots]);
+        known = &knownLines[typed.hash % KnownLineSlots];
+        if(known->hash == typed.hash && known->key.compare(0, std::string::npos, typed.data, typed.length) == 0) {
+            if(known->uses < KnownLine::MaxUses)
+                known->uses++;
+            if(known->program.evaluate(nullptr, value))
+                appendDouble(output, value);
+            else
+                output.append("####");
+            return;
+        }
+    }
+
+    if(!expression.parse(begin, end)) {
+        output.append("error");
+        return;
+    }
+
+    // the cache only knows expressions without variables, which are all folded to a constant anyway
+    if(cache && canonical.build(expression)) {
+        valid = evaluateCached(expression.rootNode(), value);
+        cache->insert(typed, value, valid);
+        if(valid)
+            appendDouble(output, value);
+        else
+            output.append("####");
+        return;
+    }
+
+    if(!expression.variableNames().empty()) {
+        // there is nothing to give the variables of a line a value
+        output.append("error");
+        return;
+    }
+
+    /* a line that comes again is kept and run unfolded, which gives exactly what
+    folding gives, unless its program needs more registers than there are */
+    if(known && seenBefore(typed.hash)) {
+        if(known->uses > 0) {
+            known->uses--;
+        } else {
+            known->key.clear();
+            if(known->program.compile(expression)) {
+                known->hash = typed.hash;
+                known->key.assign(typed.data, typed.length);
+                known->program.setJitThreshold(jitThreshold);
+                if(known->program.evaluate(nullptr, value))
+                    appendDouble(output, value);
+                else
+                    output.append("####");
+                return;
+            }
+        }
+    }
+
+    expression.foldConstants();
+    if(expression.isConstant()) {
+        value = expression.constantValue();
+    } else if(!program.compile(expression) || !program.evaluate(nullptr, value)) {
+        // what is left after folding can only fail by dividing by zero or leaving the domain of a function
+        output.append("####");
+        return;
+    }
+    appendDouble(output, value);
+}
+
+void LineEvaluator::evaluateLines(const char *begin, const char *end, std::string &output) {
+    while(begin != end) {
+        const char *lineEnd = static_cast<const char *>(std::memchr(begin, '\n', std::size_t(end - begin)));
+        if(!lineEnd)
+            lineEnd = end;
+
+        // blank lines stay blank so that output lines match input lines
+        const char *p = begin;
+        while(p != lineEnd && (*p == ' ' || *p == '\t' || *p == '\r'))
+            p++;
+        if(p != lineEnd)
+            evaluateLine(begin, lineEnd, output);
+        output.push_back('\n');
+
+        begin = lineEnd == end ? end : lineEnd + 1;
+    }
+}
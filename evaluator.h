@@ -0,0 +1,72 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "bytecode.h"
+#include "expression.h"
+#include "resultcache.h"
+
+/* evaluates lines of text, one expression each, the way calc-batch and
+calc-server answer them. It keeps the parse tree and the compiled program
+between lines so that they are allocated once, which is why every thread needs
+an evaluator of its own. Given a cache, which threads can share, it looks up
+every line as typed before parsing it, then the parsed expression, and if asked
+to, every part of it big enough while working it out. Without one it keeps the
+programs of lines that come again instead, by the same typed key, and runs them
+without parsing the line, as machine code once they have run often enough */
+class LineEvaluator
+{
+public:
+    // appends the result of one line, error if it cannot be read or #### if it divides by zero or a function fails
+    void evaluateLine(const char *begin, const char *end, std::string &output);
+    // appends one result line per input line, blank lines stay blank
+    void evaluateLines(const char *begin, const char *end, std::string &output);
+
+    /* looks results up in cache from now on, or stops doing so if cache is null.
+    Parts of an expression with at least partOperators operators are kept too,
+    0 keeps whole expressions only. A double takes a nanosecond or so per
+    operator, a lookup far longer, so parts only pay off when they are large */
+    void setCache(ResultCache *resultCache, int partOperators = 0);
+    // runs of a kept program before it is compiled to machine code, 0 never compiles it
+    void setJitThreshold(unsigned long threshold) { jitThreshold = threshold; }
+
+    enum {
+        // an expression with fewer operators is quicker to work out than to look up
+        MinCachedOperators = 2,
+        // lines whose programs are kept, each in the slot its hash picks
+        KnownLineSlots = 4096,
+        // lines remembered as seen once, only a line seen before gets a slot
+        SeenLineSlots = 16384
+    };
+
+private:
+    /* a line and its program, unfolded. A line that comes again takes the slot
+    once the line in it has missed as many times as it was used, counting up to
+    MaxUses, so a slot wanted by many lines does not change hands on every one */
+    struct KnownLine {
+        std::uint64_t hash = 0;
+        std::string key;
+        Program program;
+        unsigned uses = 0;
+        enum { MaxUses = 3 };
+    };
+
+    bool evaluateCached(int index, double &value);
+    bool seenBefore(std::uint64_t hash);
+
+    ResultCache *cache = nullptr;
+    int minPartOperators = 0;
+    CanonicalExpression canonical;
+    std::string lineText;
+    Expression expression;
+    Program program;
+    unsigned long jitThreshold = Program::DefaultJitThreshold;
+    std::unique_ptr<KnownLine[]> knownLines;
+    // the hash of the typed key of the line last seen in each slot
+    std::unique_ptr<std::uint64_t[]> seenLines;
+};
+
+#endif // EVALUATOR_H
@@ -0,0 +1,262 @@
+#include "expression.h"
+#include "numcodec.h"
+
+static bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static bool isLetter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+Tokenizer::Tokenizer(const char *begin, const char *end)
+    : p(begin), end(end)
+{
+}
+
+// function is invoked to read the next token, skipping any blanks before it
+Token Tokenizer::next() {
+    while(p != end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+
+    Token token = { TokenType::End, Operator::None, 0, p, 0 };
+    if(p == end)
+        return token;
+
+    const char *start = p;
+    if(isDigit(*p) || *p == '.') {
+        // digits with at most one point, then an optional exponent
+        bool seenPoint = false;
+        while(p != end && (isDigit(*p) || (*p == '.' && !seenPoint))) {
+            seenPoint |= *p == '.';
+            p++;
+        }
+        if(p != end && (*p == 'e' || *p == 'E')) {
+            const char *exponent = p + 1;
+            if(exponent != end && (*exponent == '+' || *exponent == '-'))
+                exponent++;
+            if(exponent != end && isDigit(*exponent)) {
+                p = exponent;
+                while(p != end && isDigit(*p))
+                    p++;
+            }
+        }
+        token.type = TokenType::Number;
+        if(parseDouble(start, p, token.value) != p)
+            token.type = TokenType::Invalid;
+    } else if(isLetter(*p)) {
+        while(p != end && (isLetter(*p) || isDigit(*p)))
+            p++;
+        token.type = TokenType::Identifier;
+    } else if(*p == '(') {
+        p++;
+        token.type = TokenType::LeftBracket;
+    } else if(*p == ')') {
+        p++;
+        token.type = TokenType::RightBracket;
+    } else if(*p == '%') {
+        p++;
+        token.type = TokenType::Percent;
+    } else if(*p == '!') {
+        p++;
+        token.type = TokenType::Factorial;
+    } else {
+        std::size_t length;
+        token.op = readOperator(p, std::size_t(end - p), length);
+        token.type = token.op == Operator::None ? TokenType::Invalid : TokenType::Operator;
+        p += token.type == TokenType::Invalid ? 1 : length;
+    }
+
+    token.text = start;
+    token.length = std::size_t(p - start);
+    return token;
+}
+
+// function is invoked to parse a whole line of text into a tree
+bool Expression::parse(const char *begin, const char *end, std::string *error) {
+    nodes.clear();
+    variables.clear();
+    root = -1;
+    tooDeep = false;
+    afterNumber = false;
+
+    Tokenizer tokens(begin, end);
+    Token token = tokens.next();
+    if(token.type == TokenType::End) {
+        if(error)
+            *error = "empty expression";
+        return false;
+    }
+
+    int top = parseBinary(tokens, token, int(Precedence::Additive), 0);
+    if(tooDeep) {
+        if(error)
+            *error = "expression nested too deeply";
+        nodes.clear();
+        return false;
+    }
+    // anything left over after a complete expression, such as a stray bracket, is an error
+    if(top < 0 || token.type != TokenType::End) {
+        if(error)
+            *error = "unexpected " + (token.type == TokenType::End ? std::string("end of expression")
+                                                                   : "'" + std::string(token.text, token.length) + "'");
+        nodes.clear();
+        return false;
+    }
+    root = top;
+    return true;
+}
+
+/* reads operators of at least minimumPrecedence, climbing up for the operators
+that bind tighter. A bracket straight after a number multiplies it, like it
+does on the keypad, so 2(3 + 4) is 2 × (3 + 4) */
+int Expression::parseBinary(Tokenizer &tokens, Token &token, int minimumPrecedence, int depth) {
+    int left = parseUnary(tokens, token, depth);
+    while(left >= 0 && (token.type == TokenType::Operator || (token.type == TokenType::LeftBracket && afterNumber))) {
+        Operator op = token.type == TokenType::Operator ? token.op : Operator::Multiply;
+        int precedence = int(operatorPrecedence(op));
+        if(precedence < minimumPrecedence)
+            break;
+        if(token.type == TokenType::Operator)
+            token = tokens.next();
+        // every operator is left associative, so the right side only takes tighter operators
+        // and so it goes no deeper than there are precedences, depth only counts brackets and signs
+        int right = parseBinary(tokens, token, precedence + 1, depth);
+        if(right < 0)
+            return -1;
+        left = addNode(Node::Binary, op, 0, -1, left, right);
+    }
+    return left;
+}
+
+/* reads signs, then a number, a variable, a function or a bracket, then any
+percent or factorial signs after it. A sign binds tighter than any operator,
+like the sign key does, so -2 ^ 2 is 4 */
+int Expression::parseUnary(Tokenizer &tokens, Token &token, int depth) {
+    if(depth > MaxDepth) {
+        tooDeep = true;
+        return -1;
+    }
+    if(token.type == TokenType::Operator && token.op == Operator::Subtract) {
+        token = tokens.next();
+        int operand = parseUnary(tokens, token, depth + 1);
+        return operand < 0 ? -1 : addNode(Node::Negate, Operator::None, 0, -1, operand, -1);
+    }
+    if(token.type == TokenType::Operator && token.op == Operator::Add) {
+        token = tokens.next();
+        return parseUnary(tokens, token, depth + 1);
+    }
+
+    int operand;
+    bool number = token.type == TokenType::Number;
+    if(number) {
+        operand = addNode(Node::Constant, Operator::None, token.value, -1, -1, -1);
+        token = tokens.next();
+    } else if(token.type == TokenType::Identifier) {
+        Token name = token;
+        token = tokens.next();
+        // a name followed by a bracket is a function, and has to be one
+        if(token.type == TokenType::LeftBracket) {
+            Function function = findFunction(name.text, name.length);
+            if(function == Function::None)
+                return -1;
+            token = tokens.next();
+            operand = parseBinary(tokens, token, int(Precedence::Additive), depth + 1);
+            if(operand < 0 || token.type != TokenType::RightBracket)
+                return -1;
+            token = tokens.next();
+            operand = addNode(Node::Function, Operator::None, 0, -1, operand, -1, function);
+        } else {
+            operand = addNode(Node::Variable, Operator::None, 0, variableIndex(name.text, name.length), -1, -1);
+        }
+    } else if(token.type == TokenType::LeftBracket) {
+        token = tokens.next();
+        operand = parseBinary(tokens, token, int(Precedence::Additive), depth + 1);
+        if(operand < 0 || token.type != TokenType::RightBracket)
+            return -1;
+        token = tokens.next();
+    } else {
+        return -1;
+    }
+
+    afterNumber = number;
+    while(token.type == TokenType::Percent || token.type == TokenType::Factorial) {
+        if(token.type == TokenType::Percent)
+            operand = addNode(Node::Percent, Operator::None, 0, -1, operand, -1);
+        else
+            operand = addNode(Node::Function, Operator::None, 0, -1, operand, -1, Function::Factorial);
+        token = tokens.next();
+        afterNumber = false;
+    }
+    return operand;
+}
+
+// function is invoked to add a node over the nodes it takes, which must not make the tree too deep
+int Expression::addNode(Node::Kind kind, Operator op, double value, int variable, int left, int right,
+                        Function function) {
+    int height = 1;
+    if(left >= 0 && nodes[left].height >= height)
+        height = nodes[left].height + 1;
+    if(right >= 0 && nodes[right].height >= height)
+        height = nodes[right].height + 1;
+    // a long chain like 1 + 1 + ... + 1 gets deep without any nesting
+    tooDeep |= height > MaxDepth;
+    nodes.push_back({ kind, op, function, value, variable, left, right, height });
+    return int(nodes.size() - 1);
+}
+
+// gives every variable name one index, the first time it is seen
+int Expression::variableIndex(const char *name, std::size_t length) {
+    for(std::size_t i = 0; i < variables.size(); i++) {
+        if(variables[i].size() == length && variables[i].compare(0, length, name, length) == 0)
+            return int(i);
+    }
+    variables.emplace_back(name, length);
+    return int(variables.size() - 1);
+}
+
+// function is invoked to fold the whole tree, the folded nodes are left behind unused
+void Expression::foldConstants() {
+    if(root >= 0)
+        root = foldNode(root);
+}
+
+// folds the children of a node first, then the node itself if all of them became constants
+int Expression::foldNode(int index) {
+    Node node = nodes[index];
+    if(node.left >= 0)
+        node.left = foldNode(node.left);
+    if(node.right >= 0)
+        node.right = foldNode(node.right);
+    nodes[index] = node;
+
+    switch(node.kind) {
+    case Node::Negate:
+        if(nodes[node.left].kind == Node::Constant)
+            return addNode(Node::Constant, Operator::None, -nodes[node.left].value, -1, -1, -1);
+        break;
+    case Node::Percent:
+        if(nodes[node.left].kind == Node::Constant)
+            return addNode(Node::Constant, Operator::None, nodes[node.left].value / 100, -1, -1, -1);
+        break;
+    case Node::Function:
+        if(nodes[node.left].kind == Node::Constant) {
+            double value = nodes[node.left].value;
+            // a function outside of its domain is left for the evaluation to report, like a division by zero
+            if(applyFunction(node.function, value))
+                return addNode(Node::Constant, Operator::None, value, -1, -1, -1);
+        }
+        break;
+    case Node::Binary:
+        if(nodes[node.left].kind == Node::Constant && nodes[node.right].kind == Node::Constant) {
+            double value = nodes[node.left].value;
+            // a division by zero is left for the evaluation to report
+            if(operatorInfo(node.op).apply(value, nodes[node.right].value))
+                return addNode(Node::Constant, Operator::None, value, -1, -1, -1);
+        }
+        break;
+    default:
+        break;
+    }
+    return index;
+}
@@ -0,0 +1,106 @@
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "operators.h"
+
+// the pieces a line of text is cut into
+enum class TokenType : unsigned char {
+    Number,
+    Identifier,
+    Operator,
+    LeftBracket,
+    RightBracket,
+    Percent,
+    Factorial,
+    End,
+    Invalid
+};
+
+struct Token {
+    TokenType type;
+    Operator op;
+    double value;
+    const char *text;
+    std::size_t length;
+};
+
+// cuts a line of text into tokens, one at a time
+class Tokenizer
+{
+public:
+    Tokenizer(const char *begin, const char *end);
+
+    Token next();
+
+private:
+    const char *p;
+    const char *end;
+};
+
+// one node of the syntax tree, children are indices into the node list of the tree
+struct Node {
+    enum Kind : unsigned char {
+        Constant,
+        Variable,
+        Negate,
+        Percent,
+        Binary,
+        Function
+    };
+
+    Kind kind;
+    Operator op;
+    ::Function function;
+    // the value of a constant, or the index of a variable
+    double value;
+    int variable;
+    int left;
+    int right;
+    // the most nodes on a way down from this one to a leaf, itself included
+    int height;
+};
+
+// a parsed expression, the nodes are stored flat so that a tree is one allocation
+class Expression
+{
+public:
+    // parses a whole line, returns false and fills error if it cannot be read
+    bool parse(const char *begin, const char *end, std::string *error = nullptr);
+
+    // replaces every part that does not depend on a variable by its value
+    void foldConstants();
+
+    bool isConstant() const { return !nodes.empty() && nodes[root].kind == Node::Constant; }
+    double constantValue() const { return nodes[root].value; }
+
+    const std::vector<Node> &nodeList() const { return nodes; }
+    int rootNode() const { return root; }
+    // the names of the variables, in the order their indices were given out
+    const std::vector<std::string> &variableNames() const { return variables; }
+
+    enum {
+        // the deepest a tree can be, and brackets and signs can nest, so that parsing or walking a tree never runs out of stack
+        MaxDepth = 4000
+    };
+
+private:
+    int parseBinary(Tokenizer &tokens, Token &token, int minimumPrecedence, int depth);
+    int parseUnary(Tokenizer &tokens, Token &token, int depth);
+    int addNode(Node::Kind kind, Operator op, double value, int variable, int left, int right,
+                Function function = Function::None);
+    int foldNode(int index);
+    int variableIndex(const char *name, std::size_t length);
+
+    std::vector<Node> nodes;
+    std::vector<std::string> variables;
+    int root = -1;
+    // set while parsing once the tree or the nesting grows past MaxDepth
+    bool tooDeep = false;
+    // the operand parsed last was a number on its own, which a bracket after it multiplies
+    bool afterNumber = false;
+};
+
+#endif // EXPRESSION_H
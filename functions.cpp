@@ -0,0 +1,180 @@
+#include "functions.h"
+#include "decimal.h"
+#include "mathkernels.h"
+#include <cmath>
+#include <cstring>
+
+static const FunctionInfo functionTable[] = {
+    { "",      "" },
+    { "sqrt",  "\342\210\232" },
+    { "exp",   "e\313\243" },
+    { "ln",    "ln" },
+    { "log",   "log" },
+    { "sin",   "sin" },
+    { "cos",   "cos" },
+    { "tan",   "tan" },
+    { "asin",  "sin\342\201\273\302\271" },
+    { "acos",  "cos\342\201\273\302\271" },
+    { "atan",  "tan\342\201\273\302\271" },
+    { "gamma", "\316\223" },
+    { "!",     "n!" },
+};
+
+static_assert(sizeof(functionTable) / sizeof(functionTable[0]) == std::size_t(Function::Count),
+              "every function needs a row in functionTable");
+
+const FunctionInfo &functionInfo(Function function) {
+    return functionTable[std::size_t(function)];
+}
+
+Function findFunction(const char *name, std::size_t length) {
+    for(std::size_t i = 1; i < std::size_t(Function::Count); i++) {
+        if(!isPostfixFunction(Function(i)) && std::strlen(functionTable[i].name) == length
+           && std::memcmp(functionTable[i].name, name, length) == 0)
+            return Function(i);
+    }
+    return Function::None;
+}
+
+// one lane, for working out one value at a time the same way a column kernel does
+struct ScalarLanes {
+    typedef double Value;
+    typedef std::uint64_t Bits;
+    typedef bool Mask;
+    enum { Width = 1 };
+
+    static Value load(const double *p) { return *p; }
+    static void store(double *p, Value value) { *p = value; }
+    static Value splat(double value) { return value; }
+    static Bits splatBits(std::uint64_t bits) { return bits; }
+    static Bits toBits(Value value) {
+        Bits bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+    static Value fromBits(Bits bits) {
+        Value value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    static Bits addBits(Bits a, Bits b) { return a + b; }
+    static Bits subtractBits(Bits a, Bits b) { return a - b; }
+    static Bits andBits(Bits a, Bits b) { return a & b; }
+    static Bits orBits(Bits a, Bits b) { return a | b; }
+    static Bits shiftLeft(Bits bits, int count) { return bits << count; }
+    static Bits shiftRight(Bits bits, int count) { return bits >> count; }
+    static Mask less(Value a, Value b) { return a < b; }
+    static Mask equal(Value a, Value b) { return a == b; }
+    static Mask both(Mask a, Mask b) { return a && b; }
+    static Mask either(Mask a, Mask b) { return a || b; }
+    static Mask negate(Mask mask) { return !mask; }
+    static Mask bitSet(Bits bits, int bit) { return (bits >> bit) & 1; }
+    static Value select(Mask mask, Value a, Value b) { return mask ? a : b; }
+    static Value sqrt(Value value) { return std::sqrt(value); }
+    static int maskBits(Mask mask) { return mask; }
+};
+
+static const double Pi = 3.14159265358979311600e+00;
+static const double SqrtTwoPi = 2.50662827463100024161e+00;
+// no factorial above 170! fits in a double
+static const int MaxFactorial = 170;
+
+// the Lanczos approximation with g = 7, good to about 1e-15 of the result for small x and 1e-13 near 170
+static const double LanczosG = 7;
+static const double lanczosCoefficients[] = {
+    0.99999999999980993, 676.5203681218851, -1259.1392167224028,
+    771.32342877765313, -176.61502916214059, 12.507343278686905,
+    -0.13857109526572012, 9.9843695780195716e-6, 1.5056327351493116e-7
+};
+
+/* 0! to 170!, each the exact product rounded once to a double, so that gamma
+of an integer is exact wherever a double can be */
+static const double *factorialTable() {
+    static const struct Table {
+        double values[MaxFactorial + 1];
+        Table() {
+            Decimal product(1);
+            values[0] = 1;
+            for(int n = 1; n <= MaxFactorial; n++) {
+                product = Decimal::multiply(product, Decimal(n));
+                values[n] = product.toDouble();
+            }
+        }
+    } table;
+    return table.values;
+}
+
+// sin(pi x) without the error of multiplying a large x by pi first
+static double sinPi(double x) {
+    // whole turns change nothing, and sin(pi x) = sin(pi (1 - x)) folds the rest into [-1/2, 1/2]
+    double r = x - 2 * std::nearbyint(x / 2);
+    if(r > 0.5)
+        r = 1 - r;
+    else if(r < -0.5)
+        r = -1 - r;
+    bool failed;
+    return MathKernels::sin<ScalarLanes>(Pi * r, failed);
+}
+
+/* the gamma function, failing at its poles (0 and the negative integers).
+Integers are looked up, everything below 1/2 is reflected to above it */
+static bool applyGamma(double &value) {
+    double x = value;
+    if(x != x)
+        return true;
+    bool integer = x == std::nearbyint(x);
+    if(integer && x <= 0)
+        return false;
+    if(integer && x <= MaxFactorial + 1) {
+        value = factorialTable()[int(x) - 1];
+        return true;
+    }
+    // above 171.62 the result is infinite
+    if(x > 172) {
+        value = HUGE_VAL;
+        return true;
+    }
+
+    if(x < 0.5) {
+        // gamma(x) gamma(1 - x) = pi / sin(pi x)
+        double reflected = 1 - x;
+        if(!applyGamma(reflected))
+            return false;
+        value = Pi / (sinPi(x) * reflected);
+        return true;
+    }
+
+    x -= 1;
+    double sum = lanczosCoefficients[0];
+    for(int i = 1; i < 9; i++)
+        sum += lanczosCoefficients[i] / (x + i);
+    double t = x + LanczosG + 0.5;
+    // t^(x + 1/2) is taken in two halves, it overflows on its own long before gamma does
+    bool failed;
+    double half = MathKernels::power<ScalarLanes>(t, (x + 0.5) * 0.5, failed);
+    value = SqrtTwoPi * half * (half * MathKernels::exp<ScalarLanes>(-t)) * sum;
+    return true;
+}
+
+bool applyFunction(Function function, double &value) {
+    bool failed = false;
+    switch(function) {
+    case Function::None:
+        return true;
+    case Function::Gamma:
+        return applyGamma(value);
+    case Function::Factorial:
+        // n! = gamma(n + 1), which is the same for integers and carries on in between
+        value += 1;
+        return applyGamma(value);
+    default:
+        value = MathKernels::apply<ScalarLanes>(function, value, failed);
+        return !failed;
+    }
+}
+
+bool raisePower(double &base, double exponent) {
+    bool failed;
+    base = MathKernels::power<ScalarLanes>(base, exponent, failed);
+    return !failed;
+}
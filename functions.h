@@ -0,0 +1,56 @@
+#ifndef FUNCTIONS_H
+#define FUNCTIONS_H
+
+#include <cstddef>
+
+// every function of one number the engine knows, None meaning that there is no function
+enum class Function : unsigned char {
+    None,
+    SquareRoot,
+    Exponential,
+    NaturalLog,
+    Log10,
+    Sine,
+    Cosine,
+    Tangent,
+    ArcSine,
+    ArcCosine,
+    ArcTangent,
+    Gamma,
+    Factorial,
+    Count
+};
+
+// one row per function, indexed by the function itself
+struct FunctionInfo {
+    // how the function is written in an entry and in a key log, like sqrt or !
+    const char *name;
+    // the label shown on its button
+    const char *label;
+};
+
+const FunctionInfo &functionInfo(Function function);
+
+inline const char *functionName(Function function) { return functionInfo(function).name; }
+inline const char *functionLabel(Function function) { return functionInfo(function).label; }
+// factorial is written after its operand, every other function before it in brackets
+inline bool isPostfixFunction(Function function) { return function == Function::Factorial; }
+
+// the function called name (None if there is none), for the ones written before their operand
+Function findFunction(const char *name, std::size_t length);
+
+/* applies a function to value, returns false (like dividing by zero does) if
+value is outside of what the function is defined for: a negative square root,
+the log of 0 or less, the inverse sine or cosine of more than 1, the gamma
+function at 0 or a negative integer, and the sine, cosine or tangent of angles
+so large (beyond 10^8 radians) that their remainder in turns is meaningless.
+The angles are in radians. Results that overflow are infinite, not failures.
+Gamma and factorial are exact at the integers, elsewhere about 13 digits */
+bool applyFunction(Function function, double &value);
+
+/* raises base to exponent, returns false for 0 to a negative power and for a
+negative base to a power that is not an integer. Integer powers up to 64 are
+multiplied out, so that they are as exact as a product */
+bool raisePower(double &base, double exponent);
+
+#endif // FUNCTIONS_H
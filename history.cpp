@@ -0,0 +1,386 @@
+#include "history.h"
+#include "numcodec.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// every file of the tape starts with one of these, so that a wrong file is never taken for one
+static const char DataMagic[] = "CALCTAP1";
+static const char OffsetMagic[] = "CALCIDX1";
+static const char ValueMagic[] = "CALCVAL1";
+static const char TextMagic[] = "CALCTXT1";
+static const std::size_t MagicSize = 8;
+
+// what comes before the text of every record, written as it is in memory
+struct RecordHeader {
+    std::int64_t time;
+    double value;
+    std::uint32_t expressionLength;
+    std::uint16_t resultLength;
+    std::uint8_t mode;
+    std::uint8_t reserved;
+};
+
+static_assert(sizeof(RecordHeader) == 24, "a record header is 24 bytes on every platform");
+
+// results longer than this are cut, no display shows that much anyway
+static const std::size_t MaxResultLength = 0xffff;
+
+static bool fileExists(const std::string &path) {
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if(!file)
+        return false;
+    std::fclose(file);
+    return true;
+}
+
+// creates a file holding nothing but its magic
+static bool createFile(const std::string &path, const char *magic) {
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if(!file)
+        return false;
+    bool written = std::fwrite(magic, 1, MagicSize, file) == MagicSize;
+    return std::fclose(file) == 0 && written;
+}
+
+static bool hasMagic(const MappedFile &file, const char *magic) {
+    return file.size() >= MagicSize && std::memcmp(file.data(), magic, MagicSize) == 0;
+}
+
+// compares two texts the way a dictionary orders them
+static int compareText(const char *a, std::size_t aLength, const char *b, std::size_t bLength) {
+    int result = std::memcmp(a, b, aLength < bLength ? aLength : bLength);
+    if(result != 0)
+        return result;
+    return aLength < bLength ? -1 : aLength > bLength ? 1 : 0;
+}
+
+HistoryTape::HistoryTape()
+    : mappedCount(0), dataFile(nullptr), offsetFile(nullptr), dataSize(0)
+    , valueCovered(0), textCovered(0)
+    , valueIndexLoaded(false), textIndexLoaded(false)
+    , valueIndexChanged(false), textIndexChanged(false)
+{
+}
+
+HistoryTape::~HistoryTape() {
+    close();
+}
+
+// function is invoked to open the tape, mapping whatever is on it already
+bool HistoryTape::open(const std::string &path) {
+    close();
+    std::string offsetPath = path + ".idx";
+    if(!fileExists(path) && (!createFile(path, DataMagic) || !createFile(offsetPath, OffsetMagic)))
+        return false;
+    if(!fileExists(offsetPath) && !createFile(offsetPath, OffsetMagic))
+        return false;
+
+    // entries are read one here and one there, as they are scrolled to
+    if(!mappedData.open(path.c_str(), MappedFile::Random) || !hasMagic(mappedData, DataMagic)
+       || !mappedOffsets.open(offsetPath.c_str(), MappedFile::Random) || !hasMagic(mappedOffsets, OffsetMagic)) {
+        mappedData.close();
+        mappedOffsets.close();
+        return false;
+    }
+
+    /* the record is written before its offset, so a crash in between leaves a
+    record without an offset, which is never read. A torn offset at the end is
+    dropped, and so is one pointing past the records */
+    mappedCount = (mappedOffsets.size() - MagicSize) / sizeof(std::uint64_t);
+    while(mappedCount) {
+        std::uint64_t offset;
+        std::memcpy(&offset, mappedOffsets.data() + MagicSize + (mappedCount - 1) * sizeof(offset), sizeof(offset));
+        RecordHeader header;
+        if(offset + sizeof(header) <= mappedData.size()) {
+            std::memcpy(&header, mappedData.data() + offset, sizeof(header));
+            if(offset + sizeof(header) + header.expressionLength + header.resultLength <= mappedData.size())
+                break;
+        }
+        mappedCount--;
+    }
+
+    dataFile = std::fopen(path.c_str(), "ab");
+    offsetFile = std::fopen(offsetPath.c_str(), "ab");
+    if(!dataFile || !offsetFile) {
+        close();
+        return false;
+    }
+    dataSize = mappedData.size();
+    // a torn offset is overwritten by the next one instead of staying in the way
+    if(mappedOffsets.size() != MagicSize + mappedCount * sizeof(std::uint64_t)) {
+        std::fclose(offsetFile);
+        offsetFile = std::fopen(offsetPath.c_str(), "r+b");
+        if(!offsetFile || std::fseek(offsetFile, long(MagicSize + mappedCount * sizeof(std::uint64_t)), SEEK_SET) != 0) {
+            close();
+            return false;
+        }
+    }
+    tapePath = path;
+    return true;
+}
+
+void HistoryTape::close() {
+    if(valueIndexChanged)
+        saveIndex(tapePath + ".values", ValueMagic, valueCovered, valueIndex.data(), valueIndex.size() * sizeof(ValueKey));
+    if(textIndexChanged)
+        saveIndex(tapePath + ".texts", TextMagic, textCovered, textIndex.data(), textIndex.size() * sizeof(std::uint64_t));
+
+    if(dataFile)
+        std::fclose(dataFile);
+    if(offsetFile)
+        std::fclose(offsetFile);
+    dataFile = nullptr;
+    offsetFile = nullptr;
+    mappedData.close();
+    mappedOffsets.close();
+    mappedCount = 0;
+    added.clear();
+    dataSize = 0;
+    valueIndex.clear();
+    textIndex.clear();
+    valueCovered = 0;
+    textCovered = 0;
+    valueIndexLoaded = textIndexLoaded = false;
+    valueIndexChanged = textIndexChanged = false;
+    tapePath.clear();
+}
+
+// function is invoked to read one entry, out of the mapping or out of what was added since
+HistoryEntry HistoryTape::entry(std::size_t index) const {
+    const char *record;
+    if(index < mappedCount) {
+        std::uint64_t offset;
+        std::memcpy(&offset, mappedOffsets.data() + MagicSize + index * sizeof(offset), sizeof(offset));
+        record = mappedData.data() + offset;
+    } else {
+        record = added[index - mappedCount].data();
+    }
+
+    RecordHeader header;
+    std::memcpy(&header, record, sizeof(header));
+    HistoryEntry result;
+    result.time = header.time;
+    result.value = header.value;
+    result.mode = NumberMode(header.mode);
+    result.expression = record + sizeof(header);
+    result.expressionLength = header.expressionLength;
+    result.result = result.expression + header.expressionLength;
+    result.resultLength = header.resultLength;
+    return result;
+}
+
+// function is invoked to put an entry at the end of the tape, on the disk straight away
+bool HistoryTape::append(const std::string &expression, const std::string &result, double value, NumberMode mode) {
+    if(!isOpen())
+        return false;
+
+    RecordHeader header;
+    header.time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    header.value = value;
+    header.expressionLength = std::uint32_t(expression.size());
+    header.resultLength = std::uint16_t(result.size() < MaxResultLength ? result.size() : MaxResultLength);
+    header.mode = std::uint8_t(mode);
+    header.reserved = 0;
+
+    std::string record(reinterpret_cast<const char *>(&header), sizeof(header));
+    record += expression;
+    record.append(result, 0, header.resultLength);
+
+    // the record goes first, its offset only once the record is there
+    std::uint64_t offset = dataSize;
+    if(std::fwrite(record.data(), 1, record.size(), dataFile) != record.size() || std::fflush(dataFile) != 0)
+        return false;
+    dataSize += record.size();
+    if(std::fwrite(&offset, sizeof(offset), 1, offsetFile) != 1 || std::fflush(offsetFile) != 0)
+        return false;
+    added.push_back(std::move(record));
+    return true;
+}
+
+// reads an index file written by saveIndex, returns false if there is none or it does not fit the tape
+bool HistoryTape::loadIndex(const std::string &path, const char *magic, std::size_t itemSize,
+                            std::vector<char> &items, std::size_t &covered) const {
+    MappedFile file;
+    std::uint64_t fileCovered;
+    if(!file.open(path.c_str()) || !hasMagic(file, magic) || file.size() < MagicSize + sizeof(fileCovered))
+        return false;
+    std::memcpy(&fileCovered, file.data() + MagicSize, sizeof(fileCovered));
+    std::size_t itemBytes = file.size() - MagicSize - sizeof(fileCovered);
+    // an index of more entries than the tape has belongs to another tape
+    if(fileCovered > count() || itemBytes % itemSize != 0 || itemBytes / itemSize > fileCovered)
+        return false;
+    items.assign(file.data() + MagicSize + sizeof(fileCovered), file.data() + file.size());
+    covered = std::size_t(fileCovered);
+    return true;
+}
+
+// writes an index next to the tape, through a temporary file so that a crash never leaves half of one
+bool HistoryTape::saveIndex(const std::string &path, const char *magic, std::size_t covered,
+                            const void *items, std::size_t size) const {
+    std::string temporaryPath = path + ".new";
+    std::FILE *file = std::fopen(temporaryPath.c_str(), "wb");
+    if(!file)
+        return false;
+    std::uint64_t fileCovered = covered;
+    bool written = std::fwrite(magic, 1, MagicSize, file) == MagicSize
+                   && std::fwrite(&fileCovered, sizeof(fileCovered), 1, file) == 1
+                   && (size == 0 || std::fwrite(items, 1, size, file) == size);
+    if(std::fclose(file) != 0 || !written) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    // rename does not replace a file on windows
+    std::remove(path.c_str());
+#endif
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+// brings the index by value up to date, loading it first if it was not yet
+void HistoryTape::updateValueIndex() {
+    if(!valueIndexLoaded) {
+        std::vector<char> items;
+        if(loadIndex(tapePath + ".values", ValueMagic, sizeof(ValueKey), items, valueCovered)) {
+            valueIndex.resize(items.size() / sizeof(ValueKey));
+            if(!items.empty())
+                std::memcpy(valueIndex.data(), items.data(), items.size());
+        } else {
+            valueCovered = 0;
+        }
+        // NaN values are left out, but an index with more items than it covers is not one this tape wrote
+        if(valueIndex.size() > valueCovered) {
+            valueIndex.clear();
+            valueCovered = 0;
+        }
+        valueIndexLoaded = true;
+    }
+    if(valueCovered == count())
+        return;
+
+    // the new entries are sorted by themselves and merged in, the rest is never sorted again
+    auto byValue = [](const ValueKey &a, const ValueKey &b) {
+        return a.value < b.value || (a.value == b.value && a.index < b.index);
+    };
+    std::size_t oldSize = valueIndex.size();
+    for(std::size_t i = valueCovered; i < count(); i++) {
+        double value = entry(i).value;
+        if(!std::isnan(value))
+            valueIndex.push_back({ value, i });
+    }
+    std::sort(valueIndex.begin() + std::ptrdiff_t(oldSize), valueIndex.end(), byValue);
+    std::inplace_merge(valueIndex.begin(), valueIndex.begin() + std::ptrdiff_t(oldSize), valueIndex.end(), byValue);
+    valueCovered = count();
+    valueIndexChanged = true;
+}
+
+// brings the index by text up to date, the same way
+void HistoryTape::updateTextIndex() {
+    if(!textIndexLoaded) {
+        std::vector<char> items;
+        if(loadIndex(tapePath + ".texts", TextMagic, sizeof(std::uint64_t), items, textCovered)) {
+            textIndex.resize(items.size() / sizeof(std::uint64_t));
+            if(!items.empty())
+                std::memcpy(textIndex.data(), items.data(), items.size());
+        } else {
+            textCovered = 0;
+        }
+        // an index with fewer items than it covers is not one this tape wrote
+        if(textIndex.size() != textCovered) {
+            textIndex.clear();
+            textCovered = 0;
+        }
+        textIndexLoaded = true;
+    }
+    if(textCovered == count())
+        return;
+
+    auto byText = [this](std::uint64_t a, std::uint64_t b) {
+        HistoryEntry first = entry(std::size_t(a));
+        HistoryEntry second = entry(std::size_t(b));
+        int order = compareText(first.expression, first.expressionLength, second.expression, second.expressionLength);
+        return order < 0 || (order == 0 && a < b);
+    };
+    std::size_t oldSize = textIndex.size();
+    for(std::size_t i = textCovered; i < count(); i++)
+        textIndex.push_back(i);
+    std::sort(textIndex.begin() + std::ptrdiff_t(oldSize), textIndex.end(), byText);
+    std::inplace_merge(textIndex.begin(), textIndex.begin() + std::ptrdiff_t(oldSize), textIndex.end(), byText);
+    textCovered = count();
+    textIndexChanged = true;
+}
+
+// keeps the newest limit of what was found, newest first
+static void newestFirst(std::vector<std::size_t> &found, std::size_t limit) {
+    std::sort(found.begin(), found.end(), [](std::size_t a, std::size_t b) { return a > b; });
+    if(found.size() > limit)
+        found.resize(limit);
+}
+
+// function is invoked to find the entries that start with some text, by binary search in the index by text
+std::vector<std::size_t> HistoryTape::findPrefix(const char *prefix, std::size_t length, std::size_t limit) {
+    std::vector<std::size_t> found;
+    if(!isOpen())
+        return found;
+    updateTextIndex();
+
+    // the first entry that does not come before the prefix, every match follows it in one run
+    auto first = std::partition_point(textIndex.begin(), textIndex.end(), [&](std::uint64_t index) {
+        HistoryEntry item = entry(std::size_t(index));
+        return compareText(item.expression, item.expressionLength, prefix, length) < 0;
+    });
+    for(auto it = first; it != textIndex.end(); ++it) {
+        HistoryEntry item = entry(std::size_t(*it));
+        if(item.expressionLength < length || std::memcmp(item.expression, prefix, length) != 0)
+            break;
+        found.push_back(std::size_t(*it));
+    }
+    newestFirst(found, limit);
+    return found;
+}
+
+// function is invoked to find the entries with a value in a range, by binary search in the index by value
+std::vector<std::size_t> HistoryTape::findValue(double low, double high, std::size_t limit) {
+    std::vector<std::size_t> found;
+    if(!isOpen())
+        return found;
+    updateValueIndex();
+
+    auto first = std::partition_point(valueIndex.begin(), valueIndex.end(),
+                                      [low](const ValueKey &key) { return key.value < low; });
+    for(auto it = first; it != valueIndex.end() && it->value <= high; ++it)
+        found.push_back(std::size_t(it->index));
+    newestFirst(found, limit);
+    return found;
+}
+
+// function is invoked to turn a typed number into the range of values that round to it
+bool readValueRange(const char *text, std::size_t length, double &low, double &high) {
+    const char *end = text + length;
+    double value;
+    if(length == 0 || parseDouble(text, end, value) != end || !std::isfinite(value))
+        return false;
+
+    // the last digit typed has the place of the decimals after the point, less the exponent
+    int decimals = 0;
+    bool seenPoint = false;
+    const char *p = text;
+    for(; p != end && *p != 'e' && *p != 'E'; p++) {
+        if(*p == '.')
+            seenPoint = true;
+        else if(seenPoint)
+            decimals++;
+    }
+    int exponent = 0;
+    if(p != end) {
+        double written;
+        parseDouble(p + 1 + (p[1] == '+'), end, written);
+        exponent = int(written);
+    }
+    double halfUnit = 0.5 * std::pow(10.0, double(exponent - decimals));
+    low = value - halfUnit;
+    high = value + halfUnit;
+    return true;
+}
@@ -0,0 +1,92 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "engine.h"
+#include "mappedfile.h"
+
+// one calculation on the history tape, its text points into the tape
+struct HistoryEntry {
+    // milliseconds since 1970
+    std::int64_t time;
+    // the result as a double, NaN if the entry divided by zero
+    double value;
+    NumberMode mode;
+    const char *expression;
+    std::size_t expressionLength;
+    const char *result;
+    std::size_t resultLength;
+};
+
+/* an append-only log of every finished entry, kept in two files: the records
+themselves at path and the offset of every record at path.idx. Both are mapped
+when the tape is opened, so opening it takes the same time however many entries
+it holds, and any entry can be read straight away. The indexes for searching by
+value and by text are built the first time they are needed, brought up to date
+with the entries added since, and kept next to the tape */
+class HistoryTape
+{
+public:
+    HistoryTape();
+    ~HistoryTape();
+
+    HistoryTape(const HistoryTape &) = delete;
+    HistoryTape &operator=(const HistoryTape &) = delete;
+
+    // opens the tape at path, creating it if there is none, returns false if it cannot
+    bool open(const std::string &path);
+    // writes back whatever search index has changed
+    void close();
+    bool isOpen() const { return dataFile != nullptr; }
+
+    std::size_t count() const { return mappedCount + added.size(); }
+    // the entry at index, the oldest first. Its text is good until the next append()
+    HistoryEntry entry(std::size_t index) const;
+    bool append(const std::string &expression, const std::string &result, double value, NumberMode mode);
+
+    // the entries whose expression starts with prefix, newest first and at most limit of them
+    std::vector<std::size_t> findPrefix(const char *prefix, std::size_t length, std::size_t limit);
+    // the entries with a value from low to high, newest first and at most limit of them
+    std::vector<std::size_t> findValue(double low, double high, std::size_t limit);
+
+private:
+    struct ValueKey {
+        double value;
+        std::uint64_t index;
+    };
+
+    void updateValueIndex();
+    void updateTextIndex();
+    bool loadIndex(const std::string &path, const char *magic, std::size_t itemSize,
+                   std::vector<char> &items, std::size_t &covered) const;
+    bool saveIndex(const std::string &path, const char *magic, std::size_t covered,
+                   const void *items, std::size_t size) const;
+
+    std::string tapePath;
+    MappedFile mappedData;
+    MappedFile mappedOffsets;
+    std::size_t mappedCount;
+    // the records appended since the tape was opened, which the mappings do not cover
+    std::vector<std::string> added;
+    std::FILE *dataFile;
+    std::FILE *offsetFile;
+    std::uint64_t dataSize;
+
+    // both indexes cover the entries before valueCovered and textCovered, NaN values are left out
+    std::vector<ValueKey> valueIndex;
+    std::vector<std::uint64_t> textIndex;
+    std::size_t valueCovered, textCovered;
+    bool valueIndexLoaded, textIndexLoaded;
+    bool valueIndexChanged, textIndexChanged;
+};
+
+/* reads a number the way a search for a value is typed, as the range of values
+that round to it: 0.33 finds everything from 0.325 to 0.335. Returns false if
+text is not a number */
+bool readValueRange(const char *text, std::size_t length, double &low, double &high);
+
+#endif // HISTORY_H
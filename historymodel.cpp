@@ -0,0 +1,80 @@
+#include "historymodel.h"
+#include "history.h"
+#include <QDateTime>
+#include <climits>
+
+// defines the class of HistoryModel, showing the entries of a tape
+HistoryModel::HistoryModel(HistoryTape *historyTape, QObject *parent)
+    : QAbstractListModel(parent), tape(historyTape)
+{
+}
+
+int HistoryModel::rowCount(const QModelIndex &parent) const {
+    if(parent.isValid() || !tape->isOpen())
+        return 0;
+    std::size_t rows = searchText.isEmpty() ? tape->count() : found.size();
+    return rows > std::size_t(INT_MAX) ? INT_MAX : int(rows);
+}
+
+// the newest entry is the first row, unless a search decides the rows
+std::size_t HistoryModel::entryIndex(int row) const {
+    if(!searchText.isEmpty())
+        return found[std::size_t(row)];
+    return tape->count() - 1 - std::size_t(row);
+}
+
+// function is invoked for every visible row, reading its entry straight off the tape
+QVariant HistoryModel::data(const QModelIndex &index, int role) const {
+    if(!index.isValid() || index.row() >= rowCount())
+        return QVariant();
+
+    HistoryEntry item = tape->entry(entryIndex(index.row()));
+    if(role == Qt::DisplayRole) {
+        return tr("%1 = %2").arg(QString::fromUtf8(item.expression, qsizetype(item.expressionLength)),
+                                 QString::fromUtf8(item.result, qsizetype(item.resultLength)));
+    }
+    if(role == Qt::ToolTipRole) {
+        QString when = QDateTime::fromMSecsSinceEpoch(item.time).toString(Qt::TextDate);
+        if(item.mode == NumberMode::Decimal)
+            return tr("%1, decimal").arg(when);
+        return item.mode == NumberMode::Rational ? tr("%1, exact").arg(when) : when;
+    }
+    return QVariant();
+}
+
+// function is invoked whenever the search text changes
+void HistoryModel::setSearch(const QString &text) {
+    beginResetModel();
+    searchText = text.trimmed();
+    found.clear();
+    if(!searchText.isEmpty() && tape->isOpen()) {
+        QByteArray search = searchText.toUtf8();
+        double low, high;
+        if(readValueRange(search.constData(), std::size_t(search.size()), low, high))
+            found = tape->findValue(low, high, SearchLimit);
+        else
+            found = tape->findPrefix(search.constData(), std::size_t(search.size()), SearchLimit);
+    }
+    endResetModel();
+}
+
+// function is invoked to append an entry, which is the newest and so the first row
+bool HistoryModel::append(const std::string &expression, const std::string &result, double value, NumberMode mode) {
+    if(!tape->isOpen())
+        return false;
+    // while searching, the new entry only shows if the search finds it
+    if(!searchText.isEmpty()) {
+        bool appended = tape->append(expression, result, value, mode);
+        setSearch(searchText);
+        return appended;
+    }
+    beginInsertRows(QModelIndex(), 0, 0);
+    bool appended = tape->append(expression, result, value, mode);
+    endInsertRows();
+    // a failed write leaves the tape as it was, and the view has to hear that
+    if(!appended) {
+        beginResetModel();
+        endResetModel();
+    }
+    return appended;
+}
@@ -0,0 +1,39 @@
+#ifndef HISTORYMODEL_H
+#define HISTORYMODEL_H
+
+#include <QAbstractListModel>
+#include <string>
+#include <vector>
+#include "engine.h"
+
+class HistoryTape;
+
+/* the entries of a history tape for a list view, newest first. Rows are read
+off the tape only when the view asks for them, which with uniform item sizes
+is only for the rows that are visible */
+class HistoryModel: public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    explicit HistoryModel(HistoryTape *historyTape, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    // the entry on the tape that a row shows
+    std::size_t entryIndex(int row) const;
+    // shows only what a search finds, a number finding results and anything else expressions
+    // that start with it, or everything again if text is empty
+    void setSearch(const QString &text);
+    // appends an entry to the tape, where it becomes the first row
+    bool append(const std::string &expression, const std::string &result, double value, NumberMode mode);
+
+    enum { SearchLimit = 10000 };
+
+private:
+    HistoryTape *tape;
+    QString searchText;
+    std::vector<std::size_t> found;
+};
+
+#endif // HISTORYMODEL_H
@@ -0,0 +1,273 @@
+#include "jit.h"
+#include "bytecode.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define CALC_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+NativeProgram::NativeProgram()
+    : entry(nullptr), mapping(nullptr), mappingSize(0), codeSize(0)
+{
+}
+
+NativeProgram::~NativeProgram() {
+    release();
+}
+
+#ifdef CALC_JIT
+
+/* the code keeps the inputs in rbx, the temporaries in rbp and where the
+result goes in r13, all of which survive the calls to raisePower() and
+applyFunction(). Every register of the program lives in memory: constants
+after the code, read relative to the instruction pointer, inputs and
+temporaries at their offset from rbx and rbp. Only xmm0 carries a value from
+one instruction to the next */
+class CodeWriter
+{
+public:
+    explicit CodeWriter(const Program &program)
+        : firstInput(program.firstInput()), firstTemporary(program.firstInput() + program.inputCount())
+    {
+    }
+
+    void bytes(std::initializer_list<unsigned char> list) { code.insert(code.end(), list); }
+    void imm32(std::uint32_t value) {
+        for(int i = 0; i < 4; i++)
+            code.push_back((unsigned char)(value >> (8 * i)));
+    }
+    void imm64(std::uint64_t value) {
+        imm32(std::uint32_t(value));
+        imm32(std::uint32_t(value >> 32));
+    }
+
+    // an SSE2 instruction on xmm and a register of the program, like movsd xmm0, [rbx + 8]
+    void memory(unsigned char prefix, unsigned char opcode, int xmm, int reg) {
+        bytes({ prefix, 0x0f, opcode });
+        if(std::size_t(reg) < firstInput) {
+            // [rip + disp32], patched once the constants have their place after the code
+            code.push_back((unsigned char)(0x05 | xmm << 3));
+            constantFixups.push_back({ code.size(), std::size_t(reg) });
+            imm32(0);
+        } else if(std::size_t(reg) < firstTemporary) {
+            // [rbx + disp32]
+            code.push_back((unsigned char)(0x83 | xmm << 3));
+            imm32(std::uint32_t(8 * (reg - firstInput)));
+        } else {
+            // [rbp + disp32]
+            code.push_back((unsigned char)(0x85 | xmm << 3));
+            imm32(std::uint32_t(8 * (reg - firstTemporary)));
+        }
+    }
+    void load(int xmm, int reg) { memory(0xf2, 0x10, xmm, reg); }
+    void store(int xmm, int reg) { memory(0xf2, 0x11, xmm, reg); }
+
+    // lea rdi or rsi (argument 0 or 1), [rbp + disp32] of a temporary
+    void addressOf(int argument, int reg) {
+        bytes({ 0x48, 0x8d, (unsigned char)(argument == 0 ? 0xbd : 0xb5) });
+        imm32(std::uint32_t(8 * (reg - firstTemporary)));
+    }
+
+    // mov rax, address then call rax
+    void call(const void *function) {
+        bytes({ 0x48, 0xb8 });
+        std::uint64_t address;
+        std::memcpy(&address, &function, sizeof(address));
+        imm64(address);
+        bytes({ 0xff, 0xd0 });
+    }
+
+    // movq xmm1, the bits of value
+    void constantInXmm1(double value) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        bytes({ 0x48, 0xb8 });
+        imm64(bits);
+        bytes({ 0x66, 0x48, 0x0f, 0x6e, 0xc8 });
+    }
+
+    // je to the failure exit, which is only placed at the end
+    void jumpToFailureIfEqual() {
+        bytes({ 0x0f, 0x84 });
+        failureFixups.push_back(code.size());
+        imm32(0);
+    }
+
+    std::vector<unsigned char> code;
+    std::vector<std::size_t> failureFixups;
+
+    struct ConstantFixup {
+        std::size_t position;
+        std::size_t constant;
+    };
+    std::vector<ConstantFixup> constantFixups;
+
+private:
+    std::size_t firstInput;
+    std::size_t firstTemporary;
+};
+
+static void patch32(std::vector<unsigned char> &code, std::size_t position, std::int64_t value) {
+    for(int i = 0; i < 4; i++)
+        code[position + i] = (unsigned char)(std::uint64_t(value) >> (8 * i));
+}
+
+// wrappers with a plain signature to call from the code, whatever the calling convention of the originals
+static bool nativePower(double *base, double exponent) {
+    return raisePower(*base, exponent);
+}
+
+static bool nativeFunction(unsigned function, double *value) {
+    return applyFunction(Function(function), *value);
+}
+
+// function is invoked to turn the instructions of a program into machine code
+bool NativeProgram::compile(const Program &program) {
+    release();
+    CodeWriter writer(program);
+
+    // push rbx; push rbp; push r13, which leaves the stack aligned for calls
+    writer.bytes({ 0x53, 0x55, 0x41, 0x55 });
+    // mov rbx, rdi; mov rbp, rsi; mov r13, rdx
+    writer.bytes({ 0x48, 0x89, 0xfb, 0x48, 0x89, 0xf5, 0x49, 0x89, 0xd5 });
+
+    // the program register whose value xmm0 still holds, so it is not loaded again
+    int inXmm0 = -1;
+    for(const Instruction &instruction : program.instructions()) {
+        int a = instruction.a;
+        int b = instruction.b;
+        int dest = instruction.dest;
+        switch(instruction.code) {
+        case OpCode::Add:
+        case OpCode::Subtract:
+        case OpCode::Multiply: {
+            unsigned char opcode = instruction.code == OpCode::Add ? 0x58
+                                   : instruction.code == OpCode::Subtract ? 0x5c : 0x59;
+            if(inXmm0 != a)
+                writer.load(0, a);
+            writer.memory(0xf2, opcode, 0, b);
+            break;
+        }
+        case OpCode::Divide:
+            // ucomisd of b and 0, jp over the je for NaN, which is not 0, then je to the failure
+            writer.load(1, b);
+            writer.bytes({ 0x66, 0x0f, 0x57, 0xd2, 0x66, 0x0f, 0x2e, 0xca, 0x7a, 0x06 });
+            writer.jumpToFailureIfEqual();
+            if(inXmm0 != a)
+                writer.load(0, a);
+            // divsd xmm0, xmm1
+            writer.bytes({ 0xf2, 0x0f, 0x5e, 0xc1 });
+            break;
+        case OpCode::Negate:
+            if(inXmm0 != a)
+                writer.load(0, a);
+            // xorpd xmm0, xmm1 with only the sign bit set in xmm1
+            writer.constantInXmm1(-0.0);
+            writer.bytes({ 0x66, 0x0f, 0x57, 0xc1 });
+            break;
+        case OpCode::Percent:
+            if(inXmm0 != a)
+                writer.load(0, a);
+            writer.constantInXmm1(100);
+            writer.bytes({ 0xf2, 0x0f, 0x5e, 0xc1 });
+            break;
+        case OpCode::Power:
+            // the base goes to dest first, raisePower() works on it there; b is read before, dest may be b
+            writer.load(1, a);
+            writer.load(0, b);
+            writer.store(1, dest);
+            writer.addressOf(0, dest);
+            writer.call(reinterpret_cast<const void *>(&nativePower));
+            // test al, al
+            writer.bytes({ 0x84, 0xc0 });
+            writer.jumpToFailureIfEqual();
+            inXmm0 = -1;
+            continue;
+        case OpCode::Function:
+            if(inXmm0 != a)
+                writer.load(0, a);
+            writer.store(0, dest);
+            // mov edi, function
+            writer.bytes({ 0xbf });
+            writer.imm32(std::uint32_t(instruction.function));
+            writer.addressOf(1, dest);
+            writer.call(reinterpret_cast<const void *>(&nativeFunction));
+            writer.bytes({ 0x84, 0xc0 });
+            writer.jumpToFailureIfEqual();
+            inXmm0 = -1;
+            continue;
+        }
+        writer.store(0, dest);
+        inXmm0 = dest;
+    }
+
+    // movsd xmm0, the result; movsd [r13], xmm0; mov eax, 1
+    if(inXmm0 != program.resultRegister())
+        writer.load(0, program.resultRegister());
+    writer.bytes({ 0xf2, 0x41, 0x0f, 0x11, 0x85 });
+    writer.imm32(0);
+    writer.bytes({ 0xb8 });
+    writer.imm32(1);
+    // pop r13; pop rbp; pop rbx; ret
+    writer.bytes({ 0x41, 0x5d, 0x5d, 0x5b, 0xc3 });
+
+    // the failure exit: xor eax, eax and the same epilogue
+    std::size_t failure = writer.code.size();
+    writer.bytes({ 0x31, 0xc0, 0x41, 0x5d, 0x5d, 0x5b, 0xc3 });
+    for(std::size_t position : writer.failureFixups)
+        patch32(writer.code, position, std::int64_t(failure) - std::int64_t(position + 4));
+
+    // the constants follow the code, aligned for their loads
+    while(writer.code.size() % sizeof(double))
+        writer.code.push_back(0xcc);
+    std::size_t constantsStart = writer.code.size();
+    const std::vector<double> &constants = program.constantList();
+    writer.code.resize(constantsStart + constants.size() * sizeof(double));
+    if(!constants.empty())
+        std::memcpy(&writer.code[constantsStart], constants.data(), constants.size() * sizeof(double));
+    for(const CodeWriter::ConstantFixup &fixup : writer.constantFixups)
+        patch32(writer.code, fixup.position,
+                std::int64_t(constantsStart + fixup.constant * sizeof(double)) - std::int64_t(fixup.position + 4));
+
+    // the code is written while the mapping is writable, and only runs once it is not any more
+    std::size_t pageSize = std::size_t(sysconf(_SC_PAGESIZE));
+    std::size_t size = (writer.code.size() + pageSize - 1) / pageSize * pageSize;
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(memory == MAP_FAILED)
+        return false;
+    std::memcpy(memory, writer.code.data(), writer.code.size());
+    if(mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return false;
+    }
+    mapping = memory;
+    mappingSize = size;
+    codeSize = writer.code.size();
+    entry = reinterpret_cast<Entry>(memory);
+    return true;
+}
+
+void NativeProgram::release() {
+    if(mapping)
+        munmap(mapping, mappingSize);
+    entry = nullptr;
+    mapping = nullptr;
+    mappingSize = 0;
+    codeSize = 0;
+}
+
+#else
+
+// function is invoked where there is no code generator, the program stays interpreted
+bool NativeProgram::compile(const Program &) {
+    return false;
+}
+
+void NativeProgram::release() {
+}
+
+#endif
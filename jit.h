@@ -0,0 +1,45 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstddef>
+
+class Program;
+
+/* a program compiled to machine code in a mapping of its own, which is
+writable while the code is written and only executable after. It is only
+ever compiled on x86-64 Linux; anywhere else compile() returns false and the
+program is interpreted as before */
+class NativeProgram
+{
+public:
+    NativeProgram();
+    ~NativeProgram();
+
+    NativeProgram(const NativeProgram &) = delete;
+    NativeProgram &operator=(const NativeProgram &) = delete;
+
+    // compiles program, returns false if this machine cannot run it natively or there is no memory for it
+    bool compile(const Program &program);
+    void release();
+    bool isCompiled() const { return entry != nullptr; }
+
+    /* runs the code exactly like Program::run(), with the inputs and room for
+    every temporary of the program, returns false if it divides by zero or a
+    function fails */
+    bool run(const double *inputValues, double *temporaries, double &value) const {
+        return entry(inputValues, temporaries, &value);
+    }
+
+    // how many bytes of code and constants were written
+    std::size_t size() const { return codeSize; }
+
+private:
+    typedef bool (*Entry)(const double *inputValues, double *temporaries, double *value);
+
+    Entry entry;
+    void *mapping;
+    std::size_t mappingSize;
+    std::size_t codeSize;
+};
+
+#endif // JIT_H
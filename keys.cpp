@@ -0,0 +1,150 @@
+#include "keys.h"
+#include <cstring>
+
+static const char *const keyNames[] = {
+    "0", "1", "2", "3", "4", "5", "6", "7", "8", "9",
+    ".", "neg", "bs", "c", "ac",
+    "+", "-", "*", "/", "=",
+    "(", ")", "%", "^",
+    "sqrt", "exp", "ln", "log", "sin", "cos", "tan", "asin", "acos", "atan", "gamma", "!"
+};
+
+static_assert(sizeof(keyNames) / sizeof(keyNames[0]) == std::size_t(Key::Count),
+              "every key needs a name in keyNames");
+static_assert(int(Key::Factorial) - int(Key::SquareRoot) == int(Function::Factorial) - int(Function::SquareRoot),
+              "the function keys are in the order of their functions");
+
+// the labels of the flip sign and backspace buttons, which a key log may use as well
+static const char FlipSignLabel[] = "\302\261";
+static const char BackspaceLabel[] = "\342\206\220";
+
+Key operatorKey(Operator op) {
+    switch(op) {
+    case Operator::Add: return Key::Add;
+    case Operator::Subtract: return Key::Subtract;
+    case Operator::Multiply: return Key::Multiply;
+    case Operator::Divide: return Key::Divide;
+    case Operator::Power: return Key::Power;
+    default: return Key::Count;
+    }
+}
+
+Operator keyOperator(Key key) {
+    switch(key) {
+    case Key::Add: return Operator::Add;
+    case Key::Subtract: return Operator::Subtract;
+    case Key::Multiply: return Operator::Multiply;
+    case Key::Divide: return Operator::Divide;
+    case Key::Power: return Operator::Power;
+    default: return Operator::None;
+    }
+}
+
+const char *keyName(Key key) {
+    return key < Key::Count ? keyNames[std::size_t(key)] : "";
+}
+
+static bool isLetter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// the function key whose button label starts text, for the labels that are not its name, like √ or sin⁻¹
+static Key readFunctionLabel(const char *text, std::size_t available, std::size_t &used) {
+    for(Key key = Key::SquareRoot; key <= Key::Factorial; key = Key(int(key) + 1)) {
+        const char *label = functionLabel(keyFunction(key));
+        std::size_t labelLength = std::strlen(label);
+        if(std::strcmp(label, keyNames[std::size_t(key)]) != 0 && labelLength <= available
+           && std::memcmp(label, text, labelLength) == 0) {
+            used = labelLength;
+            return key;
+        }
+    }
+    return Key::Count;
+}
+
+// function is invoked to read the keys of a recorded key sequence
+bool parseKeys(const char *text, std::size_t length, std::vector<Key> &keys, std::string *error) {
+    const char *p = text;
+    const char *end = text + length;
+    while(p != end) {
+        if(*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+            p++;
+            continue;
+        }
+
+        std::size_t available = std::size_t(end - p);
+        std::size_t used;
+        // a label like sin⁻¹ starts with a word that is the name of another key
+        Key labelled = readFunctionLabel(p, available, used);
+        if(labelled != Key::Count) {
+            keys.push_back(labelled);
+            p += used;
+            continue;
+        }
+
+        // the named keys are whole words, so that "ac" is never c after a
+        if(isLetter(*p)) {
+            const char *word = p;
+            while(p != end && isLetter(*p))
+                p++;
+            std::size_t wordLength = std::size_t(p - word);
+            bool found = false;
+            for(std::size_t i = std::size_t(Key::Point); i < std::size_t(Key::Count) && !found; i++) {
+                if(std::strlen(keyNames[i]) == wordLength && std::memcmp(keyNames[i], word, wordLength) == 0) {
+                    keys.push_back(Key(i));
+                    found = true;
+                }
+            }
+            if(!found) {
+                if(error)
+                    *error = "unknown key \"" + std::string(word, wordLength) + "\"";
+                return false;
+            }
+            continue;
+        }
+
+        Operator op = readOperator(p, available, used);
+        if(op != Operator::None) {
+            keys.push_back(operatorKey(op));
+            p += used;
+        } else if(*p >= '0' && *p <= '9') {
+            keys.push_back(digitKey(*p - '0'));
+            p++;
+        } else if(available >= 2 && std::memcmp(p, FlipSignLabel, 2) == 0) {
+            keys.push_back(Key::FlipSign);
+            p += 2;
+        } else if(available >= 3 && std::memcmp(p, BackspaceLabel, 3) == 0) {
+            keys.push_back(Key::Backspace);
+            p += 3;
+        } else {
+            Key key = Key::Count;
+            switch(*p) {
+            case '.': key = Key::Point; break;
+            case '=': key = Key::Equals; break;
+            case '(': key = Key::OpenBracket; break;
+            case ')': key = Key::CloseBracket; break;
+            case '%': key = Key::Percent; break;
+            case '!': key = Key::Factorial; break;
+            default: break;
+            }
+            if(key == Key::Count) {
+                if(error)
+                    *error = "unknown key at offset " + std::to_string(p - text);
+                return false;
+            }
+            keys.push_back(key);
+            p++;
+        }
+    }
+    return true;
+}
+
+std::string formatKeys(const Key *keys, std::size_t count) {
+    std::string text;
+    for(std::size_t i = 0; i < count; i++) {
+        if(i)
+            text.push_back(' ');
+        text += keyName(keys[i]);
+    }
+    return text;
+}
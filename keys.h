@@ -0,0 +1,70 @@
+#ifndef KEYS_H
+#define KEYS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "functions.h"
+#include "operators.h"
+
+/* every key on the calculator, the digits first so that Digit0 + n is the key
+of n, and the function keys last in the order of their functions */
+enum class Key : unsigned char {
+    Digit0, Digit1, Digit2, Digit3, Digit4, Digit5, Digit6, Digit7, Digit8, Digit9,
+    Point,
+    FlipSign,
+    Backspace,
+    Clear,
+    ClearAll,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Equals,
+    OpenBracket,
+    CloseBracket,
+    Percent,
+    Power,
+    SquareRoot,
+    Exponential,
+    NaturalLog,
+    Log10,
+    Sine,
+    Cosine,
+    Tangent,
+    ArcSine,
+    ArcCosine,
+    ArcTangent,
+    Gamma,
+    Factorial,
+    Count
+};
+
+inline Key digitKey(int digitValue) { return Key(int(Key::Digit0) + digitValue); }
+inline bool isDigitKey(Key key) { return key <= Key::Digit9; }
+inline int keyDigit(Key key) { return int(key) - int(Key::Digit0); }
+
+inline Key functionKey(Function function) {
+    return Key(int(Key::SquareRoot) + int(function) - int(Function::SquareRoot));
+}
+inline bool isFunctionKey(Key key) { return key >= Key::SquareRoot && key <= Key::Factorial; }
+inline Function keyFunction(Key key) {
+    return Function(int(key) - int(Key::SquareRoot) + int(Function::SquareRoot));
+}
+
+// the key of an operator button, and the operator of a key (None if it is not one)
+Key operatorKey(Operator op);
+Operator keyOperator(Key key);
+
+// the name of a key in a key log, like 7, +, neg, ac or sqrt
+const char *keyName(Key key);
+
+/* reads a key log, keys written by their names with or without spaces between
+them ("12+3=" or "1 2 + 3 ="). The button labels work too. Returns false and
+sets error if something in text is not a key */
+bool parseKeys(const char *text, std::size_t length, std::vector<Key> &keys, std::string *error = nullptr);
+
+// writes keys the way parseKeys reads them, separated by spaces
+std::string formatKeys(const Key *keys, std::size_t count);
+
+#endif // KEYS_H
@@ -0,0 +1,166 @@
+#include "latency.h"
+#include <chrono>
+#include <cstdio>
+
+static const char *const stageNames[] = {
+    "dispatch", "model", "display", "slot", "paint", "total"
+};
+
+static_assert(sizeof(stageNames) / sizeof(stageNames[0]) == std::size_t(LatencyStage::Count),
+              "every stage needs a name in stageNames");
+
+const char *latencyStageName(LatencyStage stage) {
+    return stageNames[std::size_t(stage)];
+}
+
+// the position of the highest set bit, value is never 0
+static unsigned highestBit(std::uint64_t value) {
+#if defined(__GNUC__)
+    return 63 - unsigned(__builtin_clzll(value));
+#else
+    unsigned bit = 0;
+    while(value >>= 1)
+        bit++;
+    return bit;
+#endif
+}
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+// the first eight buckets hold 0 to 7 exactly, after that every power of two has eight
+std::size_t LatencyHistogram::bucketOf(std::uint64_t nanoseconds) {
+    if(nanoseconds < SubBuckets)
+        return std::size_t(nanoseconds);
+    unsigned bit = highestBit(nanoseconds);
+    if(bit >= MaxBits)
+        return BucketCount - 1;
+    unsigned shift = bit - SubBucketBits;
+    std::size_t group = bit - SubBucketBits + 1;
+    return group * SubBuckets + std::size_t((nanoseconds >> shift) & (SubBuckets - 1));
+}
+
+// the largest duration that lands in a bucket
+std::uint64_t LatencyHistogram::bucketLimit(std::size_t bucket) {
+    std::size_t group = bucket / SubBuckets;
+    if(group == 0)
+        return bucket;
+    unsigned shift = unsigned(group - 1);
+    std::uint64_t lowest = std::uint64_t(SubBuckets + bucket % SubBuckets) << shift;
+    return lowest + (std::uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::uint64_t nanoseconds) {
+    buckets[bucketOf(nanoseconds)]++;
+    total++;
+    sum += nanoseconds;
+    if(nanoseconds > largest)
+        largest = nanoseconds;
+}
+
+void LatencyHistogram::reset() {
+    for(std::size_t i = 0; i < BucketCount; i++)
+        buckets[i] = 0;
+    total = 0;
+    sum = 0;
+    largest = 0;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+    for(std::size_t i = 0; i < BucketCount; i++)
+        buckets[i] += other.buckets[i];
+    total += other.total;
+    sum += other.sum;
+    if(other.largest > largest)
+        largest = other.largest;
+}
+
+std::uint64_t LatencyHistogram::percentile(double fraction) const {
+    if(!total)
+        return 0;
+    // the rank of the duration asked for, counting from 1
+    std::uint64_t rank = std::uint64_t(fraction * double(total) + 0.999999);
+    if(rank < 1)
+        rank = 1;
+    std::uint64_t seen = 0;
+    for(std::size_t i = 0; i < BucketCount; i++) {
+        seen += buckets[i];
+        if(seen >= rank) {
+            std::uint64_t limit = bucketLimit(i);
+            // the largest one is known exactly, no bucket needs to go above it
+            return limit < largest ? limit : largest;
+        }
+    }
+    return largest;
+}
+
+LatencyTracer::LatencyTracer()
+    : inputTime(0), slotTime(0), modelTime(0)
+{
+}
+
+std::uint64_t LatencyTracer::now() {
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void LatencyTracer::record(LatencyStage stage, std::uint64_t from, std::uint64_t to) {
+    histograms[std::size_t(stage)].record(to > from ? to - from : 0);
+}
+
+void LatencyTracer::inputEvent() {
+    inputTime = now();
+}
+
+void LatencyTracer::slotEntered() {
+    slotTime = now();
+    if(inputTime)
+        record(LatencyStage::Dispatch, inputTime, slotTime);
+}
+
+void LatencyTracer::modelUpdated() {
+    modelTime = now();
+    record(LatencyStage::Model, slotTime, modelTime);
+}
+
+void LatencyTracer::displayUpdated() {
+    std::uint64_t displayTime = now();
+    record(LatencyStage::Display, modelTime, displayTime);
+    record(LatencyStage::Slot, slotTime, displayTime);
+    unpainted.push_back({inputTime ? inputTime : slotTime, displayTime});
+    // the next slot without an input event of its own, like a replayed one, starts at the slot
+    inputTime = 0;
+}
+
+void LatencyTracer::painted() {
+    if(unpainted.empty())
+        return;
+    std::uint64_t paintTime = now();
+    for(const Unpainted &keystroke : unpainted) {
+        record(LatencyStage::Paint, keystroke.slotEnded, paintTime);
+        record(LatencyStage::Total, keystroke.started, paintTime);
+    }
+    unpainted.clear();
+}
+
+void LatencyTracer::reset() {
+    for(LatencyHistogram &histogram : histograms)
+        histogram.reset();
+    inputTime = 0;
+    unpainted.clear();
+}
+
+std::string LatencyTracer::report() const {
+    std::string text = "stage          count     p50 us     p90 us     p99 us     max us\n";
+    char line[128];
+    for(std::size_t i = 0; i < std::size_t(LatencyStage::Count); i++) {
+        const LatencyHistogram &histogram = histograms[i];
+        std::snprintf(line, sizeof(line), "%-8s %11llu %10.1f %10.1f %10.1f %10.1f\n",
+                      stageNames[i], (unsigned long long)histogram.count(),
+                      double(histogram.percentile(0.50)) / 1000, double(histogram.percentile(0.90)) / 1000,
+                      double(histogram.percentile(0.99)) / 1000, double(histogram.max()) / 1000);
+        text += line;
+    }
+    return text;
+}
@@ -0,0 +1,96 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* a histogram of durations in nanoseconds. Every power of two is split into
+eight buckets, so a percentile is never more than 12.5% above the real one,
+and recording is a few instructions with nothing allocated */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(std::uint64_t nanoseconds);
+    void reset();
+    // adds everything recorded in other
+    void merge(const LatencyHistogram &other);
+
+    std::uint64_t count() const { return total; }
+    std::uint64_t max() const { return largest; }
+    std::uint64_t mean() const { return total ? sum / total : 0; }
+    // the duration below which fraction (0 to 1) of all recorded ones are, rounded up to its bucket
+    std::uint64_t percentile(double fraction) const;
+
+    enum {
+        SubBucketBits = 3,
+        SubBuckets = 1 << SubBucketBits,
+        // 2^40 ns is about 18 minutes, anything longer lands in the last bucket
+        MaxBits = 40,
+        BucketCount = (MaxBits - SubBucketBits + 1) * SubBuckets
+    };
+
+private:
+    static std::size_t bucketOf(std::uint64_t nanoseconds);
+    static std::uint64_t bucketLimit(std::size_t bucket);
+
+    std::uint64_t buckets[BucketCount];
+    std::uint64_t total;
+    std::uint64_t sum;
+    std::uint64_t largest;
+};
+
+// the stages a keystroke goes through, from the input event to the repainted display
+enum class LatencyStage : unsigned char {
+    Dispatch,   // the input event until the slot runs
+    Model,      // the engine working out the new state
+    Display,    // handing the new text to the display
+    Slot,       // the whole slot, model and display together
+    Paint,      // the end of the slot until the display has painted it
+    Total,      // the input event (or the slot, without one) until the display has painted it
+    Count
+};
+
+const char *latencyStageName(LatencyStage stage);
+
+/* timestamps every keystroke through the window and keeps a histogram per
+stage. The calls come in the order of the stages; keystrokes that arrive
+before the display repainted all end with the same paint */
+class LatencyTracer
+{
+public:
+    LatencyTracer();
+
+    // an input event that is going to press a key arrived
+    void inputEvent();
+    // the slot of a key started, which starts the keystroke if no input event did
+    void slotEntered();
+    void modelUpdated();
+    // the display has its new text and the slot is done
+    void displayUpdated();
+    // the display has painted, which ends every keystroke waiting for it
+    void painted();
+
+    const LatencyHistogram &histogram(LatencyStage stage) const { return histograms[std::size_t(stage)]; }
+    void reset();
+
+    // one line per stage with its count and its p50, p90, p99 and max in microseconds
+    std::string report() const;
+
+private:
+    static std::uint64_t now();
+    void record(LatencyStage stage, std::uint64_t from, std::uint64_t to);
+
+    LatencyHistogram histograms[std::size_t(LatencyStage::Count)];
+    std::uint64_t inputTime;
+    std::uint64_t slotTime;
+    std::uint64_t modelTime;
+    // when each keystroke still waiting for the paint started, and when its slot ended
+    struct Unpainted { std::uint64_t started, slotEnded; };
+    std::vector<Unpainted> unpainted;
+};
+
+#endif // LATENCY_H
@@ -0,0 +1,210 @@
+#include "latency.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* calc-load keeps a number of connections to calc-server busy, each with a
+fixed number of expressions sent and not yet answered, and reports how many
+were answered per second and how long each one took from being sent until its
+answer arrived */
+
+// what is sent when no file of expressions is given
+static const char *const defaultRequests[] = {
+    "1 + 2",
+    "(1 + 2) * 3",
+    "50% / 4",
+    "0.1 + 0.2",
+    "12345.678 * 9.87 - 6 / 7",
+    "((2 + 3) * (4 - 1)) / 7",
+    "2 * (3 + 4 * (5 - 6 * (7 + 8)))",
+    "1 / 0"
+};
+
+// what one connection measured
+struct ConnectionResult {
+    LatencyHistogram latency;
+    std::uint64_t answered = 0;
+    bool ok = true;
+};
+
+static std::uint64_t now() {
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static int connectTo(const char *path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(std::strlen(path) >= sizeof(address.sun_path))
+        return -1;
+    std::strcpy(address.sun_path, path);
+
+    int socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if(socket < 0)
+        return -1;
+    if(::connect(socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        ::close(socket);
+        return -1;
+    }
+    return socket;
+}
+
+static bool sendAll(int socket, const char *data, std::size_t size) {
+    while(size > 0) {
+        ssize_t sent = ::send(socket, data, size, MSG_NOSIGNAL);
+        if(sent <= 0)
+            return false;
+        data += sent;
+        size -= std::size_t(sent);
+    }
+    return true;
+}
+
+/* sends count requests, starting at first, keeping depth of them unanswered.
+Everything that fits into the window goes out in one write, and the time it was
+sent is kept for every line until its answer arrives */
+static void runConnection(const char *path, const std::vector<std::string> *requests, std::size_t first,
+                          std::uint64_t count, unsigned depth, ConnectionResult *result) {
+    int socket = connectTo(path);
+    if(socket < 0) {
+        std::fprintf(stderr, "calc-load: cannot connect to %s\n", path);
+        result->ok = false;
+        return;
+    }
+
+    std::vector<std::uint64_t> sentAt(depth);
+    std::uint64_t sent = 0, answered = 0;
+    std::string output;
+    char input[1 << 16];
+
+    while(answered < count) {
+        output.clear();
+        std::uint64_t sendTime = now();
+        while(sent < count && sent - answered < depth) {
+            output += (*requests)[(first + sent) % requests->size()];
+            output.push_back('\n');
+            sentAt[sent % depth] = sendTime;
+            sent++;
+        }
+        if(!output.empty() && !sendAll(socket, output.data(), output.size())) {
+            result->ok = false;
+            break;
+        }
+
+        ssize_t got = ::recv(socket, input, sizeof(input), 0);
+        if(got <= 0) {
+            result->ok = false;
+            break;
+        }
+        std::uint64_t arrived = now();
+        for(const char *p = input; (p = static_cast<const char *>(std::memchr(p, '\n', std::size_t(input + got - p)))); p++) {
+            result->latency.record(arrived - sentAt[answered % depth]);
+            answered++;
+        }
+    }
+    result->answered = answered;
+    ::close(socket);
+}
+
+// reads the non-blank lines of a file
+static bool readRequests(const char *path, std::vector<std::string> &requests) {
+    std::ifstream file(path);
+    if(!file) {
+        std::fprintf(stderr, "calc-load: cannot read %s\n", path);
+        return false;
+    }
+    std::string line;
+    while(std::getline(file, line)) {
+        if(line.find_first_not_of(" \t\r") != std::string::npos)
+            requests.push_back(line);
+    }
+    if(requests.empty()) {
+        std::fprintf(stderr, "calc-load: %s has no expressions\n", path);
+        return false;
+    }
+    return true;
+}
+
+static void usage() {
+    std::fprintf(stderr, "usage: calc-load [-c connections] [-d depth] [-n requests] [-f file] socket\n"
+                         "sends requests to calc-server over that many connections, each keeping\n"
+                         "depth of them unanswered, then prints the throughput and the latencies\n");
+}
+
+// measures how much a running calc-server answers and how fast
+int main(int argc, char *argv[]) {
+    unsigned connections = 4;
+    unsigned depth = 32;
+    std::uint64_t total = 1000000;
+    const char *requestPath = nullptr;
+    const char *path = nullptr;
+
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            connections = unsigned(std::atoi(argv[++i]));
+        } else if(std::strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            depth = unsigned(std::atoi(argv[++i]));
+        } else if(std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            total = std::strtoull(argv[++i], nullptr, 10);
+        } else if(std::strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            requestPath = argv[++i];
+        } else if(argv[i][0] == '-' || path) {
+            usage();
+            return 2;
+        } else {
+            path = argv[i];
+        }
+    }
+    if(!path || connections == 0 || depth == 0) {
+        usage();
+        return 2;
+    }
+
+    std::vector<std::string> requests;
+    if(requestPath) {
+        if(!readRequests(requestPath, requests))
+            return 1;
+    } else {
+        requests.assign(std::begin(defaultRequests), std::end(defaultRequests));
+    }
+
+    // the requests are shared out evenly, every connection starting at a different line
+    std::vector<ConnectionResult> results(connections);
+    std::vector<std::thread> threads;
+    std::uint64_t started = now();
+    for(unsigned i = 0; i < connections; i++) {
+        std::uint64_t count = total / connections + (i < total % connections ? 1 : 0);
+        threads.emplace_back(runConnection, path, &requests, std::size_t(i), count, depth, &results[i]);
+    }
+    for(std::thread &thread : threads)
+        thread.join();
+    double seconds = double(now() - started) / 1e9;
+
+    LatencyHistogram latency;
+    std::uint64_t answered = 0;
+    bool ok = true;
+    for(const ConnectionResult &result : results) {
+        latency.merge(result.latency);
+        answered += result.answered;
+        ok &= result.ok;
+    }
+
+    std::printf("%llu requests over %u connections, %u deep, in %.3f s: %.0f requests/s\n",
+                (unsigned long long)answered, connections, depth, seconds,
+                seconds > 0 ? double(answered) / seconds : 0.0);
+    std::printf("latency us     p50      p90      p99    p99.9      max\n");
+    std::printf("         %8.1f %8.1f %8.1f %8.1f %8.1f\n",
+                double(latency.percentile(0.50)) / 1000, double(latency.percentile(0.90)) / 1000,
+                double(latency.percentile(0.99)) / 1000, double(latency.percentile(0.999)) / 1000,
+                double(latency.max()) / 1000);
+    return ok ? 0 : 1;
+}
@@ -1,10 +1,127 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStandardPaths>
+#include <cstdio>
+#include <vector>
+#include "latency.h"
 #include "mainwindow.h"
 
+// writes the latency report to a file, or to standard output without one
+static bool writeReport(const LatencyTracer &tracer, const QString &path) {
+    std::string report = tracer.report();
+    if(path.isEmpty()) {
+        std::fwrite(report.data(), 1, report.size(), stdout);
+        return true;
+    }
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    return file.write(report.data(), qint64(report.size())) == qint64(report.size());
+}
+
+// reads a key log, see parseKeys() for how it is written
+static bool readKeys(const QString &path, std::vector<Key> &keys) {
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        std::fprintf(stderr, "calc: cannot read %s\n", qPrintable(path));
+        return false;
+    }
+    QByteArray text = file.readAll();
+    std::string error;
+    if(!parseKeys(text.constData(), std::size_t(text.size()), keys, &error)) {
+        std::fprintf(stderr, "calc: %s: %s\n", qPrintable(path), error.c_str());
+        return false;
+    }
+    return true;
+}
+
 // spawn in a window
 int main (int argc, char *argv[]) {
+    // a replay needs no screen, unless a platform was asked for
+    bool replaying = false;
+    for(int i = 1; i < argc; i++)
+        replaying |= qstrcmp(argv[i], "--replay") == 0;
+    if(replaying && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
     QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption replayOption("replay", "Press the keys of a key log through the window as fast as it goes, then print the latencies.", "keys");
+    QCommandLineOption repeatOption("repeat", "Replay the key log this many times.", "count", "1");
+    QCommandLineOption recordOption("record", "Write every key pressed to a key log.", "keys");
+    QCommandLineOption latencyOption("latency", "Time every keystroke and write the latencies to this file when done.", "file");
+    QCommandLineOption historyOption("history", "Keep the history on this tape instead of the one in the application data folder.", "tape");
+    parser.addOptions({replayOption, repeatOption, recordOption, latencyOption, historyOption});
+    parser.process(app);
+
     MainWindow calc;
     calc.show();
-    return app.exec();
+
+    // a replay leaves the usual history alone, unless it was given a tape
+    QString historyPath = parser.value(historyOption);
+    if(historyPath.isEmpty() && !replaying) {
+        QString folder = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        if(!folder.isEmpty() && QDir().mkpath(folder))
+            historyPath = folder + "/history.tape";
+    }
+    if(!historyPath.isEmpty() && !calc.openHistory(historyPath))
+        std::fprintf(stderr, "calc: cannot open the history %s\n", qPrintable(historyPath));
+
+    LatencyTracer tracer;
+    if(replaying || parser.isSet(latencyOption))
+        calc.setLatencyTracer(&tracer);
+
+    // every key pressed goes to the key log as soon as it is pressed
+    QFile record;
+    if(parser.isSet(recordOption)) {
+        record.setFileName(parser.value(recordOption));
+        if(!record.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            std::fprintf(stderr, "calc: cannot write %s\n", qPrintable(record.fileName()));
+            return 1;
+        }
+        QObject::connect(&calc, &MainWindow::keyPressed, &calc, [&record](Key key) {
+            record.write(keyName(key));
+            record.write("\n");
+        });
+    }
+
+    if(replaying) {
+        std::vector<Key> keys;
+        if(!readKeys(parser.value(replayOption), keys))
+            return 1;
+        int repeat = parser.value(repeatOption).toInt();
+
+        // the pending repaint of every key is done before the next one is pressed
+        QElapsedTimer timer;
+        timer.start();
+        for(int i = 0; i < repeat; i++) {
+            for(Key key : keys) {
+                calc.replayKey(key);
+                app.processEvents();
+            }
+        }
+        double seconds = double(timer.nsecsElapsed()) / 1e9;
+
+        std::size_t pressed = keys.size() * std::size_t(repeat > 0 ? repeat : 0);
+        std::fprintf(stderr, "calc: replayed %zu keys in %.3f s (%.0f keys/s), display shows %s\n",
+                     pressed, seconds, seconds > 0 ? double(pressed) / seconds : 0.0,
+                     qPrintable(calc.displayText()));
+        if(!writeReport(tracer, parser.value(latencyOption))) {
+            std::fprintf(stderr, "calc: cannot write %s\n", qPrintable(parser.value(latencyOption)));
+            return 1;
+        }
+        return 0;
+    }
+
+    int result = app.exec();
+    if(parser.isSet(latencyOption) && !writeReport(tracer, parser.value(latencyOption))) {
+        std::fprintf(stderr, "calc: cannot write %s\n", qPrintable(parser.value(latencyOption)));
+        return 1;
+    }
+    return result;
 }
@@ -1,27 +1,47 @@
 #include "mainwindow.h"
 #include "button.h" // this is responsible for easing the creation of buttons
+#include "display.h"
+#include "historymodel.h"
+#include "latency.h"
+#include "numcodec.h"
+#include <QBoxLayout>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QEvent>
 #include <QGridLayout>
+#include <QLabel>
 #include <QLineEdit>
+#include <QListView>
+#include <QSpinBox>
 #include <QtMath>
+#include <cstring>
 
 MainWindow::MainWindow(QWidget *parent)
-    : QWidget(parent), sumSoFar(0)
-    , factorSoFar(0), waitingForOperand(true)
+    : QWidget(parent)
 {
-    // create the display, set it to read-only and set its maximum length to 15 characters
-    display = new QLineEdit("0");
+    // create the display, set it to read-only and set its maximum length to what the engine shows
+    shownText = engine.display();
+    display = new Display(QString::fromStdString(shownText));
     display->setReadOnly(true);
     display->setAlignment(Qt::AlignRight);
-    display->setMaxLength(15);
+    display->setMaxLength(Engine::MaxDisplayLength);
 
     // grab the font of the display, increase its size by 8 pixels and re-import it back
     QFont font = display->font();
     font.setPointSize(font.pointSize() + 8);
     display->setFont(font);
 
+    // create the line under the display that shows the running result while an entry is typed
+    previewLabel = new QLabel;
+    previewLabel->setAlignment(Qt::AlignRight);
+    previewLabel->setEnabled(false);
+
     // create the buttons for the digits and attach them to the digitClicked function
-    for(int i = 0; i < NumDigitButtons; i++)
-        digitButtons[i] = createButton(QString::number(i), &MainWindow::digitClicked);
+    for(int i = 0; i < NumDigitButtons; i++) {
+        digitButtons[i] = new Button(QString::number(i));
+        // the digit is bound here once, so that a click never has to read it back from the label
+        connect(digitButtons[i], &Button::clicked, this, [this, i] { digitClicked(i); });
+    }
 
     // create and attach the buttons for the decimal point and to reverse the number
     Button *decimalButton = createButton(tr("."), &MainWindow::pointClicked);
@@ -33,20 +53,93 @@ MainWindow::MainWindow(QWidget *parent)
     Button *clearAllButton = createButton(tr("AC"), &MainWindow::clearAll);
 
     // create and attach the buttons for the operations (plus, minus, multiply and divide)
-    Button *divButton = createButton(tr("\303\267"), &MainWindow::multDivClicked);
-    Button *multButton = createButton(tr("\303\227"), &MainWindow::multDivClicked);
-    Button *minusButton = createButton(tr("-"), &MainWindow::plusMinusClicked);
-    Button *plusButton = createButton(tr("+"), &MainWindow::plusMinusClicked);
+    Button *divButton = createButton(Operator::Divide, &MainWindow::multDivClicked);
+    Button *multButton = createButton(Operator::Multiply, &MainWindow::multDivClicked);
+    Button *minusButton = createButton(Operator::Subtract, &MainWindow::plusMinusClicked);
+    Button *plusButton = createButton(Operator::Add, &MainWindow::plusMinusClicked);
+
+    // create and attach the buttons for the brackets and percent
+    Button *openBracketButton = createButton(tr("("), &MainWindow::openBracketClicked);
+    Button *closeBracketButton = createButton(tr(")"), &MainWindow::closeBracketClicked);
+    Button *percentButton = createButton(tr("%"), &MainWindow::percentClicked);
 
     // create and attach the equals button
     Button *equalsButton = createButton(tr("="), &MainWindow::equalsClicked);
 
+    // create and attach the power button
+    Button *powerButton = createButton(Operator::Power, &MainWindow::powerClicked);
+
+    // create the buttons for the functions, each bound to its key once like the digits
+    for(int i = 0; i < NumFunctionButtons; i++) {
+        Function function = Function(int(Function::SquareRoot) + i);
+        functionButtons[i] = new Button(QString::fromUtf8(functionLabel(function)));
+        connect(functionButtons[i], &Button::clicked, this, [this, function] { press(functionKey(function)); });
+    }
+
+    // remember the button of every key, for replaying keys through their slots
+    for(int i = 0; i < NumDigitButtons; i++)
+        keyButtons[std::size_t(digitKey(i))] = digitButtons[i];
+    keyButtons[std::size_t(Key::Point)] = decimalButton;
+    keyButtons[std::size_t(Key::FlipSign)] = flipSignButton;
+    keyButtons[std::size_t(Key::Backspace)] = backspaceButton;
+    keyButtons[std::size_t(Key::Clear)] = clearButton;
+    keyButtons[std::size_t(Key::ClearAll)] = clearAllButton;
+    keyButtons[std::size_t(Key::Add)] = plusButton;
+    keyButtons[std::size_t(Key::Subtract)] = minusButton;
+    keyButtons[std::size_t(Key::Multiply)] = multButton;
+    keyButtons[std::size_t(Key::Divide)] = divButton;
+    keyButtons[std::size_t(Key::Equals)] = equalsButton;
+    keyButtons[std::size_t(Key::OpenBracket)] = openBracketButton;
+    keyButtons[std::size_t(Key::CloseBracket)] = closeBracketButton;
+    keyButtons[std::size_t(Key::Percent)] = percentButton;
+    keyButtons[std::size_t(Key::Power)] = powerButton;
+    for(int i = 0; i < NumFunctionButtons; i++)
+        keyButtons[std::size_t(functionKey(Function(int(Function::SquareRoot) + i)))] = functionButtons[i];
+
+    // create the choice between double numbers, decimals and exact fractions, and the digits decimals are rounded to
+    numberModeBox = new QComboBox;
+    numberModeBox->addItem(tr("Double"), int(NumberMode::Double));
+    numberModeBox->addItem(tr("Decimal"), int(NumberMode::Decimal));
+    numberModeBox->addItem(tr("Exact"), int(NumberMode::Rational));
+    // fractions are what the calculator starts with, they keep 1 ÷ 3 × 3 at 1
+    numberModeBox->setCurrentIndex(numberModeBox->findData(int(NumberMode::Rational)));
+    engine.setNumberMode(NumberMode::Rational);
+    display->setMaxLength(int(engine.maxDisplayLength()));
+    precisionBox = new QSpinBox;
+    precisionBox->setRange(0, 1000);
+    precisionBox->setSpecialValueText(tr("Exact"));
+    precisionBox->setSuffix(tr(" digits"));
+    precisionBox->setEnabled(false);
+    connect(numberModeBox, &QComboBox::currentIndexChanged, this, &MainWindow::numberModeChanged);
+    connect(precisionBox, &QSpinBox::valueChanged, this, &MainWindow::numberModeChanged);
+
+    // create the switch for the live preview, which is on to begin with
+    previewBox = new QCheckBox(tr("Live preview"));
+    previewBox->setChecked(true);
+    connect(previewBox, &QCheckBox::toggled, this, &MainWindow::previewToggled);
+
+    // create the history list with its search line, which only ever reads the rows it shows
+    historyModel = new HistoryModel(&history, this);
+    historySearch = new QLineEdit;
+    historySearch->setPlaceholderText(tr("Search by result or start of entry"));
+    historySearch->setClearButtonEnabled(true);
+    historyView = new QListView;
+    historyView->setUniformItemSizes(true);
+    historyView->setModel(historyModel);
+    historyView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    connect(historySearch, &QLineEdit::textChanged, this, &MainWindow::historySearchChanged);
+    connect(historyView, &QListView::clicked, this, &MainWindow::historyClicked);
+
     // create the layout grid for the calculator and set its size to a fixed one
     QGridLayout *mainLayout = new QGridLayout;
     mainLayout->setSizeConstraint(QLayout::SetFixedSize);
 
-    // add the display and backspace/clear keys to the grid
-    mainLayout->addWidget(display, 0, 0, 1, 6);
+    // add the display with the preview under it and backspace/clear keys to the grid
+    QVBoxLayout *displayLayout = new QVBoxLayout;
+    displayLayout->setSpacing(0);
+    displayLayout->addWidget(display);
+    displayLayout->addWidget(previewLabel);
+    mainLayout->addLayout(displayLayout, 0, 0, 1, 6);
     mainLayout->addWidget(backspaceButton, 1, 0, 1, 2);
     mainLayout->addWidget(clearButton, 1, 2, 1, 2);
     mainLayout->addWidget(clearAllButton, 1, 4, 1, 2);
@@ -69,8 +162,41 @@ MainWindow::MainWindow(QWidget *parent)
     mainLayout->addWidget(minusButton, 4, 4);
     mainLayout->addWidget(plusButton, 5, 4);
 
-    // add the equals key to the grid and set the layout to said grid
+    // add the bracket and percent keys to the grid, above the equals key
+    mainLayout->addWidget(openBracketButton, 2, 5);
+    mainLayout->addWidget(closeBracketButton, 3, 5);
+    mainLayout->addWidget(percentButton, 4, 5);
+
+    // add the equals key to the grid
     mainLayout->addWidget(equalsButton, 5, 5);
+
+    // add the power, square root, factorial and gamma keys to the grid, left of the digits
+    mainLayout->addWidget(powerButton, 2, 0);
+    mainLayout->addWidget(functionButton(Function::SquareRoot), 3, 0);
+    mainLayout->addWidget(functionButton(Function::Factorial), 4, 0);
+    mainLayout->addWidget(functionButton(Function::Gamma), 5, 0);
+
+    // add the exponential, log and trigonometric keys below the digits, with the inverse ones under their own
+    mainLayout->addWidget(functionButton(Function::Exponential), 6, 0);
+    mainLayout->addWidget(functionButton(Function::NaturalLog), 6, 1);
+    mainLayout->addWidget(functionButton(Function::Log10), 6, 2);
+    mainLayout->addWidget(functionButton(Function::Sine), 6, 3);
+    mainLayout->addWidget(functionButton(Function::Cosine), 6, 4);
+    mainLayout->addWidget(functionButton(Function::Tangent), 6, 5);
+    mainLayout->addWidget(functionButton(Function::ArcSine), 7, 3);
+    mainLayout->addWidget(functionButton(Function::ArcCosine), 7, 4);
+    mainLayout->addWidget(functionButton(Function::ArcTangent), 7, 5);
+
+    // add the number mode, its precision and the preview switch below the keys and set the layout to said grid
+    mainLayout->addWidget(numberModeBox, 8, 0, 1, 2);
+    mainLayout->addWidget(precisionBox, 8, 2, 1, 2);
+    mainLayout->addWidget(previewBox, 8, 4, 1, 2);
+
+    // add the history beside everything else
+    QVBoxLayout *historyLayout = new QVBoxLayout;
+    historyLayout->addWidget(historySearch);
+    historyLayout->addWidget(historyView);
+    mainLayout->addLayout(historyLayout, 0, 6, 9, 1);
     setLayout(mainLayout);
 
     // set the window title to "Calculator"
@@ -78,209 +204,97 @@ MainWindow::MainWindow(QWidget *parent)
 }
 
 // function is invoked if a digit is clicked
-void MainWindow::digitClicked() {
-    // create clickedButton to read the digit of the button pressed
-    Button *clickedButton = qobject_cast<Button *>(sender());
-    // read the digit of the button pressed
-    int digitValue = clickedButton->text().toInt();
-
-    // if the button pressed is 0, and 0 is currently replaced, return nothing
-    if(display->text() == "0" && digitValue == 0)
-        return;
-
-    // if waiting for an operation, clear the display and set waitingForOperand to false
-    if(waitingForOperand) {
-        display->clear();
-        waitingForOperand = false;
-    }
-
-    // set the display to what's displayed there, plus the digit pressed
-    display->setText(display->text() + QString::number(digitValue));
+void MainWindow::digitClicked(int digitValue) {
+    press(digitKey(digitValue));
 }
 
 // function is invoked if either plus or minus are pressed
 void MainWindow::plusMinusClicked() {
-    // create clickedButton to read the symbol of the button pressed
+    // create clickedButton to read the operator of the button pressed
     Button *clickedButton = qobject_cast<Button *>(sender());
     // if clickedButton is false, return nothing
     if(!clickedButton)
         return;
-    // read the symbol of the button pressed and the current value displayed
-    QString clickedOperator = clickedButton->text();
-    double operand = display->text().toDouble();
-
-    /* if pendingMultOp isn't empty and there are no calculations happenning
-    between the displayed value and pendingMultOp, abort the operation and
-    return nothing */
-    if(!pendingMultOp.isEmpty()) {
-        if(!calculate(operand, pendingMultOp)) {
-            abortOperation();
-            return;
-        }
-        // display the current factor, clear factorSoFar and pendingMultOp
-        display->setText(QString::number(factorSoFar));
-        operand = factorSoFar;
-        factorSoFar = 0;
-        pendingMultOp.clear();
-    }
-
-    /* if pendingAddOp isn't empty and there are no calculations happenning
-    between the displayed value and pendingAddOp, abort the operation and
-    return nothing */
-    if(!pendingAddOp.isEmpty()) {
-        if(!calculate(operand, pendingAddOp)) {
-            abortOperation();
-            return;
-        }
-        // display the current sum
-        display->setText(QString::number(sumSoFar));
-    } else {
-        // the sum is now equal to the displayed value
-        sumSoFar = operand;
-    }
-
-    // pendingAddOp is now equal to the operator clicked and waitingForOperand is set to true
-    pendingAddOp = clickedOperator;
-    waitingForOperand = true;
+    // pass the operator of the button pressed on to the engine
+    press(operatorKey(clickedButton->buttonOperator()));
 }
 
 // function is invoked if either multiply or divide are pressed
 void MainWindow::multDivClicked() {
-    // create clickedButton to read the symbol of the button pressed
+    // create clickedButton to read the operator of the button pressed
     Button *clickedButton = qobject_cast<Button *>(sender());
     // if clickedButton is false, return nothing
     if(!clickedButton)
         return;
-    // read the symbol of the button pressed and the current value displayed
-    QString clickedOperator = clickedButton->text();
-    double operand = display->text().toDouble();
-
-    /* if pendingMultOp isn't empty and there are no calculations happenning
-    between the displayed value and pendingMultOp, abort the operation and
-    return nothing */
-    if(!pendingMultOp.isEmpty()) {
-        if(!calculate(operand, pendingMultOp)) {
-            abortOperation();
-            return;
-        }
-        // display the current factor
-        display->setText(QString::number(factorSoFar));
-    } else {
-        // the factor is now equal to the displayed value
-        factorSoFar = operand;
-    }
-
-    // pendingMultOp is now equal to the operator clicked and waitingForOperand is set to true
-    pendingMultOp = clickedOperator;
-    waitingForOperand = true;
+    // pass the operator of the button pressed on to the engine
+    press(operatorKey(clickedButton->buttonOperator()));
 }
 
 // function is invoked if equals is pressed
 void MainWindow::equalsClicked() {
-    // read the current value displayed
-    double operand = display->text().toDouble();
-
-    /* if pendingMultOp isn't empty and there are no calculations happenning
-    between the displayed value and pendingMultOp, abort the operation and
-    return nothing */
-    if(!pendingMultOp.isEmpty()) {
-        if(!calculate(operand, pendingMultOp)) {
-            abortOperation();
-            return;
-        }
-        // clear factorSoFar and pendingMultOp
-        operand = factorSoFar;
-        factorSoFar = 0;
-        pendingMultOp.clear();
-    }
-    /* if pendingAddOp isn't empty and there are no calculations happenning
-    between the displayed value and pendingAddOp, abort the operation and
-    return nothing */
-    if(!pendingAddOp.isEmpty()) {
-        if(!calculate(operand, pendingAddOp)) {
-            abortOperation();
-            return;
-        }
-        // clear pendingAddOp
-        pendingAddOp.clear();
-    } else {
-        // the sum is now equal to the displayed value
-        sumSoFar = operand;
-    }
+    press(Key::Equals);
+}
 
-    // display the current sum, clear sumSoFar and set waitingForOperand to true
-    display->setText(QString::number(sumSoFar));
-    sumSoFar = 0;
-    waitingForOperand = true;
+// function invoked if the power button is pressed
+void MainWindow::powerClicked() {
+    press(Key::Power);
 }
 
 // function invoked if the point button is pressed
 void MainWindow::pointClicked() {
-    // if waitingForOperand is true, display 0
-    if(waitingForOperand)
-        display->setText("0");
-    // if there is currently no point displayed, display a point after whatever was on screen
-    if(!display->text().contains("."))
-        display->setText(display->text() + tr("."));
-    // set waitingForOperand to false
-    waitingForOperand = false;
+    press(Key::Point);
 }
 
 // function invoked if the flip sign button is pressed
 void MainWindow::flipSignClicked() {
-    // read the current value displayed
-    QString text = display->text();
-    double value = text.toDouble();
-
-    // if the value displayed is above 0, put a dash befor anything else, otherwise remove it
-    if(value > 0) {
-        text.prepend(tr("-"));
-    } else if(value < 0) {
-        text.remove(0, 1);
-    }
-    // display resulting value
-    display->setText(text);
+    press(Key::FlipSign);
 }
 
 // function invoked if the backspace button is pressed
 void MainWindow::backspaceClicked() {
-    // if waitingForOperand is true, return nothing
-    if(waitingForOperand)
-        return;
+    press(Key::Backspace);
+}
 
-    // read the current value displayed
-    QString text = display->text();
-    // remove the last digit
-    text.chop(1);
-    // if the value string is now empty,change it to 0 and set waitingForOperand to true
-    if(text.isEmpty()) {
-        text = "0";
-        waitingForOperand = true;
-    }
-    // display resulting value
-    display->setText(text);
+// function invoked if the opening bracket button is pressed
+void MainWindow::openBracketClicked() {
+    press(Key::OpenBracket);
+}
+
+// function invoked if the closing bracket button is pressed
+void MainWindow::closeBracketClicked() {
+    press(Key::CloseBracket);
+}
+
+// function invoked if the percent button is pressed
+void MainWindow::percentClicked() {
+    press(Key::Percent);
 }
 
 // function is invoked if the clear button is pressed
 void MainWindow::clear() {
-    // if waitingForOperand is true, return nothing
-    if(waitingForOperand)
-        return;
-
-    // set displayed value to 0 and set waitingForOperand to true
-    display->setText("0");
-    waitingForOperand = true;
+    press(Key::Clear);
 }
 
 // function is invoked if the clear all button is pressed
 void MainWindow::clearAll() {
-    // reset all values, set displayed value to 0 and waitingForOperand to true
-    sumSoFar = 0;
-    factorSoFar = 0;
-    pendingAddOp.clear();
-    pendingMultOp.clear();
-    display->setText("0");
-    waitingForOperand = true;
+    press(Key::ClearAll);
+}
+
+// function is invoked if the number mode or its precision is changed
+void MainWindow::numberModeChanged() {
+    NumberMode mode = NumberMode(numberModeBox->currentData().toInt());
+    // the precision only means something for decimals
+    precisionBox->setEnabled(mode == NumberMode::Decimal);
+    // switching starts the calculation over, and decimals get a longer display
+    engine.setNumberMode(mode, std::size_t(precisionBox->value()));
+    display->setMaxLength(int(engine.maxDisplayLength()));
+    updateDisplay();
+}
+
+// function is invoked if the live preview is switched on or off
+void MainWindow::previewToggled() {
+    previewLabel->setVisible(previewBox->isChecked());
+    updateDisplay();
 }
 
 // function is invoked when creating a button using a pointer to a function
@@ -294,30 +308,121 @@ Button *MainWindow::createButton(const QString &text, const PointerToMemberFunct
     return button;
 }
 
-// function is invoked when an abort to an operation is needed
-void MainWindow::abortOperation() {
-    // run a clearAll and set the displayed value to 4 hashes
-    clearAll();
-    display->setText(tr("####"));
+// function is invoked when creating an operator button, the operator is resolved here once
+template<typename PointerToMemberFunction>
+Button *MainWindow::createButton(Operator op, const PointerToMemberFunction &member) {
+    /* the label is the symbol of the operator, translated like any other label.
+    The symbols are written out here for lupdate to find, in the order of
+    Operator, and they have to be the ones the engine writes into the entry */
+    static const char *const operatorLabels[] = {
+        "", QT_TR_NOOP("+"), QT_TR_NOOP("-"), QT_TR_NOOP("\303\227"), QT_TR_NOOP("\303\267"), QT_TR_NOOP("^")
+    };
+    static_assert(sizeof(operatorLabels) / sizeof(operatorLabels[0]) == std::size_t(Operator::Count),
+                  "every operator needs a label in operatorLabels");
+    Q_ASSERT(std::strcmp(operatorLabels[std::size_t(op)], operatorSymbol(op)) == 0);
+    Button *button = createButton(tr(operatorLabels[std::size_t(op)]), member);
+    // remember the operator itself so that pressing the button never compares strings
+    button->setButtonOperator(op);
+    return button;
 }
 
-// function is invoked to run an operation (contains the right value in an equation and the operator used)
-bool MainWindow::calculate(double rightOperand, const QString &pendingOperator) {
-    // if the operator is +, add the right value to sumSoFar
-    if(pendingOperator == tr("+")) {
-        sumSoFar += rightOperand;
-    // if the operator is -, subtract the right value from sumSoFar
-    } else if(pendingOperator == tr("-")) {
-        sumSoFar -= rightOperand;
-    // if the operator is the multiply sign, multiply factorSoFar by the right value
-    } else if(pendingOperator == tr("\303\227")) {
-        factorSoFar *= rightOperand;
-    // if the operator is the division sign, divide factorSoFar by the right value (unless the right value is 0, then return false)
-    } else if(pendingOperator == tr("\303\267")) {
-        if(rightOperand == 0)
-            return false;
-        factorSoFar /= rightOperand;
+// function is invoked to show whatever the engine currently displays, returns false if it was shown already
+bool MainWindow::updateDisplay() {
+    // the preview comes from the running results of the engine, it never evaluates the whole entry again
+    std::string preview = previewBox->isChecked() ? engine.preview() : std::string();
+    if(preview != shownPreview) {
+        shownPreview = preview;
+        previewLabel->setText(preview.empty() ? QString() : tr("= %1").arg(QString::fromStdString(preview)));
     }
-    // return true if calculation is successful
+
+    const std::string &text = engine.display();
+    if(text == shownText)
+        return false;
+    shownText = text;
+    display->setText(QString::fromStdString(text));
     return true;
 }
+
+// function is invoked by every key slot, timing the engine and the display if a tracer is set
+void MainWindow::press(Key key) {
+    if(tracer)
+        tracer->slotEntered();
+    emit keyPressed(key);
+    unsigned long finishedBefore = engine.finishedCount();
+    engine.press(key);
+    if(engine.finishedCount() != finishedBefore)
+        recordEntry();
+    if(tracer)
+        tracer->modelUpdated();
+    bool changed = updateDisplay();
+    if(tracer) {
+        tracer->displayUpdated();
+        // nothing is going to be painted for a key that left the display as it was
+        if(!changed)
+            tracer->painted();
+    }
+}
+
+// function is invoked when equals finished an entry, or dividing by zero did
+void MainWindow::recordEntry() {
+    const std::string &result = engine.finishedResult();
+    double value;
+    const char *end = result.data() + result.size();
+    if(result.empty() || parseDouble(result.data(), end, value) != end)
+        value = qQNaN();
+    historyModel->append(engine.finishedEntry(), result, value, engine.numberMode());
+}
+
+// function is invoked to open the history tape, whose entries show right away however many there are
+bool MainWindow::openHistory(const QString &path) {
+    bool opened = history.open(path.toStdString());
+    historyModel->setSearch(historySearch->text());
+    return opened;
+}
+
+// function is invoked if an entry of the history is clicked, bringing it back as it was before equals
+void MainWindow::historyClicked(const QModelIndex &index) {
+    if(!index.isValid())
+        return;
+    HistoryEntry item = history.entry(historyModel->entryIndex(index.row()));
+    engine.replay(item.expression, item.expressionLength);
+    updateDisplay();
+}
+
+// function is invoked if the search of the history is changed
+void MainWindow::historySearchChanged(const QString &text) {
+    historyModel->setSearch(text);
+}
+
+// function is invoked to start or stop timing keystrokes
+void MainWindow::setLatencyTracer(LatencyTracer *latencyTracer) {
+    tracer = latencyTracer;
+    display->setLatencyTracer(tracer);
+    // the buttons tell when their input event arrives, before the click reaches a slot
+    for(Button *button : keyButtons) {
+        if(tracer)
+            button->installEventFilter(this);
+        else
+            button->removeEventFilter(this);
+    }
+}
+
+// function is invoked for every event of a button while keystrokes are timed
+bool MainWindow::eventFilter(QObject *watched, QEvent *event) {
+    // a release only clicks a button that is still down, one dragged off it is not a keystroke
+    bool release = event->type() == QEvent::MouseButtonRelease || event->type() == QEvent::KeyRelease;
+    Button *button = qobject_cast<Button *>(watched);
+    if(tracer && release && button && button->isDown())
+        tracer->inputEvent();
+    return QWidget::eventFilter(watched, event);
+}
+
+// function is invoked to press a key the way clicking its button does
+void MainWindow::replayKey(Key key) {
+    if(key < Key::Count)
+        keyButtons[std::size_t(key)]->click();
+}
+
+QString MainWindow::displayText() const {
+    return display->text();
+}
@@ -2,11 +2,22 @@
 #define MAINWINDOW_H
 
 #include <QWidget>
+#include "engine.h"
+#include "history.h"
 
 QT_BEGIN_NAMESPACE
+class QCheckBox;
+class QComboBox;
+class QLabel;
 class QLineEdit;
+class QListView;
+class QModelIndex;
+class QSpinBox;
 QT_END_NAMESPACE
 class Button;
+class Display;
+class HistoryModel;
+class LatencyTracer;
 
 class MainWindow : public QWidget
 {
@@ -15,32 +26,73 @@ class MainWindow : public QWidget
 public:
     MainWindow(QWidget *parent = nullptr);
 
+    // times every keystroke from now on, or stops timing them if tracer is null
+    void setLatencyTracer(LatencyTracer *latencyTracer);
+    // keeps every finished entry on the history tape at path, returns false if it cannot be opened
+    bool openHistory(const QString &path);
+    // clicks the button of a key, which goes through its slot like a real click
+    void replayKey(Key key);
+    QString displayText() const;
+
+signals:
+    // a key is pressed, by a click or a replay
+    void keyPressed(Key key);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private slots:
-    void digitClicked();
+    void digitClicked(int digitValue);
     void plusMinusClicked();
     void multDivClicked();
     void equalsClicked();
+    void powerClicked();
     void pointClicked();
     void flipSignClicked();
     void backspaceClicked();
+    void openBracketClicked();
+    void closeBracketClicked();
+    void percentClicked();
     void clear();
     void clearAll();
+    void numberModeChanged();
+    void previewToggled();
+    void historyClicked(const QModelIndex &index);
+    void historySearchChanged(const QString &text);
 
 private:
     template<typename PointerToMemberFunction>
     Button *createButton(const QString &text, const PointerToMemberFunction &member);
-    void abortOperation();
-    bool calculate(double rightOperand, const QString &pendingOperator);
+    template<typename PointerToMemberFunction>
+    Button *createButton(Operator op, const PointerToMemberFunction &member);
+    void press(Key key);
+    Button *functionButton(Function function) const {
+        return functionButtons[int(function) - int(Function::SquareRoot)];
+    }
+    void recordEntry();
+    bool updateDisplay();
+
+    Engine engine;
+    LatencyTracer *tracer = nullptr;
+    // what the display was last given, so that an unchanged text is not set again
+    std::string shownText;
+    std::string shownPreview;
 
-    double sumSoFar;
-    double factorSoFar;
-    QString pendingAddOp;
-    QString pendingMultOp;
-    bool waitingForOperand;
+    Display *display;
+    QLabel *previewLabel;
+    QCheckBox *previewBox;
 
-    QLineEdit *display;
+    HistoryTape history;
+    HistoryModel *historyModel;
+    QLineEdit *historySearch;
+    QListView *historyView;
+    QComboBox *numberModeBox;
+    QSpinBox *precisionBox;
 
     enum { NumDigitButtons = 10 };
     Button *digitButtons[NumDigitButtons];
+    enum { NumFunctionButtons = int(Function::Count) - int(Function::SquareRoot) };
+    Button *functionButtons[NumFunctionButtons];
+    Button *keyButtons[std::size_t(Key::Count)];
 };
 #endif // MAINWINDOW_H
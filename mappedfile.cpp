@@ -0,0 +1,116 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : mappedData(nullptr), mappedSize(0)
+#ifdef _WIN32
+    , fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+// function is invoked to map a file on windows
+bool MappedFile::open(const char *path, Access access) {
+    close();
+
+    DWORD flags = access == Random ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN;
+    fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                             OPEN_EXISTING, flags, nullptr);
+    if(fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(fileHandle, &fileSize)) {
+        close();
+        return false;
+    }
+    // an empty file cannot be mapped, but it is still a valid (empty) file
+    mappedSize = std::size_t(fileSize.QuadPart);
+    if(mappedSize == 0)
+        return true;
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!mappingHandle) {
+        close();
+        return false;
+    }
+    mappedData = static_cast<const char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if(!mappedData) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+// function is invoked to unmap the file on windows
+void MappedFile::close() {
+    if(mappedData)
+        UnmapViewOfFile(mappedData);
+    if(mappingHandle)
+        CloseHandle(mappingHandle);
+    if(fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+    mappedData = nullptr;
+    mappedSize = 0;
+    mappingHandle = nullptr;
+    fileHandle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+// function is invoked to map a file everywhere else
+bool MappedFile::open(const char *path, Access access) {
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat info;
+    if(fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+    // an empty file cannot be mapped, but it is still a valid (empty) file
+    mappedSize = std::size_t(info.st_size);
+    if(mappedSize == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    void *address = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file, so the descriptor can go
+    ::close(fd);
+    if(address == MAP_FAILED) {
+        mappedSize = 0;
+        return false;
+    }
+    // a file read front to back is read ahead, one read here and there is not
+    madvise(address, mappedSize, access == Random ? MADV_RANDOM : MADV_SEQUENTIAL);
+    mappedData = static_cast<const char *>(address);
+    return true;
+}
+
+// function is invoked to unmap the file everywhere else
+void MappedFile::close() {
+    if(mappedData)
+        munmap(const_cast<char *>(mappedData), mappedSize);
+    mappedData = nullptr;
+    mappedSize = 0;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+
+// a read-only view of a whole file, mapped into memory instead of read into a buffer
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // how the file is going to be read, which decides how much the system reads ahead
+    enum Access {
+        Sequential,
+        Random
+    };
+
+    // maps the file at path, returns false if it cannot be opened or mapped
+    bool open(const char *path, Access access = Sequential);
+    void close();
+
+    const char *data() const { return mappedData; }
+    std::size_t size() const { return mappedSize; }
+
+private:
+    const char *mappedData;
+    std::size_t mappedSize;
+#ifdef _WIN32
+    void *fileHandle;
+    void *mappingHandle;
+#endif
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,612 @@
+#ifndef MATHKERNELS_H
+#define MATHKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include "functions.h"
+
+/* the functions of functions.h as polynomials, written once for any number of
+lanes. L is a struct of static functions the including file defines for its
+instruction set, one lane for the scalar functions and two or four for the
+column kernels:
+
+    Value, Bits, Mask   lanes of doubles, of their bits, and of comparisons
+    Width               the number of lanes
+    load, store, splat, splatBits, toBits, fromBits
+    addBits, subtractBits, andBits, orBits, shiftLeft, shiftRight (logical)
+    less, equal, both, either, negate, bitSet (lanes with one bit of Bits set)
+    select(mask, a, b), sqrt, maskBits (one bit per lane of a mask)
+
+Value needs + - * and / with doubles and with itself. Everything here is
+static, so that every file compiles its own copy for its own instruction set
+and no copy ever stands in for another. Without FMA every lane works out
+exactly what the scalar function does, so a column gives the same results as
+one value at a time on every processor.
+
+The largest errors measured over millions of arguments against the long
+double functions, in units in the last place of the result:
+
+    exp, ln, log10, sin, cos    below 0.9 ulp (sin and cos for |x| < 10^8,
+                                which is as far as angles are reduced)
+    tan, atan                   below 2.2 ulp
+    asin, acos                  below 3.3 ulp
+    x^y                         below 0.8 ulp for results from 10^-304 to 10^304,
+                                integer powers up to 64 below 1 ulp (exact when the
+                                result fits) unless a power on the way falls below
+                                10^-290 and loses its low bits
+
+tests/kernelstest.cpp checks these on every build. Special values follow IEEE
+754, except that 0 to a negative power fails like dividing by zero does */
+
+namespace MathKernels {
+
+// adding this pushes the fraction of anything below 2^51 out of the mantissa, rounding it half to even
+static const double RoundingShifter = 6755399441055744.0;
+static const std::uint64_t SignBit = 0x8000000000000000ULL;
+static const std::uint64_t MantissaBits = 0x000fffffffffffffULL;
+
+static const double Log2E = 1.4426950408889634;
+// ln 2 in two parts, the first with trailing zeros so that k times it is exact
+static const double Ln2Hi = 6.93147180369123816490e-01;
+static const double Ln2Lo = 1.90821492927058770002e-10;
+static const double InverseLn10 = 4.34294481903251816668e-01;
+static const double InverseLn10Lo = 1.09831965021676510e-17;
+static const double TwoThirds = 0.6666666666666666;
+static const double TwoThirdsLo = 3.700743415417188e-17;
+static const double Sqrt2 = 1.4142135623730951;
+
+// pi / 2 in four parts of 27 bits each, so that n times any of them is exact for |n| < 2^26
+static const double TwoOverPi = 6.36619772367581382433e-01;
+static const double PiOver2Part1 = 1.57079632580280303955e+00;
+static const double PiOver2Part2 = 9.92093573959351656958e-10;
+static const double PiOver2Part3 = 5.72118870966357546306e-18;
+static const double PiOver2Part4 = 1.64462569363242579870e-26;
+// the reduction above stops working at 2^26 quarter turns
+static const double MaxTrigArgument = 1.0e8;
+
+static const double PiOver4Hi = 7.85398163397448278999e-01;
+static const double PiOver4Lo = 3.06161699786838301793e-17;
+static const double PiOver2Hi = 1.57079632679489655800e+00;
+static const double PiOver2Lo = 6.12323399573676603587e-17;
+static const double TanPiOver8 = 4.14213562373095145475e-01;
+
+template<class L>
+static inline typename L::Value abs(typename L::Value x) {
+    return L::fromBits(L::andBits(L::toBits(x), L::splatBits(~SignBit)));
+}
+
+// rounds x to the nearest integer, |x| has to be below 2^51
+template<class L>
+static inline typename L::Value roundToInteger(typename L::Value x) {
+    return (x + RoundingShifter) - RoundingShifter;
+}
+
+// the same for any x, everything from 2^52 up is an integer already
+template<class L>
+static inline typename L::Value roundAny(typename L::Value x) {
+    return L::select(L::less(abs<L>(x), L::splat(4503599627370496.0)), roundToInteger<L>(x), x);
+}
+
+// an integer-valued x below 2^51 as a two's complement integer
+template<class L>
+static inline typename L::Bits integerBits(typename L::Value x) {
+    return L::subtractBits(L::toBits(x + RoundingShifter), L::splatBits(0x4338000000000000ULL));
+}
+
+// an integer below 2^51 as a double, the reverse of integerBits()
+template<class L>
+static inline typename L::Value integerValue(typename L::Bits n) {
+    return L::fromBits(L::addBits(n, L::splatBits(0x4338000000000000ULL))) - RoundingShifter;
+}
+
+// 2^k for integer-valued k from -1022 to 1023
+template<class L>
+static inline typename L::Value powerOfTwo(typename L::Value k) {
+    return L::fromBits(L::shiftLeft(L::addBits(integerBits<L>(k), L::splatBits(1023)), 52));
+}
+
+// x with its sign flipped where negate is set
+template<class L>
+static inline typename L::Value negateWhere(typename L::Mask negate, typename L::Value x) {
+    return L::select(negate, -x, x);
+}
+
+template<class L>
+static inline typename L::Mask isNaN(typename L::Value x) {
+    return L::negate(L::equal(x, x));
+}
+
+/* x with the low 27 bits of its mantissa cleared. Halves like this multiply
+exactly, which is what the products below carry their rounding errors with */
+template<class L>
+static inline typename L::Value highHalf(typename L::Value x) {
+    return L::fromBits(L::andBits(L::toBits(x), L::splatBits(0xfffffffff8000000ULL)));
+}
+
+// what rounding took off a * b to give product, as far as a double can hold it
+template<class L>
+static inline typename L::Value productError(typename L::Value a, typename L::Value b, typename L::Value product) {
+    typename L::Value ah = highHalf<L>(a), al = a - ah;
+    typename L::Value bh = highHalf<L>(b), bl = b - bh;
+    return ((ah * bh - product) + ah * bl + al * bh) + al * bl;
+}
+
+template<class L>
+static inline typename L::Mask isFinite(typename L::Value x) {
+    return L::less(abs<L>(x), L::splat(__builtin_inf()));
+}
+
+/* e^(hi + lo), with lo far below an ulp of hi, so that x^y can hand over the
+bits of y ln x that do not fit into one double. 0 below -745 and infinite
+above 709.8. Precise takes a quarter of an ulp or so off the error, which x^y
+needs on top of the error of y ln x */
+template<class L, bool Precise = false>
+static inline typename L::Value expPair(typename L::Value hi, typename L::Value lo) {
+    typedef typename L::Value Value;
+    // clamping keeps k in range without changing the result, and lets NaN through
+    Value x = L::select(L::less(hi, L::splat(-746.0)), L::splat(-746.0), hi);
+    x = L::select(L::less(L::splat(710.0), x), L::splat(710.0), x);
+    lo = L::select(L::equal(x, hi), lo, L::splat(0.0));
+
+    // e^x = 2^k e^r with |r| <= ln 2 / 2, where x - k ln2hi is exact and c is what r lost to rounding
+    Value k = roundToInteger<L>(x * Log2E);
+    Value rh = x - k * Ln2Hi;
+    Value rl = lo - k * Ln2Lo;
+    Value r = rh + rl;
+    Value c = rl - (r - rh);
+
+    // the series from r^3 on, to r^13, which is good to far below an ulp
+    Value p = L::splat(1.0 / 6227020800.0);
+    p = p * r + 1.0 / 479001600.0;
+    p = p * r + 1.0 / 39916800.0;
+    p = p * r + 1.0 / 3628800.0;
+    p = p * r + 1.0 / 362880.0;
+    p = p * r + 1.0 / 40320.0;
+    p = p * r + 1.0 / 5040.0;
+    p = p * r + 1.0 / 720.0;
+    p = p * r + 1.0 / 120.0;
+    p = p * r + 1.0 / 24.0;
+    p = p * r + 1.0 / 6.0;
+    if(!Precise) {
+        // e^(r + c) = e^r + c as far as it shows
+        p = p * r + 0.5;
+        p = (p * r * r + c) + r;
+        p = p + 1.0;
+    } else {
+        /* 1 + r + r^2/2 are added up without rounding, since each rounding would be
+        up to a quarter of an ulp, and everything else is far below an ulp of them.
+        e^(r + c) = e^r (1 + c) as far as it shows */
+        Value square = r * r;
+        Value squareError = productError<L>(r, r, square);
+        Value linear = r + 1.0;
+        Value quadratic = linear + square * 0.5;
+        Value small = (((1.0 - linear) + r) + ((linear - quadratic) + square * 0.5))
+                      + (squareError * 0.5 + square * r * p + c * linear);
+        p = quadratic + small;
+    }
+
+    // 2^k is made of two halves, so that neither leaves the range of a normal double
+    Value half = roundToInteger<L>(k * 0.5);
+    return p * powerOfTwo<L>(half) * powerOfTwo<L>(k - half);
+}
+
+template<class L>
+static inline typename L::Value exp(typename L::Value x) {
+    return expPair<L>(x, L::splat(0.0));
+}
+
+/* ln x as hi + lo for a positive finite x. x = 2^e m with m between sqrt(2)/2
+and sqrt(2), and ln m = 2 atanh s = 2s + 2s^3/3 + s^5 Q(s^2) with
+s = (m - 1)/(m + 1), where s is carried in two parts, the first short enough
+that 2s and e ln2hi add up without losing anything. That is plenty for ln and
+log10. x^y multiplies the result by y, though, so Precise carries 2s^3/3 in
+two parts as well, since it is up to a hundredth of the result and rounds off
+more than that, and corrects s^5 Q for the rounding of s and s^2, which makes
+hi + lo good to about 2^-63 of ln x */
+template<class L, bool Precise = false>
+static inline void lnPair(typename L::Value x, typename L::Value &hi, typename L::Value &lo) {
+    typedef typename L::Value Value;
+    typedef typename L::Bits Bits;
+    typedef typename L::Mask Mask;
+
+    // subnormals are scaled up by 2^54 first, so that their mantissa has a leading 1
+    Mask subnormal = L::less(x, L::splat(2.2250738585072014e-308));
+    x = L::select(subnormal, x * 18014398509481984.0, x);
+    Bits bits = L::toBits(x);
+    Value m = L::fromBits(L::orBits(L::andBits(bits, L::splatBits(MantissaBits)), L::splatBits(0x3ff0000000000000ULL)));
+    Value e = integerValue<L>(L::shiftRight(bits, 52)) - L::select(subnormal, L::splat(1023.0 + 54), L::splat(1023.0));
+    Mask large = L::less(L::splat(Sqrt2), m);
+    m = L::select(large, m * 0.5, m);
+    e = L::select(large, e + 1.0, e);
+
+    // m + 1 = th + tl exactly, which gives the part of s that sh leaves out
+    Value u = m - 1.0;
+    Value v = 1.0 / (m + 1.0);
+    Value s = u * v;
+    Value sh = highHalf<L>(s);
+    Value th = highHalf<L>(m + 1.0);
+    Value tl = m - (th - 1.0);
+    Value sl = v * ((u - sh * th) - sh * tl);
+
+    /* Q = 2/5 + 2 z / 7 + ... to z^9, |s| <= 0.172 so s^25 is far below an ulp,
+    and to z^10 for Precise. Precise also needs s rounded from sh + sl, u v is
+    good to an ulp only */
+    if(Precise)
+        s = sh + sl;
+    Value z = s * s;
+    Value Q = L::splat(2.0 / 23);
+    if(Precise)
+        Q = z * (2.0 / 25) + 2.0 / 23;
+    Q = Q * z + 2.0 / 21;
+    Q = Q * z + 2.0 / 19;
+    Q = Q * z + 2.0 / 17;
+    Q = Q * z + 2.0 / 15;
+    Q = Q * z + 2.0 / 13;
+    Q = Q * z + 2.0 / 11;
+    Q = Q * z + 2.0 / 9;
+    Q = Q * z + 2.0 / 7;
+    Q = Q * z + 2.0 / 5;
+
+    // e ln2hi is exact and at least as large as 2 sh unless e is 0, so their sum loses nothing to tail
+    Value a = e * Ln2Hi;
+    Value sum = a + sh * 2.0;
+    if(!Precise) {
+        Value tail = ((a - sum) + sh * 2.0) + (sl * 2.0 + s * z * (z * Q + TwoThirds) + e * Ln2Lo);
+        hi = sum + tail;
+        lo = tail - (hi - sum);
+        return;
+    }
+
+    // s^5 Q corrected for what s and z lost to rounding, each about an ulp of it
+    Value ds = sl - (s - sh);
+    Value dz = productError<L>(s, s, z) + s * ds * 2.0;
+    Value zQ = z * Q;
+    Value quintic = s * z * zQ + zQ * (ds * z + s * dz * 2.0);
+
+    // s = s17 + rest with s17 of 17 bits, so that s17^3 is exact and the rest of s^3 small
+    Value s17 = L::fromBits(L::andBits(L::toBits(sh), L::splatBits(0xfffffff000000000ULL)));
+    Value rest = (sh - s17) + sl;
+    Value cube = s17 * s17 * s17;
+    Value cubeRest = rest * (s17 * s17 * 3.0 + rest * (s17 * 3.0 + rest));
+    Value cubic = cube * TwoThirds;
+    Value cubicError = productError<L>(cube, L::splat(TwoThirds), cubic) + (cube * TwoThirdsLo + cubeRest * TwoThirds);
+
+    // sum is larger than the cubic term too, so adding it loses nothing to tail either
+    Value withCubic = sum + cubic;
+    Value tail = (((a - sum) + sh * 2.0) + ((sum - withCubic) + cubic))
+                 + (sl * 2.0 + cubicError + quintic + e * Ln2Lo);
+    hi = withCubic + tail;
+    lo = tail - (hi - withCubic);
+}
+
+// the special values of ln and log10: NaN stays NaN and infinity stays infinity
+template<class L>
+static inline typename L::Value logSpecial(typename L::Value x, typename L::Value result) {
+    result = L::select(L::equal(x, L::splat(__builtin_inf())), x, result);
+    return L::select(isNaN<L>(x), x, result);
+}
+
+// ln x, failing at 0 and below
+template<class L>
+static inline typename L::Value ln(typename L::Value x, typename L::Mask &failed) {
+    typename L::Value hi, lo;
+    lnPair<L>(x, hi, lo);
+    failed = L::both(L::negate(L::less(L::splat(0.0), x)), L::equal(x, x));
+    return logSpecial<L>(x, hi);
+}
+
+// log10 x = ln x / ln 10, multiplied out with the low part of ln x, failing at 0 and below
+template<class L>
+static inline typename L::Value log10(typename L::Value x, typename L::Mask &failed) {
+    typename L::Value hi, lo;
+    lnPair<L>(x, hi, lo);
+    failed = L::both(L::negate(L::less(L::splat(0.0), x)), L::equal(x, x));
+    typename L::Value product = hi * InverseLn10;
+    typename L::Value error = productError<L>(hi, L::splat(InverseLn10), product) + (hi * InverseLn10Lo + lo * InverseLn10);
+    return logSpecial<L>(x, product + error);
+}
+
+/* cuts x down to r + tail = x - n pi/2 with |r| <= pi/4, leaving n in
+quadrant. Every product of n is exact, and what each subtraction rounds off
+is gathered into tail. It fails beyond MaxTrigArgument and for infinity, NaN
+just goes through */
+template<class L>
+static inline typename L::Value reduceAngle(typename L::Value x, typename L::Value &tail, typename L::Bits &quadrant,
+                                            typename L::Mask &failed) {
+    typedef typename L::Value Value;
+    failed = L::both(L::negate(L::less(abs<L>(x), L::splat(MaxTrigArgument))), L::equal(x, x));
+    // angles that fail are replaced by 0, which keeps the rounding trick in range
+    x = L::select(failed, L::splat(0.0), x);
+    Value n = roundToInteger<L>(x * TwoOverPi);
+    quadrant = integerBits<L>(n);
+
+    Value a = x - n * PiOver2Part1;
+    Value b = n * PiOver2Part2;
+    Value r1 = a - b;
+    Value t1 = (a - r1) - b;
+    Value c = n * PiOver2Part3;
+    Value r2 = r1 - c;
+    Value t2 = (r1 - r2) - c;
+    Value t = (t1 + t2) - n * PiOver2Part4;
+    Value r = r2 + t;
+    tail = t - (r - r2);
+    return r;
+}
+
+// sin(r + y) for |r| <= pi/4 and y below an ulp of r, the series to r^17 plus y cos r
+template<class L>
+static inline typename L::Value sinPolynomial(typename L::Value r, typename L::Value y, typename L::Value z) {
+    typename L::Value p = L::splat(1.0 / 355687428096000.0);
+    p = p * z - 1.0 / 1307674368000.0;
+    p = p * z + 1.0 / 6227020800.0;
+    p = p * z - 1.0 / 39916800.0;
+    p = p * z + 1.0 / 362880.0;
+    p = p * z - 1.0 / 5040.0;
+    p = p * z + 1.0 / 120.0;
+    p = p * z - 1.0 / 6.0;
+    return r + (r * z * p + (y - z * y * 0.5));
+}
+
+// cos(r + y) the same way, the series to r^16 minus r y, adding 1 - z/2 last the way fdlibm does
+template<class L>
+static inline typename L::Value cosPolynomial(typename L::Value r, typename L::Value y, typename L::Value z) {
+    typename L::Value p = L::splat(1.0 / 20922789888000.0);
+    p = p * z - 1.0 / 87178291200.0;
+    p = p * z + 1.0 / 479001600.0;
+    p = p * z - 1.0 / 3628800.0;
+    p = p * z + 1.0 / 40320.0;
+    p = p * z - 1.0 / 720.0;
+    p = p * z + 1.0 / 24.0;
+    typename L::Value hz = z * 0.5;
+    typename L::Value w = 1.0 - hz;
+    return w + (((1.0 - w) - hz) + (z * z * p - r * y));
+}
+
+template<class L>
+static inline typename L::Value sin(typename L::Value x, typename L::Mask &failed) {
+    typename L::Value y;
+    typename L::Bits quadrant;
+    typename L::Value r = reduceAngle<L>(x, y, quadrant, failed);
+    typename L::Value z = r * r;
+    // the quadrant picks sin or cos of r, and the half turn the sign
+    typename L::Value result = L::select(L::bitSet(quadrant, 0), cosPolynomial<L>(r, y, z), sinPolynomial<L>(r, y, z));
+    return negateWhere<L>(L::bitSet(quadrant, 1), result);
+}
+
+template<class L>
+static inline typename L::Value cos(typename L::Value x, typename L::Mask &failed) {
+    typename L::Value y;
+    typename L::Bits quadrant;
+    typename L::Value r = reduceAngle<L>(x, y, quadrant, failed);
+    typename L::Value z = r * r;
+    typename L::Value result = L::select(L::bitSet(quadrant, 0), sinPolynomial<L>(r, y, z), cosPolynomial<L>(r, y, z));
+    return negateWhere<L>(L::bitSet(L::addBits(quadrant, L::splatBits(1)), 1), result);
+}
+
+// tan x, which is infinite nowhere since no double is an odd multiple of pi/2
+template<class L>
+static inline typename L::Value tan(typename L::Value x, typename L::Mask &failed) {
+    typename L::Value y;
+    typename L::Bits quadrant;
+    typename L::Value r = reduceAngle<L>(x, y, quadrant, failed);
+    typename L::Value z = r * r;
+    typename L::Value s = sinPolynomial<L>(r, y, z);
+    typename L::Value c = cosPolynomial<L>(r, y, z);
+    return L::select(L::bitSet(quadrant, 0), -c / s, s / c);
+}
+
+/* atan x, folding every argument into |t| <= tan(pi/8) by atan x = pi/2 -
+atan(1/x) and atan x = pi/4 + atan((x - 1)/(x + 1)), where the series to t^41
+is good enough */
+template<class L>
+static inline typename L::Value atan(typename L::Value x) {
+    typedef typename L::Value Value;
+    typedef typename L::Mask Mask;
+    Value a = abs<L>(x);
+    Mask inverted = L::less(L::splat(1.0), a);
+    Value t = L::select(inverted, 1.0 / a, a);
+    Mask shifted = L::less(L::splat(TanPiOver8), t);
+    t = L::select(shifted, (t - 1.0) / (t + 1.0), t);
+
+    Value z = t * t;
+    Value p = L::splat(1.0 / 41);
+    for(int k = 39; k >= 3; k -= 2)
+        p = p * z + ((k & 2) ? -1.0 / k : 1.0 / k);
+    Value result = t + t * z * p;
+
+    result = L::select(shifted, PiOver4Hi + (result + PiOver4Lo), result);
+    result = L::select(inverted, PiOver2Hi - (result - PiOver2Lo), result);
+    // the result has the sign of x, down to -0
+    return L::fromBits(L::orBits(L::toBits(result), L::andBits(L::toBits(x), L::splatBits(SignBit))));
+}
+
+// asin x = atan(x / sqrt(1 - x^2)), failing beyond 1
+template<class L>
+static inline typename L::Value asin(typename L::Value x, typename L::Mask &failed) {
+    failed = L::less(L::splat(1.0), abs<L>(x));
+    return atan<L>(x / L::sqrt((1.0 - x) * (1.0 + x)));
+}
+
+// acos x = 2 atan(sqrt((1 - x) / (1 + x))), failing beyond 1
+template<class L>
+static inline typename L::Value acos(typename L::Value x, typename L::Mask &failed) {
+    failed = L::less(L::splat(1.0), abs<L>(x));
+    return atan<L>(L::sqrt((1.0 - x) / (1.0 + x))) * 2.0;
+}
+
+// the product of two numbers carried as hi + lo each, as hi + lo again
+template<class L>
+static inline void multiplyPairs(typename L::Value &hi, typename L::Value &lo, typename L::Value bhi, typename L::Value blo) {
+    typename L::Value product = hi * bhi;
+    typename L::Value error = productError<L>(hi, bhi, product) + (hi * blo + lo * bhi);
+    hi = product + error;
+    lo = error - (hi - product);
+}
+
+/* x^y. Integer powers up to 64 are multiplied out with twice the bits of a
+double, so that they come out exact whenever the result fits into one and
+rounded once otherwise. Everything else is e^(y ln |x|), with ln |x| and its
+product with y carried in two parts, since a rounding error in y ln x turns
+into an error of the result as many times larger as y ln x is. The result is
+negative for a negative x to an odd power. Fails for 0 to a negative power
+and a negative x to a power that is not an integer */
+template<class L>
+static inline typename L::Value power(typename L::Value x, typename L::Value y, typename L::Mask &failed) {
+    typedef typename L::Value Value;
+    typedef typename L::Bits Bits;
+    typedef typename L::Mask Mask;
+    const Value zero = L::splat(0.0);
+    const Value one = L::splat(1.0);
+
+    Value ax = abs<L>(x);
+    Value ay = abs<L>(y);
+    Mask integral = L::equal(roundAny<L>(y), y);
+    // halving is exact, so an odd y is one whose half is not an integer
+    Value halfY = y * 0.5;
+    Mask odd = L::both(integral, L::negate(L::equal(roundAny<L>(halfY), halfY)));
+
+    // the general case, y (hi + lo) with y cut in halves so that the largest product is exact
+    Value hi, lo;
+    lnPair<L, true>(ax, hi, lo);
+    Value yh = highHalf<L>(y), yl = y - yh;
+    Value hh = highHalf<L>(hi), hl = hi - hh;
+    Value ph = yh * hh;
+    Value pl = (yl * hi + yh * hl) + y * lo;
+    Value zh = ph + pl;
+    Value result = expPair<L, true>(zh, pl - (zh - ph));
+
+    // small integer powers one bit of the exponent at a time
+    Mask small = L::both(integral, L::less(ay, L::splat(65.0)));
+    Bits n = integerBits<L>(L::select(small, ay, zero));
+    Value productHi = one, productLo = zero;
+    Value squareHi = ax, squareLo = zero;
+    for(int bit = 0; bit < 7; bit++) {
+        Mask set = L::bitSet(n, bit);
+        Value nextHi = productHi, nextLo = productLo;
+        multiplyPairs<L>(nextHi, nextLo, squareHi, squareLo);
+        productHi = L::select(set, nextHi, productHi);
+        productLo = L::select(set, nextLo, productLo);
+        multiplyPairs<L>(squareHi, squareLo, squareHi, squareLo);
+    }
+    // 1 / (hi + lo) is 1 / hi corrected by the error of hi / hi, overflows and underflows leave NaN in the corrections
+    Value inverse = 1.0 / productHi;
+    Value inverseProduct = inverse * productHi;
+    Value correction = ((1.0 - inverseProduct) - productError<L>(inverse, productHi, inverseProduct)) - inverse * productLo;
+    Value product = L::select(L::less(y, zero), inverse + inverse * correction, productHi + productLo);
+    product = L::select(isNaN<L>(product), L::select(L::less(y, zero), inverse, productHi), product);
+    // a square that overflowed on the way leaves NaN, and e^(y ln |x|) overflows just the same
+    result = L::select(L::both(small, L::equal(productHi, productHi)), product, result);
+
+    /* the special values the way IEEE 754 has them: anything to an infinite power
+    and NaN to any power, then infinity and 0 to a positive or negative power, then the sign, which
+    -0 has too, then anything to the power 0, 1 to anything and -1 to an
+    infinite power */
+    const Value infinity = L::splat(__builtin_inf());
+    Mask yInfinite = L::equal(ay, infinity);
+    Mask toInfinity = L::either(L::both(L::less(one, ax), L::less(zero, y)), L::both(L::less(ax, one), L::less(y, zero)));
+    result = L::select(yInfinite, L::select(toInfinity, infinity, zero), result);
+    result = L::select(isNaN<L>(x), x, result);
+    Mask xZero = L::equal(x, zero);
+    Mask xInfinite = L::equal(ax, infinity);
+    Mask grows = L::either(L::both(xZero, L::less(y, zero)), L::both(xInfinite, L::less(zero, y)));
+    Mask shrinks = L::either(L::both(xZero, L::less(zero, y)), L::both(xInfinite, L::less(y, zero)));
+    result = L::select(grows, infinity, L::select(shrinks, zero, result));
+    result = negateWhere<L>(L::both(odd, L::bitSet(L::toBits(x), 63)), result);
+    Mask unit = L::either(L::equal(x, one), L::both(L::equal(ax, one), yInfinite));
+    result = L::select(L::either(L::equal(y, zero), unit), one, result);
+
+    failed = L::either(L::both(xZero, L::less(y, zero)), L::both(L::less(x, zero), L::negate(integral)));
+    failed = L::both(failed, L::negate(isNaN<L>(y)));
+    return result;
+}
+
+// one function applied to a lane of values, except gamma and factorial, which have no kernel
+template<class L>
+static inline typename L::Value apply(Function function, typename L::Value x, typename L::Mask &failed) {
+    switch(function) {
+    case Function::SquareRoot:
+        failed = L::less(x, L::splat(0.0));
+        return L::sqrt(x);
+    case Function::Exponential:
+        failed = L::less(x, x);
+        return exp<L>(x);
+    case Function::NaturalLog:
+        return ln<L>(x, failed);
+    case Function::Log10:
+        return log10<L>(x, failed);
+    case Function::Sine:
+        return sin<L>(x, failed);
+    case Function::Cosine:
+        return cos<L>(x, failed);
+    case Function::Tangent:
+        return tan<L>(x, failed);
+    case Function::ArcSine:
+        return asin<L>(x, failed);
+    case Function::ArcCosine:
+        return acos<L>(x, failed);
+    case Function::ArcTangent:
+        failed = L::less(x, x);
+        return atan<L>(x);
+    default:
+        failed = L::equal(x, x);
+        return x;
+    }
+}
+
+// marks the rows of a block whose lane failed
+template<class L>
+static inline void markFailed(typename L::Mask failed, unsigned char *errors, std::size_t lanes) {
+    int bits = L::maskBits(failed);
+    if(bits) {
+        for(std::size_t lane = 0; lane < lanes; lane++)
+            errors[lane] |= (bits >> lane) & 1;
+    }
+}
+
+/* a function over a number of rows, Width at a time. The rows left over go
+through the same lanes, padded with ones, so that every row gets the same
+result whatever its place in the column */
+template<class L>
+static void functionRows(Function function, const double *a, double *dest, unsigned char *errors, std::size_t rows) {
+    std::size_t i = 0;
+    typename L::Mask failed;
+    for(; i + L::Width <= rows; i += L::Width) {
+        L::store(dest + i, apply<L>(function, L::load(a + i), failed));
+        markFailed<L>(failed, errors + i, L::Width);
+    }
+    if(i < rows) {
+        double in[L::Width], out[L::Width];
+        for(std::size_t lane = 0; lane < std::size_t(L::Width); lane++)
+            in[lane] = i + lane < rows ? a[i + lane] : 1.0;
+        L::store(out, apply<L>(function, L::load(in), failed));
+        markFailed<L>(failed, errors + i, rows - i);
+        for(std::size_t lane = 0; i + lane < rows; lane++)
+            dest[i + lane] = out[lane];
+    }
+}
+
+// a to the power b over a number of rows, the same way
+template<class L>
+static void powerRows(const double *a, const double *b, double *dest, unsigned char *errors, std::size_t rows) {
+    std::size_t i = 0;
+    typename L::Mask failed;
+    for(; i + L::Width <= rows; i += L::Width) {
+        L::store(dest + i, power<L>(L::load(a + i), L::load(b + i), failed));
+        markFailed<L>(failed, errors + i, L::Width);
+    }
+    if(i < rows) {
+        double base[L::Width], exponent[L::Width], out[L::Width];
+        for(std::size_t lane = 0; lane < std::size_t(L::Width); lane++) {
+            base[lane] = i + lane < rows ? a[i + lane] : 1.0;
+            exponent[lane] = i + lane < rows ? b[i + lane] : 1.0;
+        }
+        L::store(out, power<L>(L::load(base), L::load(exponent), failed));
+        markFailed<L>(failed, errors + i, rows - i);
+        for(std::size_t lane = 0; i + lane < rows; lane++)
+            dest[i + lane] = out[lane];
+    }
+}
+
+} // namespace MathKernels
+
+#endif // MATHKERNELS_H
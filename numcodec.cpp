@@ -0,0 +1,214 @@
+#include "numcodec.h"
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// the powers of ten that are exact as doubles
+static const double ExactPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// values from 10^-5 up to below 10^17 are written without an exponent
+static const int MinFixedExponent = -5;
+static const int MaxFixedExponent = 16;
+
+// the significant digits of a value and where the point goes: value = d.ddd × 10^exponent
+struct Digits {
+    char digits[24];
+    int count;
+    int exponent;
+    bool negative;
+};
+
+/* splits the scientific text of a finite value into its digits, using either
+the shortest digits that round trip (precision < 0) or that many digits.
+to_chars in scientific form is the Ryu algorithm in every standard library
+that has it */
+static void splitDigits(double value, int precision, Digits &split) {
+    char text[MaxDoubleText];
+    std::to_chars_result written = precision < 0
+        ? std::to_chars(text, text + sizeof(text), value, std::chars_format::scientific)
+        : std::to_chars(text, text + sizeof(text), value, std::chars_format::scientific, precision - 1);
+
+    const char *p = text;
+    split.negative = *p == '-';
+    p += split.negative;
+    split.count = 0;
+    for(; p != written.ptr && *p != 'e'; p++) {
+        if(*p != '.')
+            split.digits[split.count++] = *p;
+    }
+    // rounding to a precision can leave zeros at the end, they say nothing
+    while(split.count > 1 && split.digits[split.count - 1] == '0')
+        split.count--;
+    std::from_chars(p + 1 + (p[1] == '+'), written.ptr, split.exponent);
+}
+
+// writes digits without an exponent, like 1234.5 or 0.00012
+static char *writeFixed(char *out, const Digits &split) {
+    if(split.negative)
+        *out++ = '-';
+    if(split.exponent < 0) {
+        *out++ = '0';
+        *out++ = '.';
+        for(int i = -1; i > split.exponent; i--)
+            *out++ = '0';
+        std::memcpy(out, split.digits, std::size_t(split.count));
+        return out + split.count;
+    }
+    int whole = split.exponent + 1;
+    if(split.count <= whole) {
+        std::memcpy(out, split.digits, std::size_t(split.count));
+        out += split.count;
+        for(int i = split.count; i < whole; i++)
+            *out++ = '0';
+        return out;
+    }
+    std::memcpy(out, split.digits, std::size_t(whole));
+    out += whole;
+    *out++ = '.';
+    std::memcpy(out, split.digits + whole, std::size_t(split.count - whole));
+    return out + (split.count - whole);
+}
+
+// writes digits with an exponent, like 1.5e+20 or 2e-07
+static char *writeScientific(char *out, const Digits &split) {
+    if(split.negative)
+        *out++ = '-';
+    *out++ = split.digits[0];
+    if(split.count > 1) {
+        *out++ = '.';
+        std::memcpy(out, split.digits + 1, std::size_t(split.count - 1));
+        out += split.count - 1;
+    }
+    *out++ = 'e';
+    int exponent = split.exponent;
+    *out++ = exponent < 0 ? '-' : '+';
+    if(exponent < 0)
+        exponent = -exponent;
+    // at least two digits in the exponent, the way printf writes them
+    if(exponent < 10)
+        *out++ = '0';
+    return std::to_chars(out, out + 4, exponent).ptr;
+}
+
+static bool isFixed(const Digits &split) {
+    return split.exponent >= MinFixedExponent && split.exponent <= MaxFixedExponent;
+}
+
+// function is invoked to write a value with as few digits as read back to it
+char *formatShortest(char *buffer, double value) {
+    // whole numbers that a double holds exactly are written as integers straight away
+    if(value == std::floor(value) && std::fabs(value) < 9007199254740992.0 && (value != 0 || !std::signbit(value)))
+        return std::to_chars(buffer, buffer + MaxDoubleText, std::int64_t(value)).ptr;
+    if(!std::isfinite(value))
+        return std::to_chars(buffer, buffer + MaxDoubleText, value).ptr;
+
+    Digits split;
+    splitDigits(value, -1, split);
+    return isFixed(split) ? writeFixed(buffer, split) : writeScientific(buffer, split);
+}
+
+// function is invoked to write a value into a limited space, like the display
+char *formatDouble(char *buffer, double value, std::size_t maxLength) {
+    char *end = formatShortest(buffer, value);
+    if(std::size_t(end - buffer) <= maxLength || !std::isfinite(value))
+        return end;
+
+    // round to fewer and fewer digits, with or without an exponent, until the text fits
+    Digits split;
+    splitDigits(value, -1, split);
+    for(int precision = split.count; precision >= 1; precision--) {
+        splitDigits(value, precision, split);
+        if(isFixed(split)) {
+            end = writeFixed(buffer, split);
+            if(std::size_t(end - buffer) <= maxLength)
+                return end;
+        }
+        end = writeScientific(buffer, split);
+        if(std::size_t(end - buffer) <= maxLength)
+            return end;
+    }
+    return end;
+}
+
+void appendDouble(std::string &text, double value) {
+    char buffer[MaxDoubleText];
+    text.append(buffer, formatShortest(buffer, value));
+}
+
+// function is invoked to read a double, exactly in one step when clinger's fast path applies
+const char *parseDouble(const char *begin, const char *end, double &value) {
+    const char *p = begin;
+    bool negative = p != end && *p == '-';
+    p += negative;
+
+    // up to 19 digits fit in 64 bits, any after that are only counted
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    int dropped = 0;
+    int exponent = 0;
+    bool seenPoint = false;
+    const char *digitsStart = p;
+    for(; p != end; p++) {
+        if(*p == '.' && !seenPoint) {
+            seenPoint = true;
+            continue;
+        }
+        if(*p < '0' || *p > '9')
+            break;
+        if(digits < 19) {
+            mantissa = mantissa * 10 + std::uint64_t(*p - '0');
+            // leading zeros do not use up any of the 19 digits
+            digits += mantissa != 0;
+            exponent -= seenPoint;
+        } else {
+            dropped++;
+            exponent += !seenPoint;
+        }
+    }
+    // only a point, or nothing at all: maybe inf or nan, which from_chars knows
+    if(p == digitsStart || (p == digitsStart + 1 && seenPoint)) {
+        std::from_chars_result result = std::from_chars(begin, end, value);
+        return result.ec == std::errc() ? result.ptr : begin;
+    }
+
+    if(p != end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool negativeExponent = q != end && *q == '-';
+        if(q != end && (*q == '-' || *q == '+'))
+            q++;
+        if(q != end && *q >= '0' && *q <= '9') {
+            int written = 0;
+            for(; q != end && *q >= '0' && *q <= '9'; q++) {
+                if(written < 100000)
+                    written = written * 10 + (*q - '0');
+            }
+            exponent += negativeExponent ? -written : written;
+            p = q;
+        }
+    }
+
+    /* the mantissa and the power of ten are both exact doubles, so one
+    multiplication or division rounds correctly */
+    if(!dropped && mantissa <= (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+        double result = double(mantissa);
+        result = exponent < 0 ? result / ExactPowersOfTen[-exponent] : result * ExactPowersOfTen[exponent];
+        value = negative ? -result : result;
+        return p;
+    }
+
+    // everything else goes the long way, over the same text
+    std::from_chars_result result = std::from_chars(begin, p, value);
+    if(result.ec == std::errc::result_out_of_range) {
+        // from_chars leaves value alone when it is out of range, make it what the text means
+        bool tiny = exponent < 0;
+        value = tiny ? 0.0 : HUGE_VAL;
+        if(negative)
+            value = -value;
+        return p;
+    }
+    return result.ec == std::errc() ? result.ptr : begin;
+}
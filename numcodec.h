@@ -0,0 +1,27 @@
+#ifndef NUMCODEC_H
+#define NUMCODEC_H
+
+#include <cstddef>
+#include <string>
+
+// the longest text formatDouble() ever writes, "-2.2250738585072014e-308" and then some
+enum { MaxDoubleText = 32 };
+
+/* writes the shortest text that reads back as exactly value, into buffer
+(at least MaxDoubleText long) without a terminating zero, and returns the
+end of the text */
+char *formatShortest(char *buffer, double value);
+
+/* the same, but never longer than maxLength characters: if the shortest text
+does not fit, value is rounded to as many significant digits as do */
+char *formatDouble(char *buffer, double value, std::size_t maxLength);
+
+// appends the shortest text of value to text
+void appendDouble(std::string &text, double value);
+
+/* reads a double at begin, [-]digits[.digits][e[+|-]digits] or inf and nan,
+correctly rounded. Returns the end of what was read, or begin if there is no
+number there */
+const char *parseDouble(const char *begin, const char *end, double &value);
+
+#endif // NUMCODEC_H
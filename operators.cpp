@@ -0,0 +1,55 @@
+#include "operators.h"
+#include <cstring>
+
+// the row of None is never applied, it only keeps the table indexable by every operator
+static bool applyNothing(double &, double) {
+    return true;
+}
+
+static const OperatorInfo operatorTable[] = {
+    { "",         Precedence::None,           applyNothing },
+    { "+",        Precedence::Additive,       OperatorKernel<Operator::Add>::apply },
+    { "-",        Precedence::Additive,       OperatorKernel<Operator::Subtract>::apply },
+    { "\303\227", Precedence::Multiplicative, OperatorKernel<Operator::Multiply>::apply },
+    { "\303\267", Precedence::Multiplicative, OperatorKernel<Operator::Divide>::apply },
+    { "^",        Precedence::Power,          OperatorKernel<Operator::Power>::apply },
+};
+
+static_assert(sizeof(operatorTable) / sizeof(operatorTable[0]) == std::size_t(Operator::Count),
+              "every operator needs a row in operatorTable");
+
+const OperatorInfo &operatorInfo(Operator op) {
+    return operatorTable[std::size_t(op)];
+}
+
+// function is invoked to read an operator out of a line of text
+Operator readOperator(const char *text, std::size_t available, std::size_t &length) {
+    length = 0;
+    if(available == 0)
+        return Operator::None;
+
+    // the plain ascii spellings come first, they are the most common in typed input
+    switch(text[0]) {
+    case '+': length = 1; return Operator::Add;
+    case '-': length = 1; return Operator::Subtract;
+    case '*': length = 1; return Operator::Multiply;
+    case '/': length = 1; return Operator::Divide;
+    default: break;
+    }
+
+    // the typographic minus sign, as pasted from documents
+    if(available >= 3 && std::memcmp(text, "\342\210\222", 3) == 0) {
+        length = 3;
+        return Operator::Subtract;
+    }
+
+    // then the symbols of the buttons, which are longer in utf-8
+    for(std::size_t i = 1; i < std::size_t(Operator::Count); i++) {
+        std::size_t symbolLength = std::strlen(operatorTable[i].symbol);
+        if(symbolLength <= available && std::memcmp(text, operatorTable[i].symbol, symbolLength) == 0) {
+            length = symbolLength;
+            return Operator(i);
+        }
+    }
+    return Operator::None;
+}
@@ -0,0 +1,73 @@
+#ifndef OPERATORS_H
+#define OPERATORS_H
+
+#include <cstddef>
+#include "functions.h"
+
+// every operator the engine knows, None meaning that no operator is pending
+enum class Operator : unsigned char {
+    None,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Power,
+    Count
+};
+
+// which accumulator an operator works on, sums bind looser than factors and factors looser than powers
+enum class Precedence : unsigned char {
+    None,
+    Additive,
+    Multiplicative,
+    Power
+};
+
+// the arithmetic of every operator, specialised at compile time so that it inlines
+template<Operator Op> struct OperatorKernel;
+
+template<> struct OperatorKernel<Operator::Add> {
+    static bool apply(double &accumulator, double rightOperand) { accumulator += rightOperand; return true; }
+};
+
+template<> struct OperatorKernel<Operator::Subtract> {
+    static bool apply(double &accumulator, double rightOperand) { accumulator -= rightOperand; return true; }
+};
+
+template<> struct OperatorKernel<Operator::Multiply> {
+    static bool apply(double &accumulator, double rightOperand) { accumulator *= rightOperand; return true; }
+};
+
+template<> struct OperatorKernel<Operator::Divide> {
+    // dividing by zero fails instead of producing an infinity
+    static bool apply(double &accumulator, double rightOperand) {
+        if(rightOperand == 0)
+            return false;
+        accumulator /= rightOperand;
+        return true;
+    }
+};
+
+template<> struct OperatorKernel<Operator::Power> {
+    // 0 to a negative power and a negative number to a fraction fail like dividing by zero
+    static bool apply(double &accumulator, double rightOperand) { return raisePower(accumulator, rightOperand); }
+};
+
+// one row per operator, indexed by the operator itself
+struct OperatorInfo {
+    const char *symbol;
+    Precedence precedence;
+    bool (*apply)(double &accumulator, double rightOperand);
+};
+
+const OperatorInfo &operatorInfo(Operator op);
+
+// the label shown on the button of an operator
+inline const char *operatorSymbol(Operator op) { return operatorInfo(op).symbol; }
+inline Precedence operatorPrecedence(Operator op) { return operatorInfo(op).precedence; }
+
+// reads an operator at text, also accepting * and / for times and divide and − for minus,
+// returns None and leaves length at 0 if there is none
+Operator readOperator(const char *text, std::size_t available, std::size_t &length);
+
+#endif // OPERATORS_H
@@ -0,0 +1,516 @@
+#include "rational.h"
+#include "decimal.h"
+#include <algorithm>
+#include <utility>
+
+static const std::uint32_t SmallPowersOfTen[] = {
+    1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u
+};
+
+// exponents further out than this are not read, 10^exponent is worked out in full
+static const long MaxExponent = 10000;
+
+// numerators and denominators up to 2^53 convert to double exactly, so their quotient rounds once
+static const std::uint64_t MaxExactDouble = std::uint64_t(1) << 53;
+
+// the significant digits kept of a fraction that cannot be worked with exactly, far more than a display shows
+static const std::size_t RoundedDigits = 40;
+
+// a power whose terms would come to more bits than this is taken of the base cut to RoundedDigits digits
+static const std::size_t MaxExactPowerBits = std::size_t(1) << 18;
+
+static bool multiplyOverflows(std::uint64_t a, std::uint64_t b, std::uint64_t &product) {
+#if defined(__GNUC__)
+    return __builtin_mul_overflow(a, b, &product);
+#else
+    product = a * b;
+    return a != 0 && product / a != b;
+#endif
+}
+
+static unsigned trailingZeros(std::uint64_t value) {
+#if defined(__GNUC__)
+    return value ? unsigned(__builtin_ctzll(value)) : 64;
+#else
+    unsigned zeros = 0;
+    for(std::uint64_t bit = 1; bit && !(value & bit); bit <<= 1)
+        zeros++;
+    return zeros;
+#endif
+}
+
+// binary gcd, which only ever shifts and subtracts
+static std::uint64_t greatestCommonDivisor(std::uint64_t a, std::uint64_t b) {
+    if(a == 0)
+        return b;
+    if(b == 0)
+        return a;
+    unsigned shift = trailingZeros(a | b);
+    a >>= trailingZeros(a);
+    // both odd from here on, so their difference is even and loses a bit at least
+    do {
+        b >>= trailingZeros(b);
+        if(a > b)
+            std::swap(a, b);
+        b -= a;
+    } while(b);
+    return a << shift;
+}
+
+// the same for large numbers, down to the 64-bit version as soon as both fit
+static Natural greatestCommonDivisor(Natural a, Natural b) {
+    if(a.isZero())
+        return b;
+    if(b.isZero())
+        return a;
+    std::size_t shift = std::min(a.trailingZeroBits(), b.trailingZeroBits());
+    a.shiftRight(a.trailingZeroBits());
+    b.shiftRight(b.trailingZeroBits());
+    while(!a.fitsIn64() || !b.fitsIn64()) {
+        int comparison = Natural::compare(a, b);
+        if(comparison == 0)
+            break;
+        if(comparison > 0)
+            std::swap(a, b);
+        if(b.bitLength() > a.bitLength() + 64) {
+            // one step of euclid takes off what would be a long run of subtractions
+            Natural quotient, remainder;
+            Natural::divide(b, a, quotient, remainder);
+            b = std::move(remainder);
+        } else {
+            b = Natural::subtract(b, a);
+        }
+        if(b.isZero())
+            break;
+        b.shiftRight(b.trailingZeroBits());
+    }
+    Natural result = b.isZero() || Natural::compare(a, b) == 0
+                     ? std::move(a) : Natural(greatestCommonDivisor(a.low64(), b.low64()));
+    result.shiftLeft(shift);
+    return result;
+}
+
+static bool isOne(const Natural &value) {
+    return value.fitsIn64() && value.low64() == 1;
+}
+
+// n / d for a d that divides n
+static Natural quotient(const Natural &n, const Natural &d) {
+    Natural result, remainder;
+    Natural::divide(n, d, result, remainder);
+    return result;
+}
+
+// divides a numerator and a denominator by what they have in common, which is nothing if either is 1
+static void cancel(Natural &numerator, Natural &denominator) {
+    if(isOne(numerator) || isOne(denominator))
+        return;
+    Natural divisor = greatestCommonDivisor(numerator, denominator);
+    if(isOne(divisor))
+        return;
+    numerator = quotient(numerator, divisor);
+    denominator = quotient(denominator, divisor);
+}
+
+// the decimal digits of a number, or one fewer, without the powers of ten that counting them exactly takes
+static long decimalDigitsBelow(const Natural &value) {
+    return long(double(value.bitLength() - 1) * 0.30102999566398120) + 1;
+}
+
+/* n / d written with at least digits significant digits, followed by a 1 if
+the division does not come out even. The 1 stands for everything after the
+digits, so that rounding to fewer digits rounds the fraction itself and never
+sees a tie that is not one */
+static Decimal decimalQuotient(const Natural &n, const Natural &d, bool negative, std::size_t digits) {
+    if(n.isZero())
+        return Decimal();
+    if(d.fitsIn64() && d.low64() == 1)
+        return Decimal(n, 0, negative);
+    // digits from the bit lengths, at most one short for n and one over for d, so there are digits at least
+    long shift = long(digits) + 1 + decimalDigitsBelow(d) - decimalDigitsBelow(n);
+    if(shift < 0)
+        shift = 0;
+    Natural quotient, remainder;
+    Natural::divide(Natural::multiply(n, Natural::powerOfTen(std::size_t(shift))), d, quotient, remainder);
+    std::int32_t exponent = -std::int32_t(shift);
+    if(!remainder.isZero()) {
+        quotient.multiplySmall(10, 1);
+        exponent--;
+    }
+    return Decimal(std::move(quotient), exponent, negative);
+}
+
+// turns n / d into its quotient cut to RoundedDigits digits, as a fraction over a power of ten
+static void cutTerms(Natural &n, Natural &d) {
+    long shift = long(RoundedDigits) + decimalDigitsBelow(d) - decimalDigitsBelow(n);
+    Natural cut, remainder;
+    if(shift >= 0) {
+        Natural::divide(Natural::multiply(n, Natural::powerOfTen(std::size_t(shift))), d, cut, remainder);
+        n = std::move(cut);
+        d = Natural::powerOfTen(std::size_t(shift));
+    } else {
+        Natural scale = Natural::powerOfTen(std::size_t(-shift));
+        Natural::divide(n, Natural::multiply(d, scale), cut, remainder);
+        n = Natural::multiply(cut, scale);
+        d = Natural(1);
+    }
+    cancel(n, d);
+}
+
+Rational::Rational()
+    : smallNumerator(0), smallDenominator(1), negative(false), big(false), reduced(true)
+{
+}
+
+Rational::Rational(std::int64_t value)
+    : smallNumerator(value < 0 ? 0 - std::uint64_t(value) : std::uint64_t(value)), smallDenominator(1)
+    , negative(value < 0), big(false), reduced(true)
+{
+}
+
+// function is invoked to read a number as the fraction it is, 1.25 being 125 / 100
+bool Rational::parse(const char *text, std::size_t length, Rational &value) {
+    const char *p = text;
+    const char *end = text + length;
+    bool negativeValue = false;
+    if(p != end && (*p == '-' || *p == '+')) {
+        negativeValue = *p == '-';
+        p++;
+    }
+
+    // the digits are gathered nine at a time like a decimal does
+    Natural digits;
+    std::uint32_t group = 0;
+    std::size_t groupDigits = 0;
+    std::size_t digitsSeen = 0;
+    long fractionDigits = 0;
+    bool seenPoint = false;
+    for(; p != end; p++) {
+        if(*p == '.' && !seenPoint) {
+            seenPoint = true;
+            continue;
+        }
+        if(*p < '0' || *p > '9')
+            break;
+        group = group * 10 + std::uint32_t(*p - '0');
+        groupDigits++;
+        digitsSeen++;
+        fractionDigits += seenPoint;
+        if(groupDigits == 9) {
+            digits.multiplySmall(SmallPowersOfTen[9], group);
+            group = 0;
+            groupDigits = 0;
+        }
+    }
+    if(digitsSeen == 0)
+        return false;
+    if(groupDigits)
+        digits.multiplySmall(SmallPowersOfTen[groupDigits], group);
+
+    long exponentValue = 0;
+    if(p != end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExponent = false;
+        if(p != end && (*p == '-' || *p == '+')) {
+            negativeExponent = *p == '-';
+            p++;
+        }
+        if(p == end)
+            return false;
+        for(; p != end && *p >= '0' && *p <= '9'; p++) {
+            exponentValue = exponentValue * 10 + (*p - '0');
+            if(exponentValue > MaxExponent)
+                return false;
+        }
+        if(negativeExponent)
+            exponentValue = -exponentValue;
+    }
+    if(p != end)
+        return false;
+
+    Rational result;
+    exponentValue -= fractionDigits;
+    if(exponentValue >= 0)
+        result.setTerms(Natural::multiply(digits, Natural::powerOfTen(std::size_t(exponentValue))), Natural(1));
+    else
+        result.setTerms(std::move(digits), Natural::powerOfTen(std::size_t(-exponentValue)));
+    result.negative = negativeValue;
+    result.reduced = false;
+    value = std::move(result);
+    return true;
+}
+
+bool Rational::toInteger(std::int64_t limit, std::int64_t &n) const {
+    Rational value(*this);
+    value.reduce();
+    if(value.big || value.smallDenominator != 1 || value.smallNumerator > std::uint64_t(limit))
+        return false;
+    n = value.negative ? -std::int64_t(value.smallNumerator) : std::int64_t(value.smallNumerator);
+    return true;
+}
+
+Rational Rational::operator-() const {
+    Rational result(*this);
+    result.negative = !negative;
+    return result;
+}
+
+Rational Rational::add(const Rational &a, const Rational &b) {
+    return sum(a, b, b.negative);
+}
+
+Rational Rational::subtract(const Rational &a, const Rational &b) {
+    return sum(a, b, !b.negative);
+}
+
+// function is invoked to add, in 64 bits if the terms allow it, reducing them first if that is what it takes
+Rational Rational::sum(const Rational &a, const Rational &b, bool negativeB) {
+    Rational result;
+    if(!a.big && !b.big && sumSmall(a, b, negativeB, result))
+        return result;
+    if(a.reduced && b.reduced)
+        return sumLarge(a, b, negativeB);
+    Rational left(a);
+    Rational right(b);
+    left.reduce();
+    right.reduce();
+    if(!left.big && !right.big && sumSmall(left, right, negativeB, result))
+        return result;
+    return sumLarge(left, right, negativeB);
+}
+
+// a / b + c / d as (a d + c b) / (b d), or (a + c) / b over a shared denominator, false if it overflows
+bool Rational::sumSmall(const Rational &a, const Rational &b, bool negativeB, Rational &result) {
+    std::uint64_t left, right, denominator;
+    if(a.smallDenominator == b.smallDenominator) {
+        left = a.smallNumerator;
+        right = b.smallNumerator;
+        denominator = a.smallDenominator;
+    } else if(multiplyOverflows(a.smallNumerator, b.smallDenominator, left)
+              || multiplyOverflows(b.smallNumerator, a.smallDenominator, right)
+              || multiplyOverflows(a.smallDenominator, b.smallDenominator, denominator)) {
+        return false;
+    }
+
+    if(a.negative == negativeB) {
+        result.smallNumerator = left + right;
+        if(result.smallNumerator < left)
+            return false;
+        result.negative = a.negative;
+    } else if(left >= right) {
+        result.smallNumerator = left - right;
+        result.negative = a.negative;
+    } else {
+        result.smallNumerator = right - left;
+        result.negative = negativeB;
+    }
+    result.smallDenominator = denominator;
+    result.reduced = denominator == 1;
+    return true;
+}
+
+/* a / b + c / d for two fractions in lowest terms, the way knuth does it:
+with g = gcd(b, d), t = a (d / g) + c (b / g) shares no factor with b d / g
+that it does not share with g, so the result is t / gcd(t, g) over what is
+left of the denominator. Both gcds are on numbers no larger than the terms */
+Rational Rational::sumLarge(const Rational &a, const Rational &b, bool negativeB) {
+    Natural aDenominator = a.denominator();
+    Natural bDenominator = b.denominator();
+    Natural shared = isOne(aDenominator) || isOne(bDenominator)
+                     ? Natural(1) : greatestCommonDivisor(aDenominator, bDenominator);
+    if(!isOne(shared)) {
+        aDenominator = quotient(aDenominator, shared);
+        bDenominator = quotient(bDenominator, shared);
+    }
+    Natural left = Natural::multiply(a.numerator(), bDenominator);
+    Natural right = Natural::multiply(b.numerator(), aDenominator);
+
+    Rational result;
+    Natural numerator;
+    if(a.negative == negativeB) {
+        numerator = Natural::add(left, right);
+        result.negative = a.negative;
+    } else if(Natural::compare(left, right) >= 0) {
+        numerator = Natural::subtract(left, right);
+        result.negative = a.negative;
+    } else {
+        numerator = Natural::subtract(right, left);
+        result.negative = negativeB;
+    }
+    if(numerator.isZero())
+        return Rational();
+    Natural denominator = Natural::multiply(aDenominator, bDenominator);
+    if(!isOne(shared)) {
+        Natural divisor = greatestCommonDivisor(numerator, shared);
+        if(!isOne(divisor)) {
+            numerator = quotient(numerator, divisor);
+            shared = quotient(shared, divisor);
+        }
+        denominator = Natural::multiply(denominator, shared);
+    }
+    result.setTerms(std::move(numerator), std::move(denominator));
+    return result;
+}
+
+// function is invoked to multiply, the same way sum() adds
+Rational Rational::multiply(const Rational &a, const Rational &b) {
+    Rational result;
+    if(!a.big && !b.big && productSmall(a, b, result))
+        return result;
+    if(a.reduced && b.reduced && (a.big || b.big))
+        return productLarge(a, b);
+    Rational left(a);
+    Rational right(b);
+    left.reduce();
+    right.reduce();
+    // what is in lowest terms on its own may still cancel across, like 3 / 4 × 8 / 9
+    if(!left.big && !right.big) {
+        std::uint64_t across = greatestCommonDivisor(left.smallNumerator, right.smallDenominator);
+        left.smallNumerator /= across;
+        right.smallDenominator /= across;
+        across = greatestCommonDivisor(right.smallNumerator, left.smallDenominator);
+        right.smallNumerator /= across;
+        left.smallDenominator /= across;
+        if(productSmall(left, right, result)) {
+            result.reduced = true;
+            return result;
+        }
+    }
+    return productLarge(left, right);
+}
+
+bool Rational::productSmall(const Rational &a, const Rational &b, Rational &result) {
+    if(multiplyOverflows(a.smallNumerator, b.smallNumerator, result.smallNumerator)
+       || multiplyOverflows(a.smallDenominator, b.smallDenominator, result.smallDenominator))
+        return false;
+    result.negative = a.negative != b.negative;
+    result.reduced = result.smallDenominator == 1;
+    return true;
+}
+
+// the product of two fractions in lowest terms, cancelling across first so that it comes out in lowest terms too
+Rational Rational::productLarge(const Rational &a, const Rational &b) {
+    Natural aNumerator = a.numerator();
+    Natural aDenominator = a.denominator();
+    Natural bNumerator = b.numerator();
+    Natural bDenominator = b.denominator();
+    cancel(aNumerator, bDenominator);
+    cancel(bNumerator, aDenominator);
+
+    Rational result;
+    result.setTerms(Natural::multiply(aNumerator, bNumerator), Natural::multiply(aDenominator, bDenominator));
+    result.negative = a.negative != b.negative;
+    return result;
+}
+
+// function is invoked to raise to a whole power, which leaves a fraction in lowest terms as it is
+Rational Rational::power(const Rational &base, std::uint64_t exponent) {
+    Rational value(base);
+    value.reduce();
+    Natural numerator(1);
+    Natural denominator(1);
+    Natural numeratorSquare = value.numerator();
+    Natural denominatorSquare = value.denominator();
+    // the terms grow with every step that led to the base, multiplied out they would outgrow any use
+    std::size_t bits = std::max(numeratorSquare.bitLength(), denominatorSquare.bitLength());
+    if(exponent > 1 && bits > MaxExactPowerBits / exponent)
+        cutTerms(numeratorSquare, denominatorSquare);
+    for(std::uint64_t remaining = exponent; remaining; remaining >>= 1) {
+        if(remaining & 1) {
+            numerator = Natural::multiply(numerator, numeratorSquare);
+            denominator = Natural::multiply(denominator, denominatorSquare);
+        }
+        if(remaining > 1) {
+            numeratorSquare = Natural::multiply(numeratorSquare, numeratorSquare);
+            denominatorSquare = Natural::multiply(denominatorSquare, denominatorSquare);
+        }
+    }
+
+    Rational result;
+    result.setTerms(std::move(numerator), std::move(denominator));
+    result.negative = value.negative && (exponent & 1);
+    return result;
+}
+
+// function is invoked to divide, which is multiplying by b turned upside down
+bool Rational::divide(const Rational &a, const Rational &b, Rational &quotient) {
+    if(b.isZero())
+        return false;
+    Rational inverse;
+    inverse.negative = b.negative;
+    inverse.reduced = b.reduced;
+    if(b.big) {
+        inverse.big = true;
+        inverse.bigNumerator = b.bigDenominator;
+        inverse.bigDenominator = b.bigNumerator;
+    } else {
+        inverse.smallNumerator = b.smallDenominator;
+        inverse.smallDenominator = b.smallNumerator;
+    }
+    quotient = multiply(a, inverse);
+    return true;
+}
+
+Rational Rational::hundredth() const {
+    Rational result;
+    divide(*this, Rational(100), result);
+    return result;
+}
+
+// function is invoked to bring the fraction to lowest terms, and back to 64 bits if it fits there then
+void Rational::reduce() {
+    if(reduced)
+        return;
+    reduced = true;
+    if(!big) {
+        std::uint64_t divisor = greatestCommonDivisor(smallNumerator, smallDenominator);
+        smallNumerator /= divisor;
+        smallDenominator /= divisor;
+        return;
+    }
+    Natural numerator = std::move(bigNumerator);
+    Natural denominator = std::move(bigDenominator);
+    cancel(numerator, denominator);
+    setTerms(std::move(numerator), std::move(denominator));
+}
+
+// keeps the terms in 64 bits if they both fit there
+void Rational::setTerms(Natural numerator, Natural denominator) {
+    big = !numerator.fitsIn64() || !denominator.fitsIn64();
+    if(big) {
+        bigNumerator = std::move(numerator);
+        bigDenominator = std::move(denominator);
+        return;
+    }
+    smallNumerator = numerator.low64();
+    smallDenominator = denominator.low64();
+    bigNumerator = Natural();
+    bigDenominator = Natural();
+}
+
+Natural Rational::numerator() const {
+    return big ? bigNumerator : Natural(smallNumerator);
+}
+
+Natural Rational::denominator() const {
+    return big ? bigDenominator : Natural(smallDenominator);
+}
+
+// function is invoked to write the value for the display, the only place it becomes a decimal
+std::string Rational::toString(std::size_t maxLength) const {
+    Rational value(*this);
+    value.reduce();
+    // one digit more than the display could hold, so the decimal is always rounded by the display
+    return decimalQuotient(value.numerator(), value.denominator(), value.isNegative(), maxLength + 1)
+        .toString(maxLength);
+}
+
+double Rational::toDouble() const {
+    if(!big && smallNumerator <= MaxExactDouble && smallDenominator <= MaxExactDouble) {
+        double value = double(smallNumerator) / double(smallDenominator);
+        return isNegative() ? -value : value;
+    }
+    Rational value(*this);
+    value.reduce();
+    return decimalQuotient(value.numerator(), value.denominator(), value.isNegative(), RoundedDigits).toDouble();
+}
@@ -0,0 +1,73 @@
+#ifndef RATIONAL_H
+#define RATIONAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "bignum.h"
+
+/* an exact fraction, numerator / denominator. While both fit in 64 bits they
+are plain integers and every operation is a few multiplications with an
+overflow check; only a result that overflows is worked out again with
+Naturals, which take their limbs from the per-thread pool once they outgrow
+the object. Small fractions are not reduced after every step, only when a
+result would overflow, when the value is written out, or when its exact
+terms are needed. Large ones are kept in lowest terms, by cancelling the
+operands against each other before they are combined, so that they drop back
+to 64 bits as soon as they can */
+class Rational
+{
+public:
+    Rational();
+    Rational(std::int64_t value);
+
+    // reads [-]digits[.digits][e[+|-]digits], returns false if text is not a number
+    static bool parse(const char *text, std::size_t length, Rational &value);
+
+    bool isZero() const { return big ? bigNumerator.isZero() : smallNumerator == 0; }
+    bool isNegative() const { return negative && !isZero(); }
+    // returns true and sets n if the value is a whole number no further from 0 than limit
+    bool toInteger(std::int64_t limit, std::int64_t &n) const;
+
+    Rational operator-() const;
+    static Rational add(const Rational &a, const Rational &b);
+    static Rational subtract(const Rational &a, const Rational &b);
+    static Rational multiply(const Rational &a, const Rational &b);
+    // returns false if b is zero
+    static bool divide(const Rational &a, const Rational &b, Rational &quotient);
+    Rational hundredth() const;
+    // base to a whole power, without a gcd: the terms of a fraction in lowest terms have none in common to any power.
+    // A base whose terms would multiply out past 2^18 bits is cut to 40 digits first, and the power is not exact
+    static Rational power(const Rational &base, std::uint64_t exponent);
+
+    // brings the fraction to lowest terms
+    void reduce();
+    // the terms as they are kept, only in lowest terms after reduce(), the sign is apart from them
+    Natural numerator() const;
+    Natural denominator() const;
+
+    // written as a decimal in at most maxLength characters, a fraction that has no end rounded to what fits
+    std::string toString(std::size_t maxLength) const;
+    double toDouble() const;
+
+private:
+    // a + b with b taken as negative or not, whatever its own sign
+    static Rational sum(const Rational &a, const Rational &b, bool negativeB);
+    static bool sumSmall(const Rational &a, const Rational &b, bool negativeB, Rational &result);
+    static Rational sumLarge(const Rational &a, const Rational &b, bool negativeB);
+    static bool productSmall(const Rational &a, const Rational &b, Rational &result);
+    static Rational productLarge(const Rational &a, const Rational &b);
+    void setTerms(Natural numerator, Natural denominator);
+
+    // the terms while they fit in 64 bits, the Naturals are empty then
+    std::uint64_t smallNumerator;
+    std::uint64_t smallDenominator;
+    Natural bigNumerator;
+    Natural bigDenominator;
+    bool negative;
+    bool big;
+    // known to be in lowest terms
+    bool reduced;
+};
+
+#endif // RATIONAL_H
@@ -0,0 +1,324 @@
+#include "resultcache.h"
+#include "expression.h"
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+// scatters the bits of x over the whole word, so that the top bits pick a shard evenly
+static std::uint64_t mix(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// hashes bytes eight at a time
+static std::uint64_t hashBytes(const char *data, std::size_t length) {
+    std::uint64_t hash = length * 0x9e3779b97f4a7c15ULL;
+    while(length >= 8) {
+        std::uint64_t word;
+        std::memcpy(&word, data, 8);
+        hash = (hash ^ mix(word)) * 0xff51afd7ed558ccdULL;
+        data += 8;
+        length -= 8;
+    }
+    std::uint64_t last = 0;
+    std::memcpy(&last, data, length);
+    return mix(hash ^ last);
+}
+
+static bool isCommutative(Operator op) {
+    return op == Operator::Add || op == Operator::Multiply;
+}
+
+// the first byte of every node, operators use their ASCII symbol, functions are followed by theirs
+static char nodeTag(const Node &node) {
+    switch(node.kind) {
+    case Node::Constant:
+        return 'c';
+    case Node::Negate:
+        return 'n';
+    case Node::Percent:
+        return '%';
+    case Node::Function:
+        return 'f';
+    case Node::Binary:
+        switch(node.op) {
+        case Operator::Add:
+            return '+';
+        case Operator::Subtract:
+            return '-';
+        case Operator::Multiply:
+            return '*';
+        case Operator::Divide:
+            return '/';
+        case Operator::Power:
+            return '^';
+        default:
+            break;
+        }
+        break;
+    default:
+        break;
+    }
+    return '?';
+}
+
+bool CanonicalExpression::build(const Expression &expression) {
+    if(expression.rootNode() < 0 || !expression.variableNames().empty())
+        return false;
+    source = &expression;
+    std::size_t count = expression.nodeList().size();
+    hashes.resize(count);
+    operators.resize(count);
+    starts.resize(count);
+    ends.resize(count);
+    bytes.clear();
+
+    hashNode(expression.rootNode());
+    writeNode(expression.rootNode());
+    return true;
+}
+
+// works out the hash of every node below index, the children first
+std::uint64_t CanonicalExpression::hashNode(int index) {
+    const Node &node = source->nodeList()[std::size_t(index)];
+    std::uint64_t tag = (std::uint64_t(std::uint8_t(nodeTag(node))) | std::uint64_t(node.function) << 8) * 0x9e3779b97f4a7c15ULL;
+    std::uint64_t hash;
+    int count = 0;
+
+    if(node.kind == Node::Constant) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &node.value, sizeof(bits));
+        hash = mix(bits ^ tag);
+    } else if(node.kind == Node::Binary) {
+        std::uint64_t left = hashNode(node.left);
+        std::uint64_t right = hashNode(node.right);
+        if(isCommutative(node.op) && right < left)
+            std::swap(left, right);
+        hash = mix(mix(left ^ tag) + right);
+        count = 1 + operators[std::size_t(node.left)] + operators[std::size_t(node.right)];
+    } else if(node.kind == Node::Function) {
+        // a function takes longer than any operator, so it counts as one at least
+        hash = mix(hashNode(node.left) ^ tag);
+        count = 1 + operators[std::size_t(node.left)];
+    } else {
+        hash = mix(hashNode(node.left) ^ tag);
+        count = operators[std::size_t(node.left)];
+    }
+
+    hashes[std::size_t(index)] = hash;
+    operators[std::size_t(index)] = count;
+    return hash;
+}
+
+// writes a node in prefix order, so that every node below it is a piece of its bytes
+void CanonicalExpression::writeNode(int index) {
+    const Node &node = source->nodeList()[std::size_t(index)];
+    starts[std::size_t(index)] = bytes.size();
+    bytes.push_back(nodeTag(node));
+    if(node.kind == Node::Function)
+        bytes.push_back(char(node.function));
+
+    if(node.kind == Node::Constant) {
+        char bits[sizeof(double)];
+        std::memcpy(bits, &node.value, sizeof(bits));
+        bytes.append(bits, sizeof(bits));
+    } else if(node.kind == Node::Binary) {
+        int first = node.left, second = node.right;
+        if(isCommutative(node.op) && hashes[std::size_t(second)] < hashes[std::size_t(first)])
+            std::swap(first, second);
+        writeNode(first);
+        writeNode(second);
+    } else {
+        writeNode(node.left);
+    }
+
+    ends[std::size_t(index)] = bytes.size();
+}
+
+CacheKey CanonicalExpression::key(int node) const {
+    std::size_t start = starts[std::size_t(node)];
+    return {hashes[std::size_t(node)], bytes.data() + start, ends[std::size_t(node)] - start};
+}
+
+/* lineKey() leaves out spaces, except for one where leaving them out could
+read the line another way: where they keep two numbers or names apart, or 1e +5
+from the number 1e+5. What it has to remember is what kind of character it
+wrote last and whether spaces came after it, which is a state, and for each
+state and byte the next state and what to write is in a table */
+class SpaceSteps
+{
+public:
+    enum {
+        // the kinds of character last written
+        Other, Word, Exponent, Sign, ExponentSign, KindCount,
+        // added to the kind if spaces came after it
+        Spaced = KindCount,
+        StateCount = 2 * KindCount,
+        // set in a step if the byte is written, and if a space is written ahead of it
+        Writes = 16, Separates = 32
+    };
+
+    SpaceSteps() {
+        for(int state = 0; state < StateCount; state++) {
+            for(int c = 0; c < 256; c++)
+                steps[state][c] = step(state % KindCount, state >= Spaced, c);
+        }
+    }
+
+    unsigned char next(unsigned state, unsigned char c) const { return steps[state][c]; }
+
+private:
+    // a character that goes on a number or a name, bytes of utf-8 symbols included so that a space never joins two of them
+    static bool isWordCharacter(int c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '.'
+               || c >= 0x80;
+    }
+
+    static unsigned char step(int last, bool spaced, int c) {
+        if(c == ' ' || c == '\t' || c == '\r')
+            return static_cast<unsigned char>(last + Spaced);
+        bool word = isWordCharacter(c), sign = c == '+' || c == '-';
+        bool joins = ((last == Word || last == Exponent) && word) || (last == Exponent && sign)
+                     || (last == ExponentSign && c >= '0' && c <= '9');
+        int kind = Other;
+        if(word)
+            kind = c == 'e' || c == 'E' ? Exponent : Word;
+        else if(sign)
+            kind = last == Exponent ? ExponentSign : Sign;
+        return static_cast<unsigned char>(kind | Writes | (spaced && joins ? Separates : 0));
+    }
+
+    unsigned char steps[StateCount][256];
+};
+
+static const SpaceSteps spaceSteps;
+
+CacheKey lineKey(const char *begin, const char *end, std::string &buffer) {
+    // no key of a parsed expression starts with a tab, which a line without spaces cannot have either
+    buffer.resize(2 * std::size_t(end - begin) + 1);
+    char *out = &buffer[0];
+    *out++ = '\t';
+    // every byte is written, a space ahead of it too, and kept by moving past them, without a branch on the text
+    unsigned state = SpaceSteps::Other;
+    for(const char *p = begin; p != end; p++) {
+        unsigned step = spaceSteps.next(state, static_cast<unsigned char>(*p));
+        unsigned separates = step / SpaceSteps::Separates;
+        out[0] = ' ';
+        out[separates] = *p;
+        out += separates + (step / SpaceSteps::Writes & 1);
+        state = step % SpaceSteps::Writes;
+    }
+    buffer.resize(std::size_t(out - buffer.data()));
+    return {hashBytes(buffer.data(), buffer.size()), buffer.data(), buffer.size()};
+}
+
+// defines the class of ResultCache
+ResultCache::ResultCache(std::size_t capacity, EvictionPolicy evictionPolicy)
+    : shards(new Shard[ShardCount]),
+      shardCapacity((capacity + ShardCount - 1) / ShardCount),
+      policy(evictionPolicy)
+{
+}
+
+ResultCache::~ResultCache() = default;
+
+std::list<ResultCache::Entry>::iterator ResultCache::lookup(Shard &shard, const CacheKey &key) {
+    auto range = shard.index.equal_range(key.hash);
+    for(auto it = range.first; it != range.second; ++it) {
+        const std::string &stored = it->second->key;
+        if(stored.size() == key.length && std::memcmp(stored.data(), key.data, key.length) == 0)
+            return it->second;
+    }
+    return shard.entries.end();
+}
+
+bool ResultCache::find(const CacheKey &key, double &value, bool &valid) {
+    Shard &shard = shardOf(key.hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto entry = lookup(shard, key);
+    if(entry == shard.entries.end()) {
+        shard.counters.misses++;
+        return false;
+    }
+    shard.counters.hits++;
+    // a result that is used again is evicted last, unless the oldest goes first anyway
+    if(policy == EvictionPolicy::LeastRecentlyUsed && entry != shard.entries.begin())
+        shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+    value = entry->value;
+    valid = entry->valid;
+    return true;
+}
+
+void ResultCache::insert(const CacheKey &key, double value, bool valid) {
+    if(shardCapacity == 0)
+        return;
+    Shard &shard = shardOf(key.hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // another thread may have worked out the same result in the meantime
+    if(lookup(shard, key) != shard.entries.end())
+        return;
+
+    if(shard.entries.size() >= shardCapacity) {
+        // the evicted entry is reused, which saves freeing and allocating it again
+        auto last = std::prev(shard.entries.end());
+        auto range = shard.index.equal_range(last->hash);
+        for(auto it = range.first; it != range.second; ++it) {
+            if(it->second == last) {
+                shard.index.erase(it);
+                break;
+            }
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, last);
+        shard.counters.evictions++;
+    } else {
+        shard.entries.emplace_front();
+    }
+
+    Entry &entry = shard.entries.front();
+    entry.key.assign(key.data, key.length);
+    entry.hash = key.hash;
+    entry.value = value;
+    entry.valid = valid;
+    shard.index.emplace(key.hash, shard.entries.begin());
+    shard.counters.insertions++;
+}
+
+CacheStatistics ResultCache::statistics() const {
+    CacheStatistics total;
+    for(std::size_t i = 0; i < ShardCount; i++) {
+        Shard &shard = shards[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total.hits += shard.counters.hits;
+        total.misses += shard.counters.misses;
+        total.insertions += shard.counters.insertions;
+        total.evictions += shard.counters.evictions;
+        total.entries += shard.entries.size();
+    }
+    return total;
+}
+
+std::string ResultCache::report() const {
+    CacheStatistics total = statistics();
+    std::uint64_t lookups = total.hits + total.misses;
+    char line[192];
+    std::snprintf(line, sizeof(line), "%llu hits, %llu misses (%.1f%% hit), %llu insertions, %llu evictions, %zu entries\n",
+                  (unsigned long long)total.hits, (unsigned long long)total.misses,
+                  lookups ? 100.0 * double(total.hits) / double(lookups) : 0.0,
+                  (unsigned long long)total.insertions, (unsigned long long)total.evictions, total.entries);
+    return line;
+}
+
+bool readEvictionPolicy(const char *text, EvictionPolicy &policy) {
+    if(std::strcmp(text, "lru") == 0)
+        policy = EvictionPolicy::LeastRecentlyUsed;
+    else if(std::strcmp(text, "fifo") == 0)
+        policy = EvictionPolicy::FirstInFirstOut;
+    else
+        return false;
+    return true;
+}
@@ -0,0 +1,125 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Expression;
+
+// what a cached result is looked up by, the bytes are compared whenever the hashes match
+struct CacheKey {
+    std::uint64_t hash;
+    const char *data;
+    std::size_t length;
+};
+
+/* the keys of an expression without variables and of every part of it. Spaces,
+brackets and the way a number was written do not change a key, and the two
+operands of + and × are put in a fixed order, which does not change the result
+either since a + b and b + a are the same double. Sums of three or more are not
+regrouped, that would change how they round */
+class CanonicalExpression
+{
+public:
+    // returns false if the expression has variables, whose value the text does not decide
+    bool build(const Expression &expression);
+
+    CacheKey key(int node) const;
+    // the number of operators in a node and below it
+    int operatorCount(int node) const { return operators[std::size_t(node)]; }
+
+private:
+    std::uint64_t hashNode(int index);
+    void writeNode(int index);
+
+    const Expression *source = nullptr;
+    std::vector<std::uint64_t> hashes;
+    std::vector<int> operators;
+    // where the bytes of each node start and end, every node is written once
+    std::vector<std::size_t> starts, ends;
+    std::string bytes;
+};
+
+/* the key of a line of text as it was typed, only without the spaces that do
+not change how it is read, which is quicker to work out than parsing the line.
+1 + 2 and 1+2 have the same key, 1 2 and 12 do not. It is written into
+buffer, and never equals the key of a parsed expression */
+CacheKey lineKey(const char *begin, const char *end, std::string &buffer);
+
+enum class EvictionPolicy : unsigned char {
+    LeastRecentlyUsed,
+    FirstInFirstOut
+};
+
+struct CacheStatistics {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t insertions = 0;
+    std::uint64_t evictions = 0;
+    std::size_t entries = 0;
+};
+
+/* results of expressions, kept by their canonical key and shared by every
+thread. It is split into shards with a lock each, so threads rarely wait for
+one another, and every shard evicts on its own once it holds its share of the
+capacity. A result that divides by zero is kept too */
+class ResultCache
+{
+public:
+    explicit ResultCache(std::size_t capacity, EvictionPolicy policy = EvictionPolicy::LeastRecentlyUsed);
+    ~ResultCache();
+
+    ResultCache(const ResultCache &) = delete;
+    ResultCache &operator=(const ResultCache &) = delete;
+
+    // returns false if the key has no result yet, valid is false for a division by zero
+    bool find(const CacheKey &key, double &value, bool &valid);
+    void insert(const CacheKey &key, double value, bool valid);
+
+    // the counters of every shard added up
+    CacheStatistics statistics() const;
+    // one line with the counters and how many lookups hit
+    std::string report() const;
+    EvictionPolicy evictionPolicy() const { return policy; }
+
+    enum { ShardCount = 16 };
+
+private:
+    struct Entry {
+        std::string key;
+        std::uint64_t hash;
+        double value;
+        bool valid;
+    };
+    // the hashes are already mixed, the map does not need to mix them again
+    struct KeyHash {
+        std::size_t operator()(std::uint64_t hash) const { return std::size_t(hash); }
+    };
+    // the front of the list is evicted last
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::list<Entry> entries;
+        std::unordered_multimap<std::uint64_t, std::list<Entry>::iterator, KeyHash> index;
+        CacheStatistics counters;
+    };
+
+    Shard &shardOf(std::uint64_t hash) const { return shards[hash >> 60]; }
+    static std::list<Entry>::iterator lookup(Shard &shard, const CacheKey &key);
+
+    std::unique_ptr<Shard[]> shards;
+    std::size_t shardCapacity;
+    EvictionPolicy policy;
+};
+
+static_assert(ResultCache::ShardCount == 16, "shardOf() takes the top four bits of the hash");
+
+// reads lru or fifo
+bool readEvictionPolicy(const char *text, EvictionPolicy &policy);
+
+#endif // RESULTCACHE_H
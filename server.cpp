@@ -0,0 +1,457 @@
+#include "evaluator.h"
+#include "resultcache.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* calc-server answers expressions sent over a Unix domain socket, one per
+line, with one result per line in the same order, exactly like calc-batch.
+Clients can send as many lines as they like without waiting for the answers.
+One thread reads every connection and hands whatever whole lines have arrived
+to the workers as one batch. The workers never touch a socket: they queue the
+text they evaluated a batch into on its connection, and the same thread writes
+it out, in order, as fast as the client reads it, so a client that stops
+reading only ever holds up itself */
+
+// how much is read from a connection at once, and how much is gathered into one batch at most
+static const std::size_t ReadBytes = 1 << 14;
+static const std::size_t BatchBytes = 1 << 18;
+/* a line longer than this is answered with error without being read. A line
+this long takes a worker a few milliseconds, 1 MB about 50, so one line cannot
+hold a worker up for long, and only this much of it is ever kept */
+static const std::size_t MaxLineBytes = 1 << 16;
+// a connection with this many batches read and not yet written is not read until one of them is written
+static const unsigned MaxBatchesInFlight = 8;
+
+struct Batch;
+
+// one client, shared by the reading thread and the batches it has in flight
+struct Connection {
+    explicit Connection(int socketDescriptor)
+        : socket(socketDescriptor), skipping(false), reading(true), nextBatch(0), inFlight(0), unsentOffset(0),
+          nextWrite(0)
+    {
+    }
+    // a connection the client stopped sending on is dropped once the last answer is written
+    ~Connection() { ::close(socket); }
+
+    int socket;
+
+    // only used by the reading thread: what has been read after the last newline,
+    // and whether the rest of a line too long to answer is being thrown away
+    std::string pending;
+    bool skipping;
+    bool reading;
+    std::uint64_t nextBatch;
+    // the batches read and not yet written
+    unsigned inFlight;
+    // the answers being written, and how much of the first has been written already
+    std::deque<std::unique_ptr<Batch>> unsent;
+    std::size_t unsentOffset;
+
+    // the batches answered out of order wait in finished until the ones before them are
+    // answered, then in answered until the reading thread takes them over
+    std::mutex mutex;
+    std::uint64_t nextWrite;
+    std::map<std::uint64_t, std::unique_ptr<Batch>> finished;
+    std::vector<std::unique_ptr<Batch>> answered;
+};
+
+// whole lines read from one connection at once, and their answers
+struct Batch {
+    // only set until the batch is answered, the connection keeps it from then on
+    std::shared_ptr<Connection> connection;
+    std::uint64_t sequence;
+    std::string requests;
+    std::string responses;
+};
+
+// the batches waiting for a worker
+class BatchQueue
+{
+public:
+    void push(std::unique_ptr<Batch> batch) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            batches.push_back(std::move(batch));
+        }
+        ready.notify_one();
+    }
+
+    // waits for a batch, returns false once the queue is stopped
+    bool pop(std::unique_ptr<Batch> &batch) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return stopped || !batches.empty(); });
+        if(stopped)
+            return false;
+        batch = std::move(batches.front());
+        batches.pop_front();
+        return true;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        ready.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::unique_ptr<Batch>> batches;
+    bool stopped = false;
+};
+
+// the reading thread sleeps in poll() until a byte arrives here, from a worker or a signal
+static int wakeRead = -1, wakeWrite = -1;
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void wake() {
+    char byte = 0;
+    // a full pipe already wakes the reading thread, so a failed write does not matter
+    ssize_t ignored = ::write(wakeWrite, &byte, 1);
+    (void)ignored;
+}
+
+static void stopSignal(int) {
+    stopRequested = 1;
+    wake();
+}
+
+// queues an answered batch, and the ones after it that were waiting for it, to be written in the order they were read
+static void answerInOrder(std::unique_ptr<Batch> batch) {
+    std::shared_ptr<Connection> connection = std::move(batch->connection);
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    if(batch->sequence != connection->nextWrite) {
+        connection->finished.emplace(batch->sequence, std::move(batch));
+        return;
+    }
+
+    // the reading thread takes every answer queued at once, so only the first one needs to wake it
+    bool idle = connection->answered.empty();
+    connection->answered.push_back(std::move(batch));
+    connection->nextWrite++;
+    auto waiting = connection->finished.begin();
+    while(waiting != connection->finished.end() && waiting->first == connection->nextWrite) {
+        connection->answered.push_back(std::move(waiting->second));
+        waiting = connection->finished.erase(waiting);
+        connection->nextWrite++;
+    }
+    if(idle)
+        wake();
+}
+
+// every worker keeps an evaluator of its own for as long as it runs
+static void work(BatchQueue *queue, ResultCache *cache, int partOperators, unsigned long jitThreshold) {
+    LineEvaluator evaluator;
+    evaluator.setCache(cache, partOperators);
+    evaluator.setJitThreshold(jitThreshold);
+    std::unique_ptr<Batch> batch;
+    while(queue->pop(batch)) {
+        batch->responses.reserve(batch->requests.size());
+        const char *line = batch->requests.data();
+        const char *end = line + batch->requests.size();
+        while(line != end) {
+            const char *lineEnd = static_cast<const char *>(std::memchr(line, '\n', std::size_t(end - line)));
+            const char *next = lineEnd ? lineEnd + 1 : end;
+            // a line too long is cut short while it is read, and not even looked at here
+            if(std::size_t((lineEnd ? lineEnd : end) - line) > MaxLineBytes)
+                batch->responses.append("error\n");
+            else
+                evaluator.evaluateLines(line, next, batch->responses);
+            line = next;
+        }
+        answerInOrder(std::move(batch));
+    }
+}
+
+// hands the whole lines read so far to the workers, the unfinished one stays behind
+static void queueLines(const std::shared_ptr<Connection> &connection, std::size_t complete, BatchQueue &queue) {
+    std::unique_ptr<Batch> batch(new Batch);
+    batch->connection = connection;
+    batch->sequence = connection->nextBatch++;
+    // the batch takes the buffer over, only the unfinished line is copied out of it
+    batch->requests.swap(connection->pending);
+    connection->pending.assign(batch->requests, complete, std::string::npos);
+    batch->requests.resize(complete);
+    connection->inFlight++;
+    queue.push(std::move(batch));
+}
+
+// reads whatever has arrived, returns false once the connection is done with
+static bool readRequests(const std::shared_ptr<Connection> &connection, BatchQueue &queue) {
+    std::string &pending = connection->pending;
+    bool open = true;
+    const std::size_t unfinished = pending.size();
+    const std::size_t limit = pending.size() + BatchBytes;
+    while(pending.size() < limit) {
+        std::size_t old = pending.size();
+        pending.resize(old + ReadBytes);
+        ssize_t got = ::recv(connection->socket, &pending[old], ReadBytes, MSG_DONTWAIT);
+        pending.resize(old + std::size_t(got > 0 ? got : 0));
+        if(got > 0)
+            continue;
+        if(got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+            open = false;
+        break;
+    }
+
+    // the rest of a line too long to answer only has to end
+    if(connection->skipping) {
+        std::size_t lineEnd = pending.find('\n', unfinished);
+        pending.erase(unfinished, lineEnd == std::string::npos ? std::string::npos : lineEnd - unfinished);
+        connection->skipping = lineEnd == std::string::npos;
+    }
+
+    std::size_t complete = pending.size();
+    while(complete > 0 && pending[complete - 1] != '\n')
+        complete--;
+    // the last line may not end with a newline
+    if(!open && complete < pending.size())
+        complete = pending.size();
+    if(complete)
+        queueLines(connection, complete, queue);
+    // what is kept of a line too long is still too long, so that the line is answered with error
+    if(pending.size() > MaxLineBytes) {
+        pending.resize(MaxLineBytes + 1);
+        connection->skipping = true;
+    }
+    return open;
+}
+
+// writes what the workers have answered without waiting for the client, returns false if it went away
+static bool writeAnswers(Connection &connection) {
+    {
+        std::lock_guard<std::mutex> lock(connection.mutex);
+        for(std::unique_ptr<Batch> &batch : connection.answered)
+            connection.unsent.push_back(std::move(batch));
+        connection.answered.clear();
+    }
+
+    while(!connection.unsent.empty()) {
+        // all of them go out in one call, straight from where they were evaluated into
+        iovec parts[MaxBatchesInFlight];
+        int count = 0;
+        for(const std::unique_ptr<Batch> &batch : connection.unsent) {
+            if(count == int(MaxBatchesInFlight))
+                break;
+            parts[count].iov_base = const_cast<char *>(batch->responses.data());
+            parts[count].iov_len = batch->responses.size();
+            count++;
+        }
+        parts[0].iov_base = static_cast<char *>(parts[0].iov_base) + connection.unsentOffset;
+        parts[0].iov_len -= connection.unsentOffset;
+
+        ssize_t written = ::writev(connection.socket, parts, count);
+        if(written < 0) {
+            if(errno == EINTR)
+                continue;
+            // a client that does not read is written to again once it has room
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        // drop what was written, which may end in the middle of a batch
+        std::size_t done = connection.unsentOffset + std::size_t(written);
+        while(!connection.unsent.empty() && done >= connection.unsent.front()->responses.size()) {
+            done -= connection.unsent.front()->responses.size();
+            connection.unsent.pop_front();
+            connection.inFlight--;
+        }
+        connection.unsentOffset = done;
+    }
+    return true;
+}
+
+// creates the socket clients connect to, replacing one left behind by an earlier run
+static int listenAt(const char *path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(std::strlen(path) >= sizeof(address.sun_path)) {
+        std::fprintf(stderr, "calc-server: %s is too long for a socket path\n", path);
+        return -1;
+    }
+    std::strcpy(address.sun_path, path);
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener < 0) {
+        std::perror("calc-server: socket");
+        return -1;
+    }
+    ::unlink(path);
+    if(::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || ::listen(listener, 128) < 0) {
+        std::fprintf(stderr, "calc-server: cannot listen on %s: %s\n", path, std::strerror(errno));
+        ::close(listener);
+        return -1;
+    }
+    ::fcntl(listener, F_SETFL, ::fcntl(listener, F_GETFL) | O_NONBLOCK);
+    return listener;
+}
+
+// reads and writes every connection until a signal stops the server
+static void serve(int listener, BatchQueue &queue) {
+    std::vector<std::shared_ptr<Connection>> connections;
+    std::vector<pollfd> polled;
+    std::vector<std::size_t> polledConnections;
+
+    while(!stopRequested) {
+        polled.clear();
+        polledConnections.clear();
+        polled.push_back({wakeRead, POLLIN, 0});
+        polled.push_back({listener, POLLIN, 0});
+        for(std::size_t i = 0; i < connections.size(); i++) {
+            const Connection &connection = *connections[i];
+            short events = 0;
+            if(connection.reading && connection.inFlight < MaxBatchesInFlight)
+                events |= POLLIN;
+            if(!connection.unsent.empty())
+                events |= POLLOUT;
+            if(!events)
+                continue;
+            polled.push_back({connection.socket, events, 0});
+            polledConnections.push_back(i);
+        }
+
+        if(::poll(polled.data(), nfds_t(polled.size()), -1) < 0) {
+            if(errno == EINTR)
+                continue;
+            std::perror("calc-server: poll");
+            return;
+        }
+
+        if(polled[0].revents) {
+            char drained[64];
+            while(::read(wakeRead, drained, sizeof(drained)) > 0) {
+            }
+        }
+
+        for(std::size_t i = 0; i < polledConnections.size(); i++) {
+            Connection &connection = *connections[polledConnections[i]];
+            if(connection.reading && (polled[i + 2].revents & (POLLIN | POLLHUP | POLLERR)))
+                connection.reading = readRequests(connections[polledConnections[i]], queue);
+        }
+        // a connection is dropped once the client went away, or stopped sending and has every answer
+        for(std::shared_ptr<Connection> &connection : connections) {
+            if(!writeAnswers(*connection) || (!connection->reading && connection->inFlight == 0))
+                connection.reset();
+        }
+        connections.erase(std::remove(connections.begin(), connections.end(), nullptr), connections.end());
+
+        if(polled[1].revents) {
+            for(;;) {
+                int client = ::accept(listener, nullptr, nullptr);
+                if(client < 0)
+                    break;
+                // answers are written without waiting, whatever the listener passed on
+                ::fcntl(client, F_SETFL, ::fcntl(client, F_GETFL) | O_NONBLOCK);
+                connections.push_back(std::make_shared<Connection>(client));
+            }
+        }
+    }
+}
+
+static void usage() {
+    std::fprintf(stderr, "usage: calc-server [-j threads] [--cache entries [--eviction lru|fifo] [--cache-parts operators]]\n"
+                         "                  [--jit-threshold evaluations] socket\n"
+                         "answers expressions sent to a Unix domain socket, one per line, with\n"
+                         "one result per line, until interrupted. Without a cache, the programs\n"
+                         "of lines that come again are kept, and run as machine code once they\n"
+                         "have run that many times (0 never)\n");
+}
+
+// serves calculations to other programs on the same machine
+int main(int argc, char *argv[]) {
+    unsigned threads = std::thread::hardware_concurrency();
+    const char *path = nullptr;
+    std::size_t cacheEntries = 0;
+    EvictionPolicy eviction = EvictionPolicy::LeastRecentlyUsed;
+    int partOperators = 0;
+    unsigned long jitThreshold = Program::DefaultJitThreshold;
+
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = unsigned(std::atoi(argv[++i]));
+        } else if(std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cacheEntries = std::size_t(std::strtoull(argv[++i], nullptr, 10));
+        } else if(std::strcmp(argv[i], "--cache-parts") == 0 && i + 1 < argc) {
+            partOperators = std::atoi(argv[++i]);
+        } else if(std::strcmp(argv[i], "--eviction") == 0 && i + 1 < argc) {
+            if(!readEvictionPolicy(argv[++i], eviction)) {
+                usage();
+                return 2;
+            }
+        } else if(std::strcmp(argv[i], "--jit-threshold") == 0 && i + 1 < argc) {
+            jitThreshold = std::strtoul(argv[++i], nullptr, 10);
+        } else if(argv[i][0] == '-' || path) {
+            usage();
+            return 2;
+        } else {
+            path = argv[i];
+        }
+    }
+    if(!path) {
+        usage();
+        return 2;
+    }
+    if(threads == 0)
+        threads = 1;
+
+    int wakePipe[2];
+    if(::pipe(wakePipe) < 0) {
+        std::perror("calc-server: pipe");
+        return 1;
+    }
+    wakeRead = wakePipe[0];
+    wakeWrite = wakePipe[1];
+    ::fcntl(wakeRead, F_SETFL, O_NONBLOCK);
+    ::fcntl(wakeWrite, F_SETFL, O_NONBLOCK);
+
+    // a client that goes away makes a write fail instead of killing the server
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, stopSignal);
+    std::signal(SIGTERM, stopSignal);
+
+    int listener = listenAt(path);
+    if(listener < 0)
+        return 1;
+    std::fprintf(stderr, "calc-server: listening on %s with %u workers\n", path, threads);
+
+    // every worker looks up in the same cache, the requests of one client can help another
+    std::unique_ptr<ResultCache> cache;
+    if(cacheEntries)
+        cache.reset(new ResultCache(cacheEntries, eviction));
+
+    BatchQueue queue;
+    std::vector<std::thread> workers;
+    for(unsigned i = 0; i < threads; i++)
+        workers.emplace_back(work, &queue, cache.get(), partOperators, jitThreshold);
+
+    serve(listener, queue);
+
+    queue.stop();
+    for(std::thread &worker : workers)
+        worker.join();
+    ::close(listener);
+    ::unlink(path);
+    if(cache)
+        std::fprintf(stderr, "calc-server: cache %s", cache->report().c_str());
+    return 0;
+}
@@ -0,0 +1,365 @@
+#include "sessions.h"
+#include "engine.h"
+#include "functions.h"
+#include "numcodec.h"
+#include "workpool.h"
+#include <algorithm>
+#include <cstring>
+
+static int signOf(double value) {
+    return value > 0 ? 1 : value < 0 ? -1 : 0;
+}
+
+// function is invoked to add the keys of one session, which starts out cleared
+std::size_t SessionBatch::addSession(const Key *sessionKeys, std::size_t count) {
+    std::size_t session = sessionCount();
+    keys.insert(keys.end(), sessionKeys, sessionKeys + count);
+    keyStarts.push_back(keys.size());
+
+    bool bracketed = false;
+    for(std::size_t i = 0; i < count; i++)
+        bracketed |= sessionKeys[i] == Key::OpenBracket || sessionKeys[i] == Key::CloseBracket;
+    throughEngine.push_back(bracketed);
+    engineSessions += bracketed;
+
+    sumSoFar.push_back(0);
+    factorSoFar.push_back(0);
+    baseSoFar.push_back(0);
+    pendingAddOps.push_back(Operator::None);
+    pendingMultOps.push_back(Operator::None);
+    pendingPowerOps.push_back(Operator::None);
+    waitingForOperand.push_back(true);
+    operandInEntry.push_back(false);
+    finishedCounts.push_back(0);
+    displays.resize(displays.size() + DisplayStride);
+    displayLengths.push_back(0);
+    reset(session);
+    return session;
+}
+
+// function is invoked to run every session from the start, a block of sessions being one task of the pool
+void SessionBatch::run(unsigned threads) {
+    std::size_t blocks = (sessionCount() + BlockSessions - 1) / BlockSessions;
+    std::vector<std::size_t> tasks(blocks);
+    for(std::size_t i = 0; i < blocks; i++)
+        tasks[i] = i;
+    WorkStealingPool pool(unsigned(std::min<std::size_t>(threads ? threads : 1, blocks ? blocks : 1)));
+    pool.run(tasks, [this](std::size_t block, std::vector<std::size_t> &) {
+        std::size_t first = block * BlockSessions;
+        runBlock(first, std::min<std::size_t>(first + BlockSessions, sessionCount()));
+    });
+}
+
+/* presses the first key of every session in the block, then the second key of
+every one, and so on. The sessions of a block keep their state next to each
+other, so every step goes through the same few cache lines of every array */
+void SessionBatch::runBlock(std::size_t first, std::size_t last) {
+    std::size_t longest = 0;
+    for(std::size_t session = first; session < last; session++) {
+        if(throughEngine[session]) {
+            runFallback(session);
+            continue;
+        }
+        reset(session);
+        finishedCounts[session] = 0;
+        longest = std::max(longest, keyStarts[session + 1] - keyStarts[session]);
+    }
+
+    for(std::size_t step = 0; step < longest; step++) {
+        for(std::size_t session = first; session < last; session++) {
+            std::size_t key = keyStarts[session] + step;
+            if(key < keyStarts[session + 1] && !throughEngine[session])
+                press(session, keys[key]);
+        }
+    }
+}
+
+// runs a session with brackets through an Engine, keeping only what it displays and finished
+void SessionBatch::runFallback(std::size_t session) {
+    Engine engine;
+    for(std::size_t key = keyStarts[session]; key < keyStarts[session + 1]; key++)
+        engine.press(keys[key]);
+    setDisplay(session, engine.display().data(), engine.display().size());
+    finishedCounts[session] = engine.finishedCount();
+}
+
+std::string SessionBatch::display(std::size_t session) const {
+    return std::string(&displays[session * DisplayStride], displayLengths[session]);
+}
+
+// clears a session like clear all does, which leaves its finished entries counted
+void SessionBatch::reset(std::size_t session) {
+    sumSoFar[session] = 0;
+    factorSoFar[session] = 0;
+    baseSoFar[session] = 0;
+    pendingAddOps[session] = Operator::None;
+    pendingMultOps[session] = Operator::None;
+    pendingPowerOps[session] = Operator::None;
+    waitingForOperand[session] = true;
+    operandInEntry[session] = false;
+    setDisplay(session, "0", 1);
+}
+
+// presses one key in one session, every case doing what the Engine function of the key does
+void SessionBatch::press(std::size_t session, Key key) {
+    char *text = &displays[session * DisplayStride];
+    unsigned char &length = displayLengths[session];
+
+    if(isDigitKey(key)) {
+        int digitValue = keyDigit(key);
+        if(length == 1 && text[0] == '0' && digitValue == 0)
+            return;
+        if(waitingForOperand[session]) {
+            operandInEntry[session] = false;
+            length = 0;
+            waitingForOperand[session] = false;
+        }
+        if(length < Engine::MaxDisplayLength)
+            text[length++] = char('0' + digitValue);
+        return;
+    }
+
+    if(isFunctionKey(key)) {
+        operandInEntry[session] = true;
+        double value = displayValue(session);
+        if(!applyFunction(keyFunction(key), value)) {
+            abortOperation(session);
+            return;
+        }
+        setDisplay(session, value);
+        waitingForOperand[session] = true;
+        return;
+    }
+
+    switch(key) {
+    case Key::Point:
+        if(waitingForOperand[session]) {
+            operandInEntry[session] = false;
+            setDisplay(session, "0", 1);
+        }
+        if(!std::memchr(text, '.', length) && length < Engine::MaxDisplayLength)
+            text[length++] = '.';
+        waitingForOperand[session] = false;
+        break;
+    case Key::FlipSign: {
+        int sign = signOf(displayValue(session));
+        if(sign > 0) {
+            // the dash goes in front, pushing the last character out of a full display
+            std::size_t kept = std::min<std::size_t>(length, Engine::MaxDisplayLength - 1);
+            std::memmove(text + 1, text, kept);
+            text[0] = '-';
+            length = (unsigned char)(kept + 1);
+        } else if(sign < 0) {
+            std::memmove(text, text + 1, length - 1u);
+            length--;
+        }
+        operandInEntry[session] = false;
+        break;
+    }
+    case Key::Backspace:
+        if(waitingForOperand[session])
+            break;
+        if(--length == 0) {
+            setDisplay(session, "0", 1);
+            waitingForOperand[session] = true;
+        }
+        break;
+    case Key::Clear:
+        if(waitingForOperand[session])
+            break;
+        setDisplay(session, "0", 1);
+        waitingForOperand[session] = true;
+        break;
+    case Key::ClearAll:
+        reset(session);
+        break;
+    case Key::Add:
+    case Key::Subtract:
+        plusMinus(session, keyOperator(key));
+        break;
+    case Key::Multiply:
+    case Key::Divide:
+        multDiv(session, keyOperator(key));
+        break;
+    case Key::Power:
+        power(session);
+        break;
+    case Key::Equals:
+        equals(session);
+        break;
+    case Key::Percent:
+        operandInEntry[session] = true;
+        setDisplay(session, displayValue(session) / 100);
+        waitingForOperand[session] = true;
+        break;
+    default:
+        break;
+    }
+}
+
+// reads the displayed text as a double, anything that is not a number reads as 0
+double SessionBatch::displayValue(std::size_t session) const {
+    double value = 0;
+    const char *begin = &displays[session * DisplayStride];
+    const char *end = begin + displayLengths[session];
+    if(parseDouble(begin, end, value) != end || begin == end)
+        return 0;
+    return value;
+}
+
+void SessionBatch::setDisplay(std::size_t session, double value) {
+    char buffer[MaxDoubleText];
+    std::size_t length = std::size_t(formatDouble(buffer, value, Engine::MaxDisplayLength) - buffer);
+    setDisplay(session, buffer, length);
+}
+
+// sets the displayed text, cutting it down to the length the display can show
+void SessionBatch::setDisplay(std::size_t session, const char *text, std::size_t length) {
+    length = std::min<std::size_t>(length, Engine::MaxDisplayLength);
+    std::memcpy(&displays[session * DisplayStride], text, length);
+    displayLengths[session] = (unsigned char)length;
+}
+
+void SessionBatch::abortOperation(std::size_t session) {
+    finishedCounts[session]++;
+    reset(session);
+    setDisplay(session, "####", 4);
+}
+
+bool SessionBatch::calculate(std::size_t session, double rightOperand, Operator pendingOperator) {
+    switch(pendingOperator) {
+    case Operator::Add:
+        return OperatorKernel<Operator::Add>::apply(sumSoFar[session], rightOperand);
+    case Operator::Subtract:
+        return OperatorKernel<Operator::Subtract>::apply(sumSoFar[session], rightOperand);
+    case Operator::Multiply:
+        return OperatorKernel<Operator::Multiply>::apply(factorSoFar[session], rightOperand);
+    case Operator::Divide:
+        return OperatorKernel<Operator::Divide>::apply(factorSoFar[session], rightOperand);
+    case Operator::Power:
+        return OperatorKernel<Operator::Power>::apply(baseSoFar[session], rightOperand);
+    default:
+        return true;
+    }
+}
+
+// finishes a pending power before a looser operator, showing it and leaving it in operand
+bool SessionBatch::finishPower(std::size_t session, double &operand) {
+    if(pendingPowerOps[session] == Operator::None)
+        return true;
+    if(!calculate(session, operand, pendingPowerOps[session]))
+        return false;
+    setDisplay(session, baseSoFar[session]);
+    operand = baseSoFar[session];
+    baseSoFar[session] = 0;
+    pendingPowerOps[session] = Operator::None;
+    return true;
+}
+
+void SessionBatch::plusMinus(std::size_t session, Operator clickedOperator) {
+    operandInEntry[session] = false;
+    double operand = displayValue(session);
+    if(!finishPower(session, operand)) {
+        abortOperation(session);
+        return;
+    }
+    if(pendingMultOps[session] != Operator::None) {
+        if(!calculate(session, operand, pendingMultOps[session])) {
+            abortOperation(session);
+            return;
+        }
+        setDisplay(session, factorSoFar[session]);
+        operand = factorSoFar[session];
+        factorSoFar[session] = 0;
+        pendingMultOps[session] = Operator::None;
+    }
+    if(pendingAddOps[session] != Operator::None) {
+        if(!calculate(session, operand, pendingAddOps[session])) {
+            abortOperation(session);
+            return;
+        }
+        setDisplay(session, sumSoFar[session]);
+    } else {
+        sumSoFar[session] = operand;
+    }
+    pendingAddOps[session] = clickedOperator;
+    waitingForOperand[session] = true;
+}
+
+void SessionBatch::multDiv(std::size_t session, Operator clickedOperator) {
+    operandInEntry[session] = false;
+    double operand = displayValue(session);
+    if(!finishPower(session, operand)) {
+        abortOperation(session);
+        return;
+    }
+    if(pendingMultOps[session] != Operator::None) {
+        if(!calculate(session, operand, pendingMultOps[session])) {
+            abortOperation(session);
+            return;
+        }
+        setDisplay(session, factorSoFar[session]);
+    } else {
+        factorSoFar[session] = operand;
+    }
+    pendingMultOps[session] = clickedOperator;
+    waitingForOperand[session] = true;
+}
+
+void SessionBatch::power(std::size_t session) {
+    operandInEntry[session] = false;
+    double operand = displayValue(session);
+    if(pendingPowerOps[session] != Operator::None) {
+        if(!calculate(session, operand, pendingPowerOps[session])) {
+            abortOperation(session);
+            return;
+        }
+        setDisplay(session, baseSoFar[session]);
+    } else {
+        baseSoFar[session] = operand;
+    }
+    pendingPowerOps[session] = Operator::Power;
+    waitingForOperand[session] = true;
+}
+
+void SessionBatch::equals(std::size_t session) {
+    // a lone number is not worth counting as an entry
+    bool worthKeeping = pendingAddOps[session] != Operator::None || pendingMultOps[session] != Operator::None
+                        || pendingPowerOps[session] != Operator::None || operandInEntry[session];
+    operandInEntry[session] = false;
+    double operand = displayValue(session);
+
+    // the pending power first, then the factor, then the sum
+    if(pendingPowerOps[session] != Operator::None) {
+        if(!calculate(session, operand, pendingPowerOps[session])) {
+            abortOperation(session);
+            return;
+        }
+        operand = baseSoFar[session];
+        baseSoFar[session] = 0;
+    }
+    if(pendingMultOps[session] != Operator::None) {
+        if(!calculate(session, operand, pendingMultOps[session])) {
+            abortOperation(session);
+            return;
+        }
+        operand = factorSoFar[session];
+        factorSoFar[session] = 0;
+    }
+    if(pendingAddOps[session] != Operator::None) {
+        if(!calculate(session, operand, pendingAddOps[session])) {
+            abortOperation(session);
+            return;
+        }
+        operand = sumSoFar[session];
+    }
+    sumSoFar[session] = 0;
+    pendingAddOps[session] = Operator::None;
+    pendingMultOps[session] = Operator::None;
+    pendingPowerOps[session] = Operator::None;
+
+    setDisplay(session, operand);
+    waitingForOperand[session] = true;
+    if(worthKeeping)
+        finishedCounts[session]++;
+}
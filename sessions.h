@@ -0,0 +1,76 @@
+#ifndef SESSIONS_H
+#define SESSIONS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "keys.h"
+#include "operators.h"
+
+/* many calculator sessions at once, each pressing the keys of its own key
+log, kept as one array per piece of state rather than one Engine each. A
+session ends up with the same display and the same number of finished
+entries (#### included) as an Engine pressing the same keys in double mode.
+Brackets need a stack each, so a session with a bracket key is run through an
+Engine of its own instead */
+class SessionBatch
+{
+public:
+    // adds a session that is going to press keys, returns its number
+    std::size_t addSession(const Key *keys, std::size_t count);
+    // presses every key of every session, blocks of sessions at a time on threads threads
+    void run(unsigned threads);
+
+    std::size_t sessionCount() const { return keyStarts.size() - 1; }
+    // what a session displays after its keys
+    std::string display(std::size_t session) const;
+    // how many entries it finished, by equals or by an abort
+    unsigned long finishedCount(std::size_t session) const { return finishedCounts[session]; }
+    // how many sessions were run through an Engine
+    std::size_t fallbackCount() const { return engineSessions; }
+
+    enum {
+        // the double display never holds more than Engine::MaxDisplayLength characters
+        DisplayStride = 16,
+        // sessions a thread takes at once, pressing one key of each in turn
+        BlockSessions = 256
+    };
+
+private:
+    void reset(std::size_t session);
+    void press(std::size_t session, Key key);
+    void runBlock(std::size_t first, std::size_t last);
+    void runFallback(std::size_t session);
+
+    double displayValue(std::size_t session) const;
+    void setDisplay(std::size_t session, double value);
+    void setDisplay(std::size_t session, const char *text, std::size_t length);
+    void abortOperation(std::size_t session);
+    bool calculate(std::size_t session, double rightOperand, Operator pendingOperator);
+    bool finishPower(std::size_t session, double &operand);
+    void plusMinus(std::size_t session, Operator clickedOperator);
+    void multDiv(std::size_t session, Operator clickedOperator);
+    void power(std::size_t session);
+    void equals(std::size_t session);
+
+    // the keys of every session one after another, session s pressing keyStarts[s] up to keyStarts[s + 1]
+    std::vector<Key> keys;
+    std::vector<std::size_t> keyStarts = std::vector<std::size_t>(1, 0);
+    std::vector<unsigned char> throughEngine;
+    std::size_t engineSessions = 0;
+
+    std::vector<double> sumSoFar;
+    std::vector<double> factorSoFar;
+    std::vector<double> baseSoFar;
+    std::vector<Operator> pendingAddOps;
+    std::vector<Operator> pendingMultOps;
+    std::vector<Operator> pendingPowerOps;
+    std::vector<unsigned char> waitingForOperand;
+    // a percentage or function result stands in the entry for the displayed value
+    std::vector<unsigned char> operandInEntry;
+    std::vector<unsigned long> finishedCounts;
+    std::vector<char> displays;
+    std::vector<unsigned char> displayLengths;
+};
+
+#endif // SESSIONS_H
@@ -0,0 +1,249 @@
+#include "sheet.h"
+#include "bytecode.h"
+#include "expression.h"
+#include <atomic>
+#include <climits>
+
+struct Sheet::Cell {
+    std::string name;
+    std::string formula;
+    // null while the cell has no formula
+    std::unique_ptr<Program> program;
+    // the cell of every input of the program, in its order
+    std::vector<int> dependencies;
+    // the cells whose formulas refer to this one
+    std::vector<int> dependents;
+    double value = 0;
+    CellState state = CellState::Empty;
+    // waiting to be recomputed, only ever changed while no recompute is running
+    bool dirty = false;
+    // how many of the cells it refers to have yet to be recomputed
+    std::atomic<std::size_t> pending{0};
+};
+
+Sheet::Sheet(unsigned threads)
+    : pool(threads)
+{
+}
+
+Sheet::~Sheet() {
+}
+
+int Sheet::addCell(const std::string &name) {
+    int cell = int(cells.size());
+    cells.emplace_back(new Cell);
+    cells.back()->name = name;
+    names.emplace(name, cell);
+    visited.push_back(0);
+    return cell;
+}
+
+// function is invoked to give a cell a formula, which is checked before anything is changed
+bool Sheet::setFormula(const char *name, std::size_t nameLength, const char *formula, std::size_t formulaLength,
+                       std::string *error) {
+    // a name is one identifier, and not the name of a function
+    Tokenizer nameTokens(name, name + nameLength);
+    Token nameToken = nameTokens.next();
+    if(nameToken.type != TokenType::Identifier || nameTokens.next().type != TokenType::End
+       || findFunction(nameToken.text, nameToken.length) != Function::None) {
+        if(error)
+            *error = "\"" + std::string(name, nameLength) + "\" is not a name for a cell";
+        return false;
+    }
+    std::string cellName(nameToken.text, nameToken.length);
+
+    Expression expression;
+    if(!expression.parse(formula, formula + formulaLength, error))
+        return false;
+    expression.foldConstants();
+    std::unique_ptr<Program> program(new Program);
+    if(!program->compile(expression)) {
+        if(error)
+            *error = "the formula of " + cellName + " is too large";
+        return false;
+    }
+
+    // only cells that exist already can depend on this one
+    std::unordered_map<std::string, int>::const_iterator found = names.find(cellName);
+    int cell = found == names.end() ? -1 : found->second;
+    std::vector<int> existing;
+    bool circular = false;
+    for(const std::string &variable : expression.variableNames()) {
+        circular |= variable == cellName;
+        std::unordered_map<std::string, int>::const_iterator other = names.find(variable);
+        if(other != names.end())
+            existing.push_back(other->second);
+    }
+    if(circular || (cell >= 0 && reaches(cell, existing))) {
+        if(error)
+            *error = "the formula of " + cellName + " refers back to it";
+        return false;
+    }
+
+    if(cell < 0)
+        cell = addCell(cellName);
+
+    // the cell is taken off the cells it referred to, and put on the ones it refers to now,
+    // which are created empty if there are none by their names yet
+    for(int dependency : cells[std::size_t(cell)]->dependencies) {
+        std::vector<int> &dependents = cells[std::size_t(dependency)]->dependents;
+        for(std::size_t i = 0; i < dependents.size(); i++) {
+            if(dependents[i] == cell) {
+                dependents[i] = dependents.back();
+                dependents.pop_back();
+                break;
+            }
+        }
+    }
+    std::vector<int> dependencies;
+    for(const std::string &variable : expression.variableNames()) {
+        std::unordered_map<std::string, int>::const_iterator other = names.find(variable);
+        int dependency = other != names.end() ? other->second : addCell(variable);
+        cells[std::size_t(dependency)]->dependents.push_back(cell);
+        dependencies.push_back(dependency);
+    }
+
+    Cell &target = *cells[std::size_t(cell)];
+    target.formula.assign(formula, formulaLength);
+    target.program = std::move(program);
+    target.dependencies = std::move(dependencies);
+    changed.push_back(cell);
+    return true;
+}
+
+// returns true if any of targets depends on from, directly or through other cells
+bool Sheet::reaches(int from, const std::vector<int> &targets) {
+    if(targets.empty())
+        return false;
+    // two marks per search, one for the targets and one for the cells seen
+    if(visitMark > UINT_MAX - 2) {
+        visited.assign(visited.size(), 0);
+        visitMark = 0;
+    }
+    unsigned target = ++visitMark;
+    unsigned seen = ++visitMark;
+    for(int cell : targets)
+        visited[std::size_t(cell)] = target;
+
+    std::vector<int> stack(1, from);
+    while(!stack.empty()) {
+        int cell = stack.back();
+        stack.pop_back();
+        for(int dependent : cells[std::size_t(cell)]->dependents) {
+            unsigned &mark = visited[std::size_t(dependent)];
+            if(mark == target)
+                return true;
+            if(mark != seen) {
+                mark = seen;
+                stack.push_back(dependent);
+            }
+        }
+    }
+    return false;
+}
+
+// function is invoked to bring every cell that a change reached up to date, in an order their formulas allow
+std::size_t Sheet::recompute() {
+    // the changed cells and everything depending on them, each taken once
+    std::vector<std::size_t> affected;
+    for(int cell : changed) {
+        if(!cells[std::size_t(cell)]->dirty) {
+            cells[std::size_t(cell)]->dirty = true;
+            affected.push_back(std::size_t(cell));
+        }
+    }
+    changed.clear();
+    for(std::size_t i = 0; i < affected.size(); i++) {
+        for(int dependent : cells[affected[i]]->dependents) {
+            if(!cells[std::size_t(dependent)]->dirty) {
+                cells[std::size_t(dependent)]->dirty = true;
+                affected.push_back(std::size_t(dependent));
+            }
+        }
+    }
+
+    // a cell is ready once none of the cells it refers to waits to be recomputed
+    std::vector<std::size_t> ready;
+    for(std::size_t index : affected) {
+        Cell &cell = *cells[index];
+        std::size_t waiting = 0;
+        for(int dependency : cell.dependencies)
+            waiting += cells[std::size_t(dependency)]->dirty;
+        cell.pending.store(waiting, std::memory_order_relaxed);
+        if(waiting == 0)
+            ready.push_back(index);
+    }
+
+    // whichever thread recomputes the last cell a dependent waited for makes the dependent ready
+    WorkStealingPool::Task task = [this](std::size_t index, std::vector<std::size_t> &spawned) {
+        Cell &cell = *cells[index];
+        evaluateCell(cell);
+        for(int dependent : cell.dependents) {
+            Cell &other = *cells[std::size_t(dependent)];
+            if(other.dirty && other.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                spawned.push_back(std::size_t(dependent));
+        }
+    };
+    if(affected.size() < MinParallelCells || pool.threadCount() == 1) {
+        std::vector<std::size_t> spawned;
+        while(!ready.empty()) {
+            std::size_t index = ready.back();
+            ready.pop_back();
+            spawned.clear();
+            task(index, spawned);
+            ready.insert(ready.end(), spawned.begin(), spawned.end());
+        }
+    } else {
+        pool.run(ready, task);
+    }
+
+    for(std::size_t index : affected)
+        cells[index]->dirty = false;
+    return affected.size();
+}
+
+// works out one cell from the cells it refers to, which are all up to date
+void Sheet::evaluateCell(Cell &cell) {
+    if(!cell.program) {
+        cell.state = CellState::Empty;
+        return;
+    }
+    thread_local std::vector<double> inputs;
+    inputs.resize(cell.dependencies.size());
+    for(std::size_t i = 0; i < cell.dependencies.size(); i++) {
+        const Cell &dependency = *cells[std::size_t(cell.dependencies[i])];
+        if(dependency.state != CellState::Value) {
+            cell.state = CellState::Failed;
+            return;
+        }
+        inputs[i] = dependency.value;
+    }
+    double value;
+    if(cell.program->evaluate(inputs.data(), value)) {
+        cell.value = value;
+        cell.state = CellState::Value;
+    } else {
+        cell.state = CellState::Failed;
+    }
+}
+
+int Sheet::findCell(const char *name, std::size_t length) const {
+    std::unordered_map<std::string, int>::const_iterator found = names.find(std::string(name, length));
+    return found == names.end() ? -1 : found->second;
+}
+
+const std::string &Sheet::cellName(int cell) const {
+    return cells[std::size_t(cell)]->name;
+}
+
+const std::string &Sheet::cellFormula(int cell) const {
+    return cells[std::size_t(cell)]->formula;
+}
+
+CellState Sheet::cellState(int cell) const {
+    return cells[std::size_t(cell)]->state;
+}
+
+double Sheet::cellValue(int cell) const {
+    return cells[std::size_t(cell)]->value;
+}
@@ -0,0 +1,73 @@
+#ifndef SHEET_H
+#define SHEET_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "workpool.h"
+
+// what a cell came to when it was last recomputed
+enum class CellState : unsigned char {
+    // no formula yet, the cell is only referred to by others
+    Empty,
+    Value,
+    // it divides by zero, leaves the domain of a function, or refers to a cell that is empty or failed
+    Failed
+};
+
+/* named cells whose formulas refer to each other by name, like total = net +
+tax. Every cell knows the cells that refer to it, so a change recomputes those
+and nothing else, each one only after every cell it refers to. Cells that do
+not depend on each other are recomputed in parallel on a work-stealing pool */
+class Sheet
+{
+public:
+    explicit Sheet(unsigned threads = std::thread::hardware_concurrency());
+    ~Sheet();
+
+    Sheet(const Sheet &) = delete;
+    Sheet &operator=(const Sheet &) = delete;
+
+    /* sets the formula of a cell, creating the cell if there is none by that
+    name yet. Returns false, sets error and leaves the cell as it was if the
+    name or the formula cannot be read, or if the formula refers back to the
+    cell, directly or through others. Nothing is recomputed before recompute() */
+    bool setFormula(const char *name, std::size_t nameLength, const char *formula, std::size_t formulaLength,
+                    std::string *error = nullptr);
+    // recomputes the cells changed since the last time and every cell depending on them, returns how many
+    std::size_t recompute();
+
+    std::size_t cellCount() const { return cells.size(); }
+    // the number of the cell with a name, or -1 if there is none
+    int findCell(const char *name, std::size_t length) const;
+    const std::string &cellName(int cell) const;
+    const std::string &cellFormula(int cell) const;
+    CellState cellState(int cell) const;
+    double cellValue(int cell) const;
+
+    enum {
+        // fewer cells than this are recomputed on the calling thread, waking the pool would take longer
+        MinParallelCells = 512
+    };
+
+private:
+    struct Cell;
+
+    int addCell(const std::string &name);
+    bool reaches(int from, const std::vector<int> &targets);
+    void evaluateCell(Cell &cell);
+
+    std::vector<std::unique_ptr<Cell>> cells;
+    std::unordered_map<std::string, int> names;
+    // cells given a formula since the last recompute
+    std::vector<int> changed;
+    // marks cells visited by one search, a search at a time, without clearing them all
+    std::vector<unsigned> visited;
+    unsigned visitMark = 0;
+    WorkStealingPool pool;
+};
+
+#endif // SHEET_H
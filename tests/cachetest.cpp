@@ -0,0 +1,71 @@
+#include "check.h"
+#include "evaluator.h"
+#include "expression.h"
+#include "resultcache.h"
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+/* the key a line is looked up by as typed against the tokens the parser reads
+from it, and cached lines against the same lines worked out without a cache */
+
+// the tokens of a line, written out one per line so that two lines read alike exactly if these are equal
+static std::string tokenText(const std::string &line) {
+    Tokenizer tokens(line.data(), line.data() + line.size());
+    std::string text;
+    for(Token token = tokens.next(); token.type != TokenType::End; token = tokens.next())
+        text.append(std::to_string(int(token.type))).append(":").append(token.text, token.length).push_back('\n');
+    return text;
+}
+
+/* lines of a few characters each, from the ones where a space decides how the
+line is read, with random spacing, so the same characters come up many times
+spaced in different ways. Lines with the same key have to read as the same tokens */
+TEST(lineKeyKeepsMeaningfulSpaces) {
+    std::mt19937_64 random(700);
+    static const char *const pieces[] = { "1", "2", ".", "e", "E", "+", "-", "x", "(", ")", "\303\227", "%" };
+    std::map<std::string, std::string> tokensByKey;
+    std::string buffer;
+    std::size_t differing = 0, shared = 0;
+    for(int i = 0; i < 200000; i++) {
+        std::string line;
+        for(int n = int(random() % 6) + 1; n > 0; n--) {
+            if(random() % 3 == 0)
+                line.append(random() % 4 ? " " : "\t ");
+            line.append(pieces[random() % (sizeof(pieces) / sizeof(pieces[0]))]);
+        }
+        CacheKey key = lineKey(line.data(), line.data() + line.size(), buffer);
+        std::string tokens = tokenText(line);
+        auto inserted = tokensByKey.emplace(std::string(key.data, key.length), tokens);
+        shared += !inserted.second;
+        if(!inserted.second && inserted.first->second != tokens && differing++ < 5)
+            std::printf("  \"%s\" has the key of a line read another way\n", line.c_str());
+    }
+    std::printf("  %zu keys, %zu lines found a key already taken\n", tokensByKey.size(), shared);
+    CHECK(differing == 0);
+
+    // spaces around operators and brackets do not matter
+    std::string other;
+    CacheKey spaced = lineKey("1 + ( 2 )", "1 + ( 2 )" + 9, buffer);
+    CacheKey packed = lineKey("1+(2)", "1+(2)" + 5, other);
+    CHECK(spaced.hash == packed.hash && buffer == other);
+}
+
+// lines that only differ in their spaces, one of them an error, each more than once, with a cache
+TEST(cachedLinesDifferingInSpacing) {
+    const char *const lines[] = { "12", "1 2", "12", "1 2", "1e+5", "1e +5", "1e+5", "1e +5", "2.5", "2 .5", "2 .5" };
+    ResultCache cache(100);
+    LineEvaluator cached;
+    cached.setCache(&cache);
+    for(const char *line : lines) {
+        LineEvaluator fresh;
+        std::string expected, result;
+        fresh.evaluateLine(line, line + std::string(line).size(), expected);
+        cached.evaluateLine(line, line + std::string(line).size(), result);
+        if(!CHECK(result == expected))
+            std::printf("  \"%s\" gave %s with the cache, not %s\n", line, result.c_str(), expected.c_str());
+    }
+    CHECK(cache.statistics().hits > 0);
+}
@@ -0,0 +1,26 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstddef>
+
+/* the checks of calc-tests. A test is a function registered under a name by
+TEST, which reports everything it finds wrong through CHECK and carries on, so
+that one run shows every failure and not only the first */
+
+typedef void (*TestFunction)();
+
+struct TestRegistration {
+    TestRegistration(const char *name, TestFunction function);
+};
+
+// counts a failure and prints where it happened if condition is false, returns condition
+bool checkThat(bool condition, const char *text, const char *file, int line);
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistration name##Registration(#name, name); \
+    static void name()
+
+#define CHECK(condition) checkThat((condition), #condition, __FILE__, __LINE__)
+
+#endif // CHECK_H
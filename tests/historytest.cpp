@@ -0,0 +1,106 @@
+#include "check.h"
+#include "history.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// the tape is kept in the directory the tests run in, and taken away again
+static const char TapePath[] = "calc-tests-history.tape";
+
+static void removeTape() {
+    static const char *const suffixes[] = { "", ".idx", ".values", ".texts" };
+    for(const char *suffix : suffixes)
+        std::remove((std::string(TapePath) + suffix).c_str());
+}
+
+// what findPrefix() has to find, going through every entry newest first
+static std::vector<std::size_t> scanPrefix(const HistoryTape &tape, const std::string &prefix) {
+    std::vector<std::size_t> found;
+    for(std::size_t i = tape.count(); i-- > 0;) {
+        HistoryEntry item = tape.entry(i);
+        if(item.expressionLength >= prefix.size() && std::memcmp(item.expression, prefix.data(), prefix.size()) == 0)
+            found.push_back(i);
+    }
+    return found;
+}
+
+// the same for findValue()
+static std::vector<std::size_t> scanValue(const HistoryTape &tape, double low, double high) {
+    std::vector<std::size_t> found;
+    for(std::size_t i = tape.count(); i-- > 0;) {
+        double value = tape.entry(i).value;
+        if(value >= low && value <= high)
+            found.push_back(i);
+    }
+    return found;
+}
+
+// both searches find what scanning the whole tape finds, the order included
+static void checkSearches(HistoryTape &tape) {
+    static const char *const prefixes[] = { "1", "12", "3 +", "99", "7 \303\227", "" };
+    for(const char *prefix : prefixes) {
+        std::vector<std::size_t> found = tape.findPrefix(prefix, std::strlen(prefix), std::size_t(-1));
+        CHECK(found == scanPrefix(tape, prefix));
+    }
+    static const char *const values[] = { "12", "0.5", "-3", "100", "7.25" };
+    for(const char *value : values) {
+        double low, high;
+        CHECK(readValueRange(value, std::strlen(value), low, high));
+        CHECK(low <= std::atof(value) && std::atof(value) <= high);
+        CHECK(tape.findValue(low, high, std::size_t(-1)) == scanValue(tape, low, high));
+    }
+    double low, high;
+    CHECK(!readValueRange("abc", 3, low, high));
+}
+
+static void appendEntries(HistoryTape &tape, std::mt19937_64 &random, int count) {
+    std::uniform_int_distribution<int> operand(0, 120);
+    std::uniform_int_distribution<int> pick(0, 3);
+    static const char *const symbols[] = { " + ", " - ", " \303\227 ", " \303\267 " };
+    for(int i = 0; i < count; i++) {
+        int a = operand(random), b = operand(random), op = pick(random);
+        double value = op == 0 ? a + b : op == 1 ? a - b : op == 2 ? double(a) * b : b ? double(a) / b : NAN;
+        std::string expression = std::to_string(a) + symbols[op] + std::to_string(b);
+        std::string result = std::isnan(value) ? "####" : std::to_string(value);
+        CHECK(tape.append(expression, result, value, NumberMode::Double));
+    }
+}
+
+/* the searches of the tape agree with a scan of every entry: on entries only
+appended, on a tape opened again, whose entries are mapped, and after more
+entries that the indexes kept next to the tape do not cover yet */
+TEST(historySearchMatchesScan) {
+    removeTape();
+    std::mt19937_64 random(4);
+    {
+        HistoryTape tape;
+        CHECK(tape.open(TapePath));
+        appendEntries(tape, random, 3000);
+        checkSearches(tape);
+        tape.close();
+    }
+    {
+        HistoryTape tape;
+        CHECK(tape.open(TapePath));
+        CHECK(tape.count() == 3000);
+        checkSearches(tape);
+        appendEntries(tape, random, 500);
+        checkSearches(tape);
+        tape.close();
+    }
+    {
+        HistoryTape tape;
+        CHECK(tape.open(TapePath));
+        CHECK(tape.count() == 3500);
+        HistoryEntry first = tape.entry(0);
+        CHECK(first.mode == NumberMode::Double && first.resultLength > 0);
+        checkSearches(tape);
+        tape.close();
+    }
+    removeTape();
+}
@@ -0,0 +1,131 @@
+#include "bytecode.h"
+#include "check.h"
+#include "evaluator.h"
+#include "expression.h"
+#include "functions.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+/* the machine code of a program against the interpreter, and lines run from
+the programs LineEvaluator keeps against the same lines worked out the first
+time, over random expressions with every operator and function */
+
+// a random expression of the given depth, over x, y and z if variables is set
+static std::string randomExpression(std::mt19937_64 &random, int depth, bool variables) {
+    if(depth == 0 || random() % 5 == 0) {
+        static const char *const leaves[] = { "0", "1", "2", "0.5", "3.75", "-4", "100", "1e-3", "7%" };
+        static const char *const names[] = { "x", "y", "z" };
+        if(variables && random() % 2)
+            return names[random() % 3];
+        return leaves[random() % (sizeof(leaves) / sizeof(leaves[0]))];
+    }
+    switch(random() % 8) {
+    case 0: {
+        Function function = Function(1 + random() % (int(Function::Gamma)));
+        return std::string(functionName(function)) + "(" + randomExpression(random, depth - 1, variables) + ")";
+    }
+    case 1:
+        return "-(" + randomExpression(random, depth - 1, variables) + ")";
+    case 2:
+        return "(" + randomExpression(random, depth - 1, variables) + ")%";
+    default: {
+        static const char *const operators[] = { " + ", " - ", " * ", " / ", " ^ " };
+        return "(" + randomExpression(random, depth - 1, variables) + operators[random() % 5]
+               + randomExpression(random, depth - 1, variables) + ")";
+    }
+    }
+}
+
+static bool sameResult(bool valid, double value, bool expectedValid, double expected) {
+    if(valid != expectedValid)
+        return false;
+    return !valid || std::memcmp(&value, &expected, sizeof(double)) == 0 || (std::isnan(value) && std::isnan(expected));
+}
+
+/* every program compiled on its first evaluation gives exactly what the
+interpreter gives, failures included, for inputs of every size and sign */
+TEST(nativeMatchesInterpreter) {
+    std::mt19937_64 random(300);
+    std::size_t differing = 0, native = 0;
+    for(int i = 0; i < 2000; i++) {
+        std::string text = randomExpression(random, 6, true);
+        Expression expression;
+        Program program;
+        if(!CHECK(expression.parse(text.data(), text.data() + text.size()) && program.compile(expression)))
+            continue;
+        program.setJitThreshold(1);
+        std::vector<double> inputs(program.inputCount()), scratch(program.registerCount());
+        double value;
+        program.evaluate(inputs.data(), value);
+        native += program.isNative();
+
+        for(int k = 0; k < 50; k++) {
+            for(double &input : inputs) {
+                input = std::uniform_real_distribution<double>(-10, 10)(random);
+                if(random() % 8 == 0)
+                    input = std::floor(input);
+            }
+            double expected;
+            bool expectedValid = program.run(inputs.data(), scratch.data(), expected);
+            bool valid = program.evaluate(inputs.data(), value);
+            if(!sameResult(valid, value, expectedValid, expected) && differing++ < 5)
+                std::printf("  %s gave %.17g, not %.17g\n", text.c_str(), value, expected);
+        }
+    }
+    CHECK(differing == 0);
+#if defined(__x86_64__) && defined(__linux__)
+    CHECK(native == 2000);
+#endif
+}
+
+/* lines that come again and again, run from kept programs, interpreted and as
+machine code, print what an evaluator that has never seen them prints */
+TEST(keptLinesMatchFirstEvaluation) {
+    std::mt19937_64 random(301);
+    std::vector<std::string> lines;
+    for(int i = 0; i < 500; i++)
+        lines.push_back(randomExpression(random, 5, false));
+
+    LineEvaluator interpreted, compiled;
+    interpreted.setJitThreshold(0);
+    compiled.setJitThreshold(2);
+    std::size_t differing = 0;
+    for(int round = 0; round < 6; round++) {
+        for(const std::string &line : lines) {
+            LineEvaluator fresh;
+            std::string expected, first, second;
+            fresh.evaluateLine(line.data(), line.data() + line.size(), expected);
+            interpreted.evaluateLine(line.data(), line.data() + line.size(), first);
+            compiled.evaluateLine(line.data(), line.data() + line.size(), second);
+            if((first != expected || second != expected) && differing++ < 5)
+                std::printf("  %s gave %s and %s, not %s\n", line.c_str(), first.c_str(), second.c_str(),
+                            expected.c_str());
+        }
+    }
+    CHECK(differing == 0);
+}
+
+/* lines that only differ in their spaces, one of them an error, each coming
+often enough to be kept, must not be run from each other's programs */
+TEST(keptLinesDifferingInSpacing) {
+    const char *const lines[] = { "1 2", "12", "1e+5", "1e +5", "2.5", "2 .5", "3 4", "34" };
+    LineEvaluator interpreted, compiled;
+    interpreted.setJitThreshold(0);
+    compiled.setJitThreshold(1);
+    for(int round = 0; round < 4; round++) {
+        for(const char *line : lines) {
+            LineEvaluator fresh;
+            std::string expected, first, second;
+            const char *end = line + std::strlen(line);
+            fresh.evaluateLine(line, end, expected);
+            interpreted.evaluateLine(line, end, first);
+            compiled.evaluateLine(line, end, second);
+            if(!CHECK(first == expected && second == expected))
+                std::printf("  \"%s\" gave %s and %s, not %s\n", line, first.c_str(), second.c_str(), expected.c_str());
+        }
+    }
+}
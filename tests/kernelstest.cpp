@@ -0,0 +1,210 @@
+#include "bytecode.h"
+#include "check.h"
+#include "column.h"
+#include "expression.h"
+#include "functions.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+/* the error bounds mathkernels.h and the README give for every function,
+measured against the long double functions of the C library, which are good
+to far below an ulp of a double. Every function is tried on random arguments
+over the whole range it works in, the same ones on every run */
+
+static const int Arguments = 200000;
+
+// how many units in the last place of the exact value result is off, infinite if it is not even close
+static double ulpError(double result, long double exact) {
+    if(std::isnan(result) || std::isinf(result) || std::isinf(exact))
+        return double(result) == double(exact) ? 0 : HUGE_VAL;
+    int exponent;
+    std::frexp(std::fabs(exact), &exponent);
+    long double ulp = std::ldexp(1.0L, std::max(exponent - DBL_MANT_DIG, DBL_MIN_EXP - DBL_MANT_DIG));
+    return double(std::fabs(result - exact) / ulp);
+}
+
+// the worst error of a function over arguments, printed so that a run shows how close it comes to its bound
+template<typename Argument, typename Exact>
+static double worstError(Function function, Argument argument, Exact exact) {
+    std::mt19937_64 random(static_cast<unsigned>(function));
+    double worst = 0, worstAt = 0;
+    for(int i = 0; i < Arguments; i++) {
+        double x = argument(random);
+        double value = x;
+        if(!applyFunction(function, value))
+            continue;
+        double error = ulpError(value, exact(x));
+        if(error > worst) {
+            worst = error;
+            worstAt = x;
+        }
+    }
+    std::printf("  %-6s %.3f ulp at %.17g\n", functionName(function), worst, worstAt);
+    return worst;
+}
+
+static double uniform(std::mt19937_64 &random, double from, double to) {
+    return std::uniform_real_distribution<double>(from, to)(random);
+}
+
+// anything from 10^-300 to 10^300 as often as anything else of its own size
+static double anySize(std::mt19937_64 &random) {
+    return std::pow(10.0, uniform(random, -300, 300));
+}
+
+// half of them below 2, where most of the tables and polynomials change over, the rest up to the limit
+static double angle(std::mt19937_64 &random) {
+    double x = random() % 2 ? uniform(random, -2, 2) : uniform(random, -1e8, 1e8);
+    return x;
+}
+
+TEST(functionErrorBounds) {
+    if(LDBL_MANT_DIG < DBL_MANT_DIG + 8) {
+        std::printf("  long double is not precise enough to measure errors against\n");
+        return;
+    }
+    CHECK(worstError(Function::Exponential, [](std::mt19937_64 &r) { return uniform(r, -745, 709.7); },
+                     [](double x) { return std::exp((long double)x); }) < 0.9);
+    CHECK(worstError(Function::NaturalLog, [](std::mt19937_64 &r) { return r() % 2 ? anySize(r) : uniform(r, 0.5, 2); },
+                     [](double x) { return std::log((long double)x); }) < 0.9);
+    CHECK(worstError(Function::Log10, [](std::mt19937_64 &r) { return r() % 2 ? anySize(r) : uniform(r, 0.5, 2); },
+                     [](double x) { return std::log10((long double)x); }) < 0.9);
+    CHECK(worstError(Function::Sine, angle, [](double x) { return std::sin((long double)x); }) < 0.9);
+    CHECK(worstError(Function::Cosine, angle, [](double x) { return std::cos((long double)x); }) < 0.9);
+    CHECK(worstError(Function::Tangent, angle, [](double x) { return std::tan((long double)x); }) < 2.2);
+    CHECK(worstError(Function::ArcTangent, [](std::mt19937_64 &r) { return r() % 2 ? anySize(r) : uniform(r, -2, 2); },
+                     [](double x) { return std::atan((long double)x); }) < 2.2);
+    CHECK(worstError(Function::ArcSine, [](std::mt19937_64 &r) { return uniform(r, -1, 1); },
+                     [](double x) { return std::asin((long double)x); }) < 3.3);
+    CHECK(worstError(Function::ArcCosine, [](std::mt19937_64 &r) { return uniform(r, -1, 1); },
+                     [](double x) { return std::acos((long double)x); }) < 3.3);
+}
+
+/* x^y over bases from 10^-5 to 10^5 and exponents that keep the result from
+overflowing, the case where a rounding error in y ln x shows the most, and
+every integer power up to 64, which has to be exact when the result fits */
+TEST(powerErrorBounds) {
+    if(LDBL_MANT_DIG < DBL_MANT_DIG + 8)
+        return;
+    std::mt19937_64 random(100);
+    double worst = 0, worstBase = 0, worstExponent = 0;
+    for(int i = 0; i < Arguments; i++) {
+        double x = std::exp(uniform(random, -11.5, 11.5));
+        double y = uniform(random, -700, 700) / std::log(x);
+        double value = x;
+        CHECK(raisePower(value, y));
+        double error = ulpError(value, std::pow((long double)x, (long double)y));
+        if(error > worst) {
+            worst = error;
+            worstBase = x;
+            worstExponent = y;
+        }
+    }
+    std::printf("  ^      %.3f ulp at %.17g ^ %.17g\n", worst, worstBase, worstExponent);
+    CHECK(worst < 0.8);
+
+    double worstInteger = 0;
+    for(int i = 0; i < Arguments; i++) {
+        double x = uniform(random, -30, 30);
+        int n = int(random() % 129) - 64;
+        double value = x;
+        CHECK(raisePower(value, n));
+        worstInteger = std::max(worstInteger, ulpError(value, std::pow((long double)x, n)));
+    }
+    std::printf("  ^ n    %.3f ulp\n", worstInteger);
+    CHECK(worstInteger < 1);
+
+    /* products that fit into a double come out exact, the others rounded once,
+    which the C library does not always manage: it has 3^34 one ulp too high */
+    std::uint64_t exact = 1;
+    for(int n = 0; n <= 40; n++, exact *= 3) {
+        double value = 3;
+        CHECK(raisePower(value, n) && value == double(exact));
+    }
+    for(int n = 0; n <= 64; n++) {
+        double value = -0.5;
+        CHECK(raisePower(value, -n) && value == std::ldexp(n % 2 ? -1.0 : 1.0, n));
+    }
+}
+
+// x^y where IEEE 754 and the C library say what it is, and where the calculator refuses it
+TEST(powerSpecialCases) {
+    const double inf = HUGE_VAL, nan = std::nan("");
+    const double cases[][2] = {
+        { 2, 3 }, { -2, 3 }, { -2, 4 }, { -0.0, 3 }, { -0.0, 4 }, { 0.0, 3 }, { -0.0, 0.5 }, { 0.0, 0 },
+        { -1, inf }, { -1, -inf }, { 1, inf }, { 1, nan }, { nan, 0 }, { -3, 0 },
+        { 0.5, inf }, { 0.5, -inf }, { 2, inf }, { 2, -inf }, { -0.5, inf }, { -2, -inf },
+        { inf, 2 }, { inf, -2 }, { -inf, 3 }, { -inf, 4 }, { -inf, -3 }, { -inf, -4 }, { inf, 0 },
+        { 2, 1024 }, { 2, 1023.5 }, { -2, 1025 }, { 10, 400 }, { 10, -400 }, { -10, -401 },
+        { 2, -1074 }, { 2, -1075.5 }, { 0.1, 330.5 }, { 1e300, 1e300 }, { 1e-300, 1e300 }, { 2, nan }, { nan, 2 },
+        { 1e300, 2 }, { -1e300, 3 }, { 1e-300, -2 }, { 1e-200, 2 }, { nan, 0.5 }, { nan, -3 }, { nan, inf },
+    };
+    for(const double *c : cases) {
+        double value = c[0];
+        double expected = std::pow(c[0], c[1]);
+        bool valid = raisePower(value, c[1]);
+        bool same = valid && (value == expected ? std::signbit(value) == std::signbit(expected)
+                                                : std::isnan(value) && std::isnan(expected));
+        if(!CHECK(same))
+            std::printf("  %g ^ %g gave %g, not %g\n", c[0], c[1], value, expected);
+    }
+
+    // what the calculator refuses, like dividing by zero
+    const double refused[][2] = { { 0.0, -1 }, { -0.0, -3 }, { 0.0, -inf }, { -8, 1.0 / 3 }, { -2, 0.5 } };
+    for(const double *c : refused) {
+        double value = c[0];
+        CHECK(!raisePower(value, c[1]));
+    }
+}
+
+/* the column kernels of every instruction set the processor has give every
+row exactly what the function gives one value, specials and failures included */
+TEST(columnsMatchScalar) {
+    std::mt19937_64 random(200);
+    const std::size_t rows = 10007;
+    std::vector<double> x(rows), y(rows);
+    const double specials[] = { 0.0, -0.0, 1, -1, 0.5, -2, 1e-310, HUGE_VAL, -HUGE_VAL, std::nan(""), 1e300 };
+    for(std::size_t i = 0; i < rows; i++) {
+        x[i] = i < 11 * 11 ? specials[i % 11] : uniform(random, -50, 50) * std::pow(10.0, uniform(random, -3, 3));
+        y[i] = i < 11 * 11 ? specials[i / 11] : random() % 4 ? uniform(random, -30, 30) : double(int(random() % 129) - 64);
+    }
+    const double *inputs[] = { x.data(), y.data() };
+
+    // None stands for x ^ y
+    for(int function = int(Function::None); function <= int(Function::ArcTangent); function++) {
+        std::string text = function ? std::string(functionName(Function(function))) + "(x)" : "x ^ y";
+        Expression expression;
+        Program program;
+        CHECK(expression.parse(text.data(), text.data() + text.size()) && program.compile(expression));
+        std::vector<double> expected(rows);
+        std::vector<unsigned char> expectedErrors(rows);
+        for(std::size_t i = 0; i < rows; i++) {
+            double value = x[i];
+            bool valid = function ? applyFunction(Function(function), value) : raisePower(value, y[i]);
+            expected[i] = valid ? value : std::nan("");
+            expectedErrors[i] = !valid;
+        }
+
+        for(int isa = int(ColumnIsa::Scalar); isa <= int(detectColumnIsa()); isa++) {
+            std::vector<double> output(rows);
+            std::vector<unsigned char> errors(rows);
+            evaluateColumns(program, inputs, rows, output.data(), errors.data(), ColumnIsa(isa));
+            std::size_t differing = 0;
+            for(std::size_t i = 0; i < rows; i++) {
+                bool same = errors[i] == expectedErrors[i]
+                            && (errors[i] || std::memcmp(&output[i], &expected[i], sizeof(double)) == 0
+                                || (std::isnan(output[i]) && std::isnan(expected[i])));
+                differing += !same;
+            }
+            if(!CHECK(differing == 0))
+                std::printf("  %s differs in %zu rows with instruction set %d\n", text.c_str(), differing, isa);
+        }
+    }
+}
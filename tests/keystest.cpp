@@ -0,0 +1,78 @@
+#include "check.h"
+#include "engine.h"
+#include "keys.h"
+#include "latency.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+// presses the keys of a key log through a fresh Engine and returns what it displays
+static std::string replay(const char *log, NumberMode mode = NumberMode::Double) {
+    std::vector<Key> keys;
+    CHECK(parseKeys(log, std::strlen(log), keys));
+    Engine engine;
+    engine.setNumberMode(mode);
+    for(Key key : keys)
+        engine.press(key);
+    return engine.display();
+}
+
+// every key written out by formatKeys() reads back as the same key
+TEST(keyLogRoundTrip) {
+    std::vector<Key> keys;
+    for(int key = 0; key < int(Key::Count); key++)
+        keys.push_back(Key(key));
+    std::string log = formatKeys(keys.data(), keys.size());
+    std::vector<Key> read;
+    CHECK(parseKeys(log.data(), log.size(), read));
+    CHECK(read == keys);
+
+    // the spaces are optional, and the button labels read as their keys
+    std::vector<Key> packed, spaced;
+    CHECK(parseKeys("12+3=", 5, packed));
+    CHECK(parseKeys("1 2 + 3 =", 9, spaced));
+    CHECK(packed == spaced);
+    std::vector<Key> labels;
+    CHECK(parseKeys("2 \303\227 3 \302\261", std::strlen("2 \303\227 3 \302\261"), labels));
+    CHECK(labels.size() == 4 && labels[1] == Key::Multiply && labels[3] == Key::FlipSign);
+
+    std::string error;
+    CHECK(!parseKeys("1 + pizza", 9, read, &error));
+    CHECK(!error.empty());
+}
+
+// key logs replayed without the window end on what the calculator displays
+TEST(keyLogReplay) {
+    CHECK(replay("1 2 + 3 * 4 =") == "24");
+    CHECK(replay("2 ( 3 + 4 ) =") == "14");
+    CHECK(replay("1 / 0 =") == "####");
+    CHECK(replay("9 sqrt") == "3");
+    CHECK(replay("2 neg ^ 2 =") == "4");
+    CHECK(replay("1 2 3 bs bs") == "1");
+    CHECK(replay("1 / 3 * 3 =", NumberMode::Rational) == "1");
+    CHECK(replay("0 . 1 + 0 . 2 =", NumberMode::Decimal) == "0.3");
+}
+
+// a percentile is the top of its bucket, never below the real one and at most 12.5% above it
+TEST(latencyPercentiles) {
+    LatencyHistogram histogram;
+    for(std::uint64_t nanoseconds = 1; nanoseconds <= 100000; nanoseconds++)
+        histogram.record(nanoseconds);
+    CHECK(histogram.count() == 100000);
+    CHECK(histogram.max() == 100000);
+    CHECK(histogram.mean() == 50000);
+    static const double fractions[] = { 0.5, 0.9, 0.99, 0.999 };
+    for(double fraction : fractions) {
+        double real = fraction * 100000;
+        double reported = double(histogram.percentile(fraction));
+        CHECK(reported >= real && reported <= real * 1.125);
+    }
+
+    LatencyHistogram other;
+    other.record(1000000);
+    histogram.merge(other);
+    CHECK(histogram.count() == 100001);
+    CHECK(histogram.max() == 1000000);
+    histogram.reset();
+    CHECK(histogram.count() == 0);
+}
@@ -0,0 +1,51 @@
+#include "check.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+struct Test {
+    const char *name;
+    TestFunction function;
+};
+
+// filled before main() runs, by the registration of every test in every file
+static std::vector<Test> &registeredTests() {
+    static std::vector<Test> tests;
+    return tests;
+}
+
+static unsigned long failures = 0;
+
+TestRegistration::TestRegistration(const char *name, TestFunction function) {
+    registeredTests().push_back({ name, function });
+}
+
+bool checkThat(bool condition, const char *text, const char *file, int line) {
+    if(!condition) {
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, text);
+        failures++;
+    }
+    return condition;
+}
+
+// runs every test, or the ones named on the command line, and fails if any check did
+int main(int argc, char *argv[]) {
+    unsigned long run = 0;
+    for(const Test &test : registeredTests()) {
+        bool chosen = argc == 1;
+        for(int i = 1; i < argc; i++)
+            chosen |= std::strcmp(argv[i], test.name) == 0;
+        if(!chosen)
+            continue;
+        unsigned long before = failures;
+        test.function();
+        std::printf("%-32s %s\n", test.name, failures == before ? "ok" : "FAILED");
+        run++;
+    }
+    if(run == 0) {
+        std::fprintf(stderr, "calc-tests: no test by that name\n");
+        return 2;
+    }
+    std::printf("%lu tests, %lu failed checks\n", run, failures);
+    return failures ? 1 : 0;
+}
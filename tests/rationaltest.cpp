@@ -0,0 +1,210 @@
+#include "check.h"
+#include "rational.h"
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+
+/* exact fractions against plain 128-bit fractions, which are brought to
+lowest terms after every step and stop a chain of operations as soon as they
+would overflow. The operands are from a few digits up to 62 bits, so both the
+64-bit fast path of Rational, every way out of it, and its large terms are
+taken */
+
+typedef __int128 Integer;
+
+// a fraction in lowest terms with a positive denominator
+struct Fraction {
+    Integer numerator;
+    Integer denominator;
+};
+
+static Integer magnitude(Integer value) {
+    return value < 0 ? -value : value;
+}
+
+static Integer greatestCommonDivisor(Integer a, Integer b) {
+    a = magnitude(a);
+    b = magnitude(b);
+    while(b != 0) {
+        Integer r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+// numerator / denominator in lowest terms, false if the denominator is 0
+static bool makeFraction(Integer numerator, Integer denominator, Fraction &result) {
+    if(denominator == 0)
+        return false;
+    if(denominator < 0) {
+        numerator = -numerator;
+        denominator = -denominator;
+    }
+    Integer divisor = greatestCommonDivisor(numerator, denominator);
+    result.numerator = numerator / divisor;
+    result.denominator = denominator / divisor;
+    return true;
+}
+
+// a + b, or a - b if subtract is set, false if it does not fit
+static bool addFractions(const Fraction &a, const Fraction &b, bool subtract, Fraction &result) {
+    Integer left, right, denominator, numerator;
+    if(__builtin_mul_overflow(a.numerator, b.denominator, &left)
+       || __builtin_mul_overflow(b.numerator, a.denominator, &right)
+       || __builtin_mul_overflow(a.denominator, b.denominator, &denominator))
+        return false;
+    if(subtract ? __builtin_sub_overflow(left, right, &numerator) : __builtin_add_overflow(left, right, &numerator))
+        return false;
+    return makeFraction(numerator, denominator, result);
+}
+
+// a × b, false if it does not fit
+static bool multiplyFractions(const Fraction &a, const Fraction &b, Fraction &result) {
+    Integer numerator, denominator;
+    if(__builtin_mul_overflow(a.numerator, b.numerator, &numerator)
+       || __builtin_mul_overflow(a.denominator, b.denominator, &denominator))
+        return false;
+    return makeFraction(numerator, denominator, result);
+}
+
+static std::string integerText(Integer value) {
+    std::string text;
+    do {
+        text.insert(text.begin(), char('0' + int(value % 10)));
+        value /= 10;
+    } while(value != 0);
+    return text;
+}
+
+// true if value is exactly the fraction, terms, sign and all
+static bool sameValue(const Rational &value, const Fraction &expected) {
+    Rational reduced(value);
+    reduced.reduce();
+    return reduced.numerator().toString() == integerText(magnitude(expected.numerator))
+           && reduced.denominator().toString() == integerText(expected.denominator)
+           && reduced.isNegative() == (expected.numerator < 0);
+}
+
+// a random fraction of one of a few sizes, made the way the engine makes one, by dividing two integers
+static void randomOperand(std::mt19937_64 &random, Rational &value, Fraction &expected) {
+    static const int bits[] = { 7, 31, 62 };
+    int size = bits[random() % 3];
+    std::int64_t numerator = std::int64_t(random() >> (64 - size)) * (random() % 2 ? 1 : -1);
+    std::int64_t denominator = random() % 4 == 0 ? 1 : std::int64_t(random() >> (64 - size)) + 1;
+    Rational::divide(Rational(numerator), Rational(denominator), value);
+    makeFraction(numerator, denominator, expected);
+}
+
+// chains of random operations on random operands, every result checked
+TEST(rationalMatchesReference) {
+    std::mt19937_64 random(600);
+    Rational value;
+    Fraction expected = { 0, 1 };
+    std::size_t checked = 0, large = 0, chains = 0, differing = 0;
+    for(int step = 0; step < 200000; step++) {
+        Rational operand;
+        Fraction expectedOperand = {};
+        randomOperand(random, operand, expectedOperand);
+        if(step % 16 == 0) {
+            // a new chain now and then, and whenever the reference could not go on
+            value = operand;
+            expected = expectedOperand;
+            chains++;
+        }
+
+        Rational result;
+        Fraction expectedResult = {};
+        bool fits = true;
+        unsigned operation = unsigned(random() % 7);
+        switch(operation) {
+        case 0:
+            result = Rational::add(value, operand);
+            fits = addFractions(expected, expectedOperand, false, expectedResult);
+            break;
+        case 1:
+            result = Rational::subtract(value, operand);
+            fits = addFractions(expected, expectedOperand, true, expectedResult);
+            break;
+        case 2:
+            result = Rational::multiply(value, operand);
+            fits = multiplyFractions(expected, expectedOperand, expectedResult);
+            break;
+        case 3: {
+            Fraction inverse = {};
+            bool divides = makeFraction(expectedOperand.denominator, expectedOperand.numerator, inverse);
+            CHECK(Rational::divide(value, operand, result) == divides);
+            if(!divides)
+                continue;
+            fits = multiplyFractions(expected, inverse, expectedResult);
+            break;
+        }
+        case 4:
+            result = -value;
+            fits = makeFraction(-expected.numerator, expected.denominator, expectedResult);
+            break;
+        case 5:
+            result = value.hundredth();
+            fits = multiplyFractions(expected, Fraction{ 1, 100 }, expectedResult);
+            break;
+        default: {
+            unsigned exponent = unsigned(random() % 6);
+            result = Rational::power(value, exponent);
+            expectedResult = { 1, 1 };
+            for(unsigned i = 0; i < exponent && fits; i++)
+                fits = multiplyFractions(expectedResult, expected, expectedResult);
+            break;
+        }
+        }
+        if(!fits) {
+            step |= 15;
+            continue;
+        }
+        checked++;
+        large += magnitude(expectedResult.numerator) >> 64 != 0 || expectedResult.denominator >> 64 != 0;
+        if(!sameValue(result, expectedResult) && differing++ < 5) {
+            Rational shown(result);
+            shown.reduce();
+            std::printf("  operation %u gave %s%s/%s, not %s/%s\n", operation, shown.isNegative() ? "-" : "",
+                        shown.numerator().toString().c_str(), shown.denominator().toString().c_str(),
+                        (expectedResult.numerator < 0 ? "-" + integerText(-expectedResult.numerator)
+                                                      : integerText(expectedResult.numerator)).c_str(),
+                        integerText(expectedResult.denominator).c_str());
+        }
+        value = result;
+        expected = expectedResult;
+    }
+    std::printf("  %zu results checked over %zu chains, %zu of them with a term past 64 bits\n", checked, chains, large);
+    CHECK(differing == 0);
+}
+
+// decimals read exactly, whatever their exponent, and whole numbers come back out as integers
+TEST(rationalParse) {
+    const struct {
+        const char *text;
+        Integer numerator;
+        Integer denominator;
+    } cases[] = {
+        { "0", 0, 1 }, { "-0", 0, 1 }, { "0.1", 1, 10 }, { "-2.50", -5, 2 }, { "1e3", 1000, 1 },
+        { "12.5e-3", 1, 80 }, { "-4e-2", -1, 25 }, { "18446744073709551616", Integer(1) << 64, 1 },
+        { "0.0000000000000000000003", 3, Integer(10000000000000000000ULL) * 1000 },
+    };
+    for(const auto &c : cases) {
+        Rational value;
+        Fraction expected = {};
+        makeFraction(c.numerator, c.denominator, expected);
+        bool read = Rational::parse(c.text, std::string(c.text).size(), value);
+        if(!CHECK(read && sameValue(value, expected)))
+            std::printf("  %s\n", c.text);
+    }
+    Rational value;
+    CHECK(!Rational::parse("1.2.3", 5, value));
+    CHECK(!Rational::parse("e5", 2, value));
+
+    std::int64_t n = 0;
+    CHECK(Rational::parse("4200e-2", 7, value) && value.toInteger(100, n) && n == 42);
+    CHECK(Rational::parse("-7", 2, value) && value.toInteger(100, n) && n == -7);
+    CHECK(Rational::parse("7.5", 3, value) && !value.toInteger(100, n));
+    CHECK(Rational::parse("1000", 4, value) && !value.toInteger(100, n));
+}
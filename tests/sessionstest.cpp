@@ -0,0 +1,80 @@
+#include "check.h"
+#include "engine.h"
+#include "keys.h"
+#include "sessions.h"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+/* sessions pressed side by side by SessionBatch against every one of them
+pressed through an Engine of its own, over random key logs */
+
+// a key log of mostly digits and operators, with every other key now and then and brackets only if allowed
+static std::vector<Key> randomKeys(std::mt19937_64 &random, bool brackets) {
+    std::vector<Key> keys(random() % 80);
+    for(Key &key : keys) {
+        unsigned pick = unsigned(random() % 100);
+        if(pick < 45)
+            key = digitKey(int(random() % 10));
+        else if(pick < 70)
+            key = Key(int(Key::Add) + int(random() % 4));
+        else if(pick < 78)
+            key = Key::Equals;
+        else if(pick < 82)
+            key = Key::Point;
+        else if(pick < 85)
+            key = Key::Power;
+        else if(pick < 88)
+            key = Key::Percent;
+        else if(pick < 91)
+            key = Key::FlipSign;
+        else if(pick < 93)
+            key = Key::Backspace;
+        else if(pick < 94)
+            key = random() % 2 ? Key::Clear : Key::ClearAll;
+        else if(pick < 97 || !brackets)
+            key = Key(int(Key::SquareRoot) + int(random() % (int(Key::Factorial) - int(Key::SquareRoot) + 1)));
+        else
+            key = random() % 2 ? Key::OpenBracket : Key::CloseBracket;
+    }
+    return keys;
+}
+
+/* thousands of sessions over many blocks and threads, a few of them with
+brackets, which go through the fallback, end on the display and the number of
+finished entries an Engine in double mode ends on */
+TEST(sessionsMatchEngine) {
+    std::mt19937_64 random(500);
+    std::vector<std::vector<Key>> logs;
+    SessionBatch batch;
+    std::size_t bracketed = 0;
+    for(int session = 0; session < 20000; session++) {
+        logs.push_back(randomKeys(random, random() % 20 == 0));
+        bool hasBracket = false;
+        for(Key key : logs.back())
+            hasBracket |= key == Key::OpenBracket || key == Key::CloseBracket;
+        bracketed += hasBracket;
+        batch.addSession(logs.back().data(), logs.back().size());
+    }
+    batch.run(4);
+    CHECK(batch.sessionCount() == logs.size());
+    CHECK(batch.fallbackCount() == bracketed);
+
+    std::size_t differing = 0, aborted = 0;
+    for(std::size_t session = 0; session < logs.size(); session++) {
+        Engine engine;
+        engine.setNumberMode(NumberMode::Double);
+        for(Key key : logs[session])
+            engine.press(key);
+        aborted += engine.display() == "####";
+        if((engine.display() != batch.display(session) || engine.finishedCount() != batch.finishedCount(session))
+           && differing++ < 5) {
+            std::printf("  %s: the engine displays %s after %lu entries, the session %s after %lu\n",
+                        formatKeys(logs[session].data(), logs[session].size()).c_str(), engine.display().c_str(),
+                        engine.finishedCount(), batch.display(session).c_str(), batch.finishedCount(session));
+        }
+    }
+    std::printf("  %zu sessions, %zu with brackets, %zu ending on ####\n", logs.size(), bracketed, aborted);
+    CHECK(differing == 0);
+}
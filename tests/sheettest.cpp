@@ -0,0 +1,172 @@
+#include "bytecode.h"
+#include "check.h"
+#include "expression.h"
+#include "sheet.h"
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+/* a sheet recomputed on a pool of threads against the same sheet recomputed
+on the calling thread, and both against every cell worked out again from its
+formula, after every round of random edits */
+
+static const int Cells = 3000;
+
+static std::string cellName(int cell) {
+    return "c" + std::to_string(cell);
+}
+
+// a formula over up to three cells, below the cell itself unless anywhere is set, which may make a circle
+static std::string randomFormula(std::mt19937_64 &random, int cell, bool anywhere) {
+    auto other = [&]() {
+        int limit = anywhere ? Cells : cell;
+        return limit > 0 ? cellName(int(random() % unsigned(limit))) : std::string("1.5");
+    };
+    switch(random() % 8) {
+    case 0: return "2.5";
+    case 1: return other() + " / 0";
+    case 2: return "sqrt(" + other() + " × " + other() + " + 1)";
+    case 3: return other() + " − " + other() + " ÷ 3";
+    case 4: return "(" + other() + " + " + other() + " + " + other() + ") × 0.25";
+    // a name no cell has a formula for, which leaves the cell failed
+    case 5: return other() + " × 0.5 + missing" + std::to_string(random() % 8);
+    default: return "(" + other() + " + " + other() + ") × 0.5 + 1";
+    }
+}
+
+/* the sheet worked out from scratch, each cell from its formula and the cells
+it refers to, with names that have no formula left empty */
+class ReferenceSheet
+{
+public:
+    struct Result {
+        CellState state;
+        double value;
+    };
+
+    void setFormula(const std::string &name, const std::string &formula) { formulas[name] = formula; }
+
+    // true if the formula given to name would refer back to it
+    bool circular(const std::string &name, const std::string &formula) {
+        Expression expression;
+        if(!expression.parse(formula.data(), formula.data() + formula.size()))
+            return false;
+        std::map<std::string, bool> seen;
+        for(const std::string &variable : expression.variableNames()) {
+            if(reaches(variable, name, seen))
+                return true;
+        }
+        return false;
+    }
+
+    Result evaluate(const std::string &name) {
+        std::map<std::string, Result>::const_iterator known = results.find(name);
+        if(known != results.end())
+            return known->second;
+        Result result = { CellState::Empty, 0 };
+        std::map<std::string, std::string>::const_iterator formula = formulas.find(name);
+        if(formula != formulas.end()) {
+            Expression expression;
+            Program program;
+            expression.parse(formula->second.data(), formula->second.data() + formula->second.size());
+            expression.foldConstants();
+            program.compile(expression);
+            std::vector<double> inputs, scratch(program.registerCount());
+            result.state = CellState::Value;
+            for(const std::string &variable : expression.variableNames()) {
+                Result input = evaluate(variable);
+                if(input.state != CellState::Value)
+                    result.state = CellState::Failed;
+                inputs.push_back(input.value);
+            }
+            if(result.state == CellState::Value && !program.run(inputs.data(), scratch.data(), result.value))
+                result.state = CellState::Failed;
+        }
+        results[name] = result;
+        return result;
+    }
+
+    // forgets every result, the next evaluate() works each cell out again
+    void clearResults() { results.clear(); }
+
+private:
+    // true if from is to or refers to it, directly or through other cells
+    bool reaches(const std::string &from, const std::string &to, std::map<std::string, bool> &seen) {
+        if(from == to)
+            return true;
+        if(seen[from])
+            return false;
+        seen[from] = true;
+        std::map<std::string, std::string>::const_iterator formula = formulas.find(from);
+        if(formula == formulas.end())
+            return false;
+        Expression expression;
+        expression.parse(formula->second.data(), formula->second.data() + formula->second.size());
+        for(const std::string &variable : expression.variableNames()) {
+            if(reaches(variable, to, seen))
+                return true;
+        }
+        return false;
+    }
+
+    std::map<std::string, std::string> formulas;
+    std::map<std::string, Result> results;
+};
+
+// counts the cells of sheet that differ from the reference, state and value bit for bit
+static std::size_t differingCells(const Sheet &sheet, ReferenceSheet &reference, const char *what) {
+    std::size_t differing = 0;
+    for(int cell = 0; cell < int(sheet.cellCount()); cell++) {
+        ReferenceSheet::Result expected = reference.evaluate(sheet.cellName(cell));
+        double value = sheet.cellValue(cell);
+        bool same = sheet.cellState(cell) == expected.state
+                    && (expected.state != CellState::Value || std::memcmp(&value, &expected.value, sizeof(double)) == 0);
+        if(!same && differing++ < 5)
+            std::printf("  %s: %s in %s\n", what, sheet.cellName(cell).c_str(), sheet.cellFormula(cell).c_str());
+    }
+    return differing;
+}
+
+/* a sheet of thousands of cells, so that the first recompute and the edits
+near its start reach enough cells to go to the pool, then rounds of a few
+edits each, some of them circular, which both sheets have to refuse */
+TEST(sheetParallelMatchesSerial) {
+    std::mt19937_64 random(400);
+    Sheet parallel(4), serial(1);
+    ReferenceSheet reference;
+    for(int cell = 0; cell < Cells; cell++) {
+        std::string name = cellName(cell), formula = randomFormula(random, cell, false);
+        CHECK(parallel.setFormula(name.data(), name.size(), formula.data(), formula.size()));
+        CHECK(serial.setFormula(name.data(), name.size(), formula.data(), formula.size()));
+        reference.setFormula(name, formula);
+    }
+    CHECK(parallel.recompute() == serial.recompute());
+    CHECK(differingCells(parallel, reference, "parallel") == 0);
+    CHECK(differingCells(serial, reference, "serial") == 0);
+
+    std::size_t refused = 0, recomputed = 0;
+    for(int round = 0; round < 100; round++) {
+        for(int edit = int(random() % 3); edit >= 0; edit--) {
+            // cells near the start have the most cells depending on them
+            int cell = random() % 2 ? int(random() % 50) : int(random() % Cells);
+            std::string name = cellName(cell), formula = randomFormula(random, cell, random() % 4 == 0);
+            bool circular = reference.circular(name, formula);
+            refused += circular;
+            CHECK(parallel.setFormula(name.data(), name.size(), formula.data(), formula.size()) == !circular);
+            CHECK(serial.setFormula(name.data(), name.size(), formula.data(), formula.size()) == !circular);
+            if(!circular)
+                reference.setFormula(name, formula);
+        }
+        std::size_t count = parallel.recompute();
+        CHECK(count == serial.recompute());
+        recomputed += count;
+        reference.clearResults();
+        CHECK(differingCells(parallel, reference, "parallel") == 0);
+        CHECK(differingCells(serial, reference, "serial") == 0);
+    }
+    std::printf("  %zu cells recomputed over 100 rounds, %zu circular edits refused\n", recomputed, refused);
+    CHECK(refused > 0);
+}
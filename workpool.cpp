@@ -0,0 +1,112 @@
+#include "workpool.h"
+
+WorkStealingPool::WorkStealingPool(unsigned threads)
+    : workers(threads ? threads : 1), queues(new Queue[workers]), remaining(0)
+{
+    // the thread calling run() is worker 0, the others wait for something to run
+    for(unsigned i = 1; i < workers; i++)
+        this->threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    started.notify_all();
+    for(std::thread &thread : threads)
+        thread.join();
+}
+
+// function is invoked to run a set of tasks, and whatever they spawn, on every thread of the pool
+void WorkStealingPool::run(const std::vector<std::size_t> &tasks, const Task &task) {
+    if(tasks.empty())
+        return;
+
+    // the first tasks are dealt out round the queues, so every thread has some to start on
+    for(std::size_t i = 0; i < tasks.size(); i++)
+        queues[i % workers].tasks.push_back(tasks[i]);
+    remaining.store(tasks.size());
+
+    if(workers > 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = &task;
+        busyThreads = workers - 1;
+        generation++;
+    }
+    started.notify_all();
+
+    work(0, task);
+
+    // the task belongs to the caller, so no thread may still be looking at it once this returns
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return busyThreads == 0; });
+    current = nullptr;
+}
+
+// function is invoked on every thread but the first, waiting for each run in turn
+void WorkStealingPool::workerLoop(unsigned self) {
+    unsigned long seen = 0;
+    for(;;) {
+        const Task *task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            started.wait(lock, [&] { return stopping || generation != seen; });
+            if(stopping)
+                return;
+            seen = generation;
+            task = current;
+        }
+
+        work(self, *task);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(--busyThreads == 0)
+            finished.notify_one();
+    }
+}
+
+// runs tasks until there are none left anywhere, queueing the ones a task spawns on this thread
+void WorkStealingPool::work(unsigned self, const Task &task) {
+    std::vector<std::size_t> spawned;
+    while(remaining.load(std::memory_order_acquire) != 0) {
+        std::size_t next;
+        if(!take(self, next)) {
+            // the tasks left are running elsewhere, and may yet spawn more
+            std::this_thread::yield();
+            continue;
+        }
+        spawned.clear();
+        task(next, spawned);
+        if(!spawned.empty()) {
+            // counted before this task is, so that remaining never drops to 0 early
+            remaining.fetch_add(spawned.size(), std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(queues[self].mutex);
+            queues[self].tasks.insert(queues[self].tasks.end(), spawned.begin(), spawned.end());
+        }
+        remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+// takes the newest task of this thread, or else the oldest one of another
+bool WorkStealingPool::take(unsigned self, std::size_t &task) {
+    {
+        Queue &own = queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if(!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for(unsigned i = 1; i < workers; i++) {
+        Queue &other = queues[(self + i) % workers];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if(!other.tasks.empty()) {
+            task = other.tasks.front();
+            other.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,63 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* a fixed set of threads that run tasks from a queue each. A thread takes the
+task it queued last, which is the one whose data is still in its cache, and
+only once its own queue is empty does it steal the task queued first on
+another, which is the one furthest from what that thread works on. Tasks are
+numbers, what they stand for is up to the caller */
+class WorkStealingPool
+{
+public:
+    // runs a task, leaving any tasks it made ready in spawned
+    typedef std::function<void(std::size_t task, std::vector<std::size_t> &spawned)> Task;
+
+    // threads counts the thread calling run() too, which works alongside the others
+    explicit WorkStealingPool(unsigned threads = std::thread::hardware_concurrency());
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    // runs task on every one of tasks and on everything they spawn, returning once all of it is done
+    void run(const std::vector<std::size_t> &tasks, const Task &task);
+
+    unsigned threadCount() const { return workers; }
+
+private:
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+
+    void workerLoop(unsigned self);
+    void work(unsigned self, const Task &task);
+    bool take(unsigned self, std::size_t &task);
+
+    unsigned workers;
+    std::unique_ptr<Queue[]> queues;
+    std::vector<std::thread> threads;
+
+    // the tasks queued or running, run() is done when it drops to 0
+    std::atomic<std::size_t> remaining;
+
+    std::mutex mutex;
+    std::condition_variable started;
+    std::condition_variable finished;
+    const Task *current = nullptr;
+    unsigned long generation = 0;
+    unsigned busyThreads = 0;
+    bool stopping = false;
+};
+
+#endif // WORKPOOL_H